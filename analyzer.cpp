@@ -0,0 +1,501 @@
+﻿#include <vector>
+#include <map>
+#include <string>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include "analyzer.hpp"
+#include "context.hpp"
+
+namespace analyzer{
+    void semantic_data::push_stack(poly::node *ptr){
+        stack_element a;
+        a.node = ptr;
+        stack.push_back(a);
+    }
+
+    void semantic_data::push_stack(const eval_target *ptr){
+        stack_element a;
+        a.v = ptr;
+        stack.push_back(a);
+    }
+
+    void semantic_data::pop_local_args(){
+        auto &m(local_args.back());
+        for(auto iter = m.begin(); iter != m.end(); ++iter){
+            if(iter->second.node){ poly::dispose(cx, iter->second.node); }
+        }
+        local_args.pop_back();
+    }
+
+    void semantic_data::clear(){
+        for(auto iter = stack.begin(); iter != stack.end(); ++iter){
+            if(iter->node){ poly::dispose(cx, iter->node); }
+        }
+        stack.clear();
+        while(!local_args.empty()){ pop_local_args(); }
+    }
+
+    void semantic_data::clear_let_values(){
+        for(auto iter = global_variable_map.begin(); iter != global_variable_map.end(); ++iter){
+            for(auto jter = iter->second.begin(); jter != iter->second.end(); ++jter){
+                if(jter->node){
+                    poly::dispose(cx, jter->node);
+                }else{
+                    delete jter->v;
+                }
+            }
+        }
+        global_variable_map.clear();
+        dependents.clear();
+        let_value_count_ = 0;
+    }
+
+    semantic_data::~semantic_data(){
+        clear();
+        clear_let_values();
+    }
+
+    void semantic_data::register_local_arg(const symbol *ptr, const stack_element target){
+        local_args.back().insert(std::make_pair(ptr->s, target));
+    }
+
+    void semantic_data::register_let_value(const symbol *ptr, const stack_element target){
+        register_let_value(ptr->s, target);
+    }
+
+    void semantic_data::reserve_let_value(poly::node *node){
+        if(let_value_limit > 0 && let_value_count_ >= let_value_limit){
+            if(node){ poly::dispose(cx, node); }
+            throw(error("too many let values."));
+        }
+    }
+
+    void semantic_data::register_let_value(const str_wrapper &s, const stack_element target){
+        reserve_let_value(target.node);
+        invalidate(s);
+        let_binding b;
+        b.node = target.node, b.v = target.v;
+        global_variable_map[s].push_back(b);
+        ++let_value_count_;
+    }
+
+    const poly::node *semantic_data::define_let_value(const symbol *ptr, const std::shared_ptr<const eval_target> &definition){
+        // 文の局所的な束縛を参照する定義は再計算できないので, 値だけを束縛する
+        bool track = let_tracking_ && local_args.empty();
+        std::vector<str_wrapper> depends, *prev = recording;
+        recording = track ? &depends : nullptr;
+        try{
+            definition->eval(*this);
+        }catch(...){
+            recording = prev;
+            throw;
+        }
+        recording = prev;
+        stack_element se = pop_stack();
+        if(!se.node){
+            throw(error("let value is lambda expression."));
+        }
+        reserve_let_value(se.node);
+
+        std::sort(depends.begin(), depends.end());
+        depends.erase(std::unique(depends.begin(), depends.end()), depends.end());
+        // 自身の名前を問い合わせた定義は隠される束縛に依存するので, 値だけを束縛する
+        if(std::binary_search(depends.begin(), depends.end(), ptr->s)){ track = false; }
+
+        // 新しい束縛を置く前に古くし, 新しい束縛が自身を古くしないようにする
+        invalidate(ptr->s);
+        let_binding b;
+        b.node = se.node;
+        if(track){
+            b.definition = definition;
+            b.depends.swap(depends);
+            for(auto iter = b.depends.begin(); iter != b.depends.end(); ++iter){
+                dependents[*iter].insert(ptr->s);
+            }
+        }
+        global_variable_map[ptr->s].push_back(b);
+        ++let_value_count_;
+        return se.node;
+    }
+
+    void semantic_data::invalidate(const str_wrapper &s){
+        if(dependents.empty()){ return; }
+        // 古くなった定数に依存する定数は既に古いので, 新たに古くなった記号だけを辿る
+        std::vector<str_wrapper> queue(1, s);
+        while(!queue.empty()){
+            str_wrapper n = queue.back();
+            queue.pop_back();
+            auto iter = dependents.find(n);
+            if(iter == dependents.end()){ continue; }
+            for(auto jter = iter->second.begin(); jter != iter->second.end(); ++jter){
+                auto kter = global_variable_map.find(*jter);
+                if(kter == global_variable_map.end()){ continue; }
+                bool changed = false;
+                for(auto lter = kter->second.begin(); lter != kter->second.end(); ++lter){
+                    if(lter->definition && !lter->stale && std::binary_search(lter->depends.begin(), lter->depends.end(), n)){
+                        lter->stale = true;
+                        changed = true;
+                    }
+                }
+                if(changed){ queue.push_back(*jter); }
+            }
+        }
+    }
+
+    void semantic_data::refresh(let_binding &b, const str_wrapper &s){
+        if(b.computing){
+            throw(error("circular let value, " + *s.ptr + "."));
+        }
+        // 定義した時と同じく大域の束縛だけを見る
+        std::vector<std::map<str_wrapper, const stack_element>> args;
+        args.swap(local_args);
+        std::vector<str_wrapper> *prev = recording;
+        recording = nullptr;
+        b.computing = true;
+        try{
+            b.definition->eval(*this);
+        }catch(...){
+            b.computing = false;
+            recording = prev;
+            local_args.swap(args);
+            throw;
+        }
+        b.computing = false;
+        recording = prev;
+        local_args.swap(args);
+        stack_element se = pop_stack();
+        if(!se.node){
+            throw(error("let value is lambda expression."));
+        }
+        poly::dispose(cx, b.node);
+        b.node = se.node;
+        b.stale = false;
+    }
+
+    const stack_element *semantic_data::find_let_value(const str_wrapper &s){
+        auto iter = global_variable_map.find(s);
+        if(iter == global_variable_map.end() || iter->second.empty()){ return nullptr; }
+        let_binding &b(iter->second.back());
+        if(b.stale){ refresh(b, s); }
+        return &b;
+    }
+
+    void semantic_data::refresh_let_values(){
+        for(auto iter = global_variable_map.begin(); iter != global_variable_map.end(); ++iter){
+            if(!iter->second.empty() && iter->second.back().stale){ refresh(iter->second.back(), iter->first); }
+        }
+    }
+
+    bool semantic_data::unregister_let_value(const symbol *ptr){
+        auto iter = global_variable_map.find(ptr->s);
+        if(iter == global_variable_map.end()){ return false; }
+        let_binding &se(iter->second.back());
+        if(se.node){
+            poly::dispose(cx, se.node);
+        }else{
+            delete se.v;
+        }
+        iter->second.pop_back();
+        if(iter->second.empty()){ global_variable_map.erase(iter); }
+        --let_value_count_;
+        invalidate(ptr->s);
+        return true;
+    }
+
+    stack_element semantic_data::pop_stack(){
+        if(stack.empty()){
+            throw(error("stack is empty."));
+        }
+        stack_element a = stack.back();
+        stack.pop_back();
+        return a;
+    }
+
+    stack_element semantic_data::r_access(std::size_t i) const{
+        return stack[stack.size() - i - 1];
+    }
+
+    const stack_element semantic_data::inquiry_symbol(const symbol *s){
+        for(auto iter = local_args.rbegin(); iter != local_args.rend(); ++iter){
+            auto jter = iter->find(s->s);
+            if(jter != iter->end()){ return jter->second; }
+        }
+        if(recording){ recording->push_back(s->s); }
+        if(const stack_element *p = find_let_value(s->s)){ return *p; }
+        stack_element se;
+        se.v = s;
+        return se;
+    }
+
+    str_wrapper semantic_action::lambda_name(){
+        return cx->symbols.intern(to_string(cx->next_lambda_id()) + "_lambda");
+    }
+
+    cost cost_estimator::operator ()(const eval_target &e){
+        if(!explain){ return e.estimate(*this); }
+        // 子より先に自分の行を置く
+        std::size_t n = explain_entries.size();
+        entry a;
+        a.depth = depth, a.e = &e;
+        explain_entries.push_back(a);
+        ++depth;
+        cost c;
+        try{
+            c = e.estimate(*this);
+        }catch(...){
+            --depth;
+            throw;
+        }
+        --depth;
+        explain_entries[n].c = c;
+        return c;
+    }
+
+    cost cost_estimator::symbol_cost(const symbol &s) const{
+        for(auto iter = scopes.rbegin(); iter != scopes.rend(); ++iter){
+            auto jter = iter->find(s.s);
+            if(jter != iter->end()){ return cost(jter->second.terms, 1); }
+        }
+        auto iter = sd.let_values().find(s.s);
+        if(iter == sd.let_values().end() || iter->second.empty()){ return cost(1, 1); }
+        const poly::node *p = iter->second.back().node;
+        if(!p){ return cost(1, 1); }
+        double n = 0;
+        for(p = p->next; p; p = p->next){ ++n; }
+        // 値はコピーされる
+        return cost(std::max(n, 1.0), std::max(n, 1.0));
+    }
+
+    bool cost_estimator::constant_value(const eval_target &e, fpoint &v) const{
+        const value *ptr = dynamic_cast<const value*>(&e);
+        if(ptr){
+            if(!ptr->real){ return false; }
+            v = ptr->v;
+            return true;
+        }
+        const symbol *s = dynamic_cast<const symbol*>(&e);
+        if(!s){ return false; }
+        for(auto iter = scopes.rbegin(); iter != scopes.rend(); ++iter){
+            if(iter->find(s->s) != iter->end()){ return false; }
+        }
+        auto iter = sd.let_values().find(s->s);
+        if(iter == sd.let_values().end() || iter->second.empty()){ return false; }
+        const poly::node *p = iter->second.back().node;
+        if(!p || !p->next || p->next->next || !p->next->e.empty() || p->next->imag != 0){ return false; }
+        v = p->next->real;
+        return true;
+    }
+
+    void cost_estimator::push_scope(){
+        scopes.push_back(std::map<str_wrapper, cost>());
+    }
+
+    void cost_estimator::pop_scope(){
+        scopes.pop_back();
+    }
+
+    void cost_estimator::bind(const symbol &s, const cost &c){
+        if(scopes.empty()){ push_scope(); }
+        scopes.back()[s.s] = c;
+    }
+
+    cost cost_estimator::multiply_cost(double m, double n){
+        // 各積を整列したリストへ挿し込む
+        double t = m * n;
+        return cost(t, t + n * t);
+    }
+
+    cost cost_estimator::divide_cost(double m, double n){
+        return cost(m, m * n * m);
+    }
+
+    cost cost_estimator::power_cost(double m, double n){
+        // n乗したm項の多項式の項の数
+        auto terms = [m](double k) -> double{
+            double c = std::exp(std::lgamma(k + m) - std::lgamma(k + 1) - std::lgamma(m));
+            return std::min(c, std::pow(m, k));
+        };
+        // 二乗を繰り返す冪乗を辿る
+        cost c(1, 0);
+        double x = 1, r = 0;
+        for(double k = n; k >= 1; k = std::floor(k / 2)){
+            if(std::fmod(k, 2) == 1){
+                if(r > 0){ c.work += multiply_cost(terms(r), terms(x)).work; }
+                r += x;
+            }
+            if(k >= 2){
+                c.work += multiply_cost(terms(x), terms(x)).work;
+                x *= 2;
+            }
+        }
+        c.terms = terms(n);
+        return c;
+    }
+
+    void cost_estimator::write_explanation(output_buffer &o) const{
+        for(auto iter = explain_entries.begin(); iter != explain_entries.end(); ++iter){
+            std::string str = iter->e->ast_str();
+            if(str.empty()){ continue; }
+            o.put('#');
+            for(std::size_t i = 0; i <= iter->depth; ++i){ o.put(' '); }
+            o.write(str);
+            char buf[64];
+            int n = std::snprintf(buf, sizeof(buf), " terms=%g work=%g\n", iter->c.terms, iter->c.work);
+            o.write(buf, static_cast<std::size_t>(n));
+        }
+    }
+
+    void numeric_program::run(const double *const *column_values, std::size_t n, double *out, std::vector<double> &work) const{
+        // 積まれた値は列か作業領域を指し, 列はコピーしない
+        std::size_t m = stack_depth + local_count;
+        if(work.size() < m * n){ work.resize(m * n); }
+        double *stack_buffer = work.data(), *locals = work.data() + stack_depth * n;
+        std::vector<const double*> stack(stack_depth);
+        std::size_t sp = 0;
+        for(auto iter = code.begin(); iter != code.end(); ++iter){
+            switch(iter->op){
+            case op_constant:
+                {
+                    double *d = stack_buffer + sp * n;
+                    std::fill(d, d + n, iter->value);
+                    stack[sp++] = d;
+                }
+                break;
+
+            case op_column:
+                stack[sp++] = column_values[iter->index];
+                break;
+
+            case op_load:
+                stack[sp++] = locals + iter->index * n;
+                break;
+
+            case op_store:
+                {
+                    const double *a = stack[--sp];
+                    std::copy(a, a + n, locals + iter->index * n);
+                }
+                break;
+
+            case op_negate:
+                {
+                    const double *a = stack[sp - 1];
+                    double *d = stack_buffer + (sp - 1) * n;
+                    for(std::size_t i = 0; i < n; ++i){ d[i] = -a[i]; }
+                    stack[sp - 1] = d;
+                }
+                break;
+
+            default:
+                {
+                    const double *a = stack[sp - 2], *b = stack[sp - 1];
+                    double *d = stack_buffer + (sp - 2) * n;
+                    switch(iter->op){
+                    case op_add: for(std::size_t i = 0; i < n; ++i){ d[i] = a[i] + b[i]; } break;
+                    case op_sub: for(std::size_t i = 0; i < n; ++i){ d[i] = a[i] - b[i]; } break;
+                    case op_mul: for(std::size_t i = 0; i < n; ++i){ d[i] = a[i] * b[i]; } break;
+                    case op_div: for(std::size_t i = 0; i < n; ++i){ d[i] = a[i] / b[i]; } break;
+                    case op_pow: for(std::size_t i = 0; i < n; ++i){ d[i] = std::pow(a[i], b[i]); } break;
+                    default: break;
+                    }
+                    stack[--sp - 1] = d;
+                }
+            }
+        }
+        std::copy(stack[0], stack[0] + n, out);
+    }
+
+    numeric_program numeric_compiler::compile(const eval_target &root){
+        program = numeric_program();
+        scopes.clear();
+        columns.clear();
+        depth = 0;
+        root.compile(*this);
+        if(depth != 1){
+            throw(error("not a numeric expression, " + root.ast_str() + "."));
+        }
+        return program;
+    }
+
+    void numeric_compiler::push_instruction(numeric_program::opcode op, std::size_t index, double value){
+        numeric_program::instruction a;
+        a.op = op, a.index = index, a.value = value;
+        program.code.push_back(a);
+    }
+
+    void numeric_compiler::emit_constant(double v){
+        push_instruction(numeric_program::op_constant, 0, v);
+        program.stack_depth = std::max(program.stack_depth, ++depth);
+    }
+
+    void numeric_compiler::emit_symbol(const symbol &s){
+        for(auto iter = scopes.rbegin(); iter != scopes.rend(); ++iter){
+            auto jter = iter->find(s.s);
+            if(jter != iter->end()){
+                push_instruction(numeric_program::op_load, jter->second);
+                program.stack_depth = std::max(program.stack_depth, ++depth);
+                return;
+            }
+        }
+        if(const stack_element *se = sd.find_let_value(s.s)){
+            const poly::node *p = se->node;
+            if(!p || (p->next && (p->next->next || !p->next->e.empty() || p->next->imag != 0))){
+                throw(error("symbol is not a number, " + s.ast_str() + "."));
+            }
+            emit_constant(p->next ? p->next->real : 0);
+            return;
+        }
+        auto jter = columns.find(s.s);
+        if(jter == columns.end()){
+            jter = columns.insert(std::make_pair(s.s, program.columns.size())).first;
+            program.columns.push_back(*s.s.ptr);
+        }
+        push_instruction(numeric_program::op_column, jter->second);
+        program.stack_depth = std::max(program.stack_depth, ++depth);
+    }
+
+    void numeric_compiler::emit(numeric_program::opcode op){
+        auto &code(program.code);
+        std::size_t n = code.size();
+        if(op == numeric_program::op_negate){
+            if(n >= 1 && code[n - 1].op == numeric_program::op_constant){
+                code[n - 1].value = -code[n - 1].value;
+            }else{
+                push_instruction(op);
+            }
+            return;
+        }
+        --depth;
+        if(n >= 2 && code[n - 2].op == numeric_program::op_constant && code[n - 1].op == numeric_program::op_constant){
+            double a = code[n - 2].value, b = code[n - 1].value, &d(code[n - 2].value);
+            switch(op){
+            case numeric_program::op_add: d = a + b; break;
+            case numeric_program::op_sub: d = a - b; break;
+            case numeric_program::op_mul: d = a * b; break;
+            case numeric_program::op_div: d = a / b; break;
+            case numeric_program::op_pow: d = std::pow(a, b); break;
+            default: break;
+            }
+            code.pop_back();
+            return;
+        }
+        push_instruction(op);
+    }
+
+    void numeric_compiler::push_scope(){
+        scopes.push_back(std::map<str_wrapper, std::size_t>());
+    }
+
+    void numeric_compiler::pop_scope(){
+        scopes.pop_back();
+    }
+
+    void numeric_compiler::store(const symbol &s){
+        if(scopes.empty()){ push_scope(); }
+        // 評価と同じく, 同じwhere部で2度束縛した記号は最初の値のまま
+        push_instruction(numeric_program::op_store, program.local_count);
+        scopes.back().insert(std::make_pair(s.s, program.local_count++));
+        --depth;
+    }
+}
@@ -0,0 +1,1122 @@
+﻿#ifndef SCALC_ANALYZER_HPP
+#define SCALC_ANALYZER_HPP
+
+#include <functional>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <cstdint>
+#include <cmath>
+#include "common.hpp"
+
+namespace scalc{
+    class context;
+}
+
+namespace analyzer{
+    struct eval_target;
+    struct symbol;
+
+    struct stack_element{
+        stack_element() : node(nullptr), v(nullptr){}
+        poly::node *node;
+        const eval_target *v;
+    };
+
+    // letによる束縛
+    // 依存関係を記録する場合は定義式と, 評価で大域に問い合わせた記号を持つ
+    // 問い合わせた記号が束縛し直されるとstaleになり, 次に参照された時に定義式から再計算する
+    struct let_binding : stack_element{
+        let_binding() : stack_element(), definition(), depends(), stale(false), computing(false){}
+
+        // 定義式. 無ければ値だけの束縛で, 再計算しない
+        std::shared_ptr<const eval_target> definition;
+
+        // 定義式が問い合わせた記号. 整列済み
+        std::vector<str_wrapper> depends;
+
+        bool stale, computing;
+    };
+
+    class semantic_data{
+    public:
+        explicit semantic_data(scalc::context &cx_)
+            : cx(cx_), stack(), local_args(), global_variable_map(), dependents(), recording(nullptr), let_value_count_(0), let_value_limit(0), let_tracking_(false){}
+
+        ~semantic_data();
+
+        // 評価のコンテキスト
+        scalc::context &ctx(){
+            return cx;
+        }
+
+        // スタックに計算結果を積む
+        void push_stack(poly::node *ptr);
+
+        // スタックに評価前の値を積む
+        void push_stack(const eval_target *ptr);
+
+        // スタックから計算結果を取り出す
+        stack_element pop_stack();
+
+        // スタックの中身を逆順に得る
+        stack_element r_access(std::size_t i) const;
+
+        bool empty() const{
+            return stack.empty();
+        }
+
+        // 記号が変数かどうかを問い合わせる
+        // 変数であれば値を返し, そうでなければ入力記号を返す
+        // 古くなった定数はここで再計算する
+        const stack_element inquiry_symbol(const symbol *s);
+
+        // ローカル引数の領域を新たに生成する
+        std::map<str_wrapper, const stack_element> &push_local_args(){
+            local_args.push_back(std::map<str_wrapper, const stack_element>());
+            return local_args.back();
+        }
+
+        // ローカル引数の最も新しい領域を破棄する
+        void pop_local_args();
+
+        // ローカル引数に仮引数を登録する
+        void register_local_arg(const symbol *ptr, const stack_element target);
+
+        // 定数を登録する
+        // 同名の定数が既にあれば新しい定数がそれを隠す
+        void register_let_value(const symbol *ptr, const stack_element target);
+        void register_let_value(const str_wrapper &s, const stack_element target);
+
+        // 定義式を評価し, その値を定数として登録する. 登録した値を返す
+        // 依存関係を記録する場合は定義式を保持する
+        const poly::node *define_let_value(const symbol *ptr, const std::shared_ptr<const eval_target> &definition);
+
+        // 最も新しい定数の登録を取り消す
+        // 隠されていた定数があれば再び見えるようになる
+        bool unregister_let_value(const symbol *ptr);
+
+        // 登録されている定数の数を得る. 隠されているものも含む
+        std::size_t let_value_count() const{
+            return let_value_count_;
+        }
+
+        // 登録されている定数
+        // 記号ごとに古いものから順に並ぶ
+        // 古くなった定数も再計算せずに含む
+        const std::map<str_wrapper, std::vector<let_binding>> &let_values() const{
+            return global_variable_map;
+        }
+
+        // 記号の最も新しい定数を得る. 古くなっていれば再計算する. 無ければnullptrを返す
+        const stack_element *find_let_value(const str_wrapper &s);
+
+        // 見えている定数のうち古くなったものを全て再計算する
+        void refresh_let_values();
+
+        // 全ての定数を破棄する
+        void clear_let_values();
+
+        // 定数の数の上限を設定する. 0は無制限
+        void set_let_value_limit(std::size_t n){
+            let_value_limit = n;
+        }
+
+        // letの依存関係を記録するかを設定する
+        // 記録する場合, 記号を束縛し直すとその記号に依存する定数だけが推移的に古くなり, 参照された時に再計算される
+        // 記録しない場合, 定数は定義した時の値のまま変わらない
+        void set_let_tracking(bool b){
+            let_tracking_ = b;
+        }
+
+        bool let_tracking() const{
+            return let_tracking_;
+        }
+
+        // 文の評価で生じたスタックとローカル引数を全て破棄する
+        void clear();
+
+    private:
+        semantic_data(const semantic_data&);
+        semantic_data &operator =(const semantic_data&);
+
+        // 束縛の数の上限を確かめる. 超える場合はnodeを破棄してerrorを投げる
+        void reserve_let_value(poly::node *node);
+
+        // 記号に依存する定数を推移的に古くする
+        void invalidate(const str_wrapper &s);
+
+        // 古くなった定数を定義式から再計算する
+        void refresh(let_binding &b, const str_wrapper &s);
+
+        scalc::context &cx;
+
+        // 計算の中途結果が入るstack
+        std::vector<stack_element> stack;
+
+        // local args
+        std::vector<std::map<str_wrapper, const stack_element>> local_args;
+
+        // global variable
+        // 末尾が最も新しい束縛
+        std::map<str_wrapper, std::vector<let_binding>> global_variable_map;
+
+        // 記号から, その記号を問い合わせた定義式を持つ記号への索引
+        // 束縛を取り消しても残るので, 辿った先でdependsを確かめる
+        std::map<str_wrapper, std::set<str_wrapper>> dependents;
+
+        // 定義式の評価で問い合わせた記号を記録する先. nullptrであれば記録しない
+        std::vector<str_wrapper> *recording;
+
+        // global variableの束縛の総数
+        std::size_t let_value_count_;
+
+        // global variableの束縛の総数の上限
+        std::size_t let_value_limit;
+
+        // letの依存関係を記録するか
+        bool let_tracking_;
+    };
+
+    // 評価の費用の見積り
+    struct cost{
+        cost() : terms(1), work(1){}
+        cost(double terms_, double work_) : terms(terms_), work(work_){}
+
+        // 結果の項の数の上限
+        double terms;
+
+        // 項同士の演算の回数の目安
+        double work;
+    };
+
+    // 評価の前に構文木を辿って費用を見積もる
+    // letで束縛された記号は束縛された多項式の項の数を, where部の記号は右辺の見積りを使う
+    // 古くなった定数は再計算せず, 古い値の項の数で見積もる
+    class cost_estimator{
+    public:
+        // explain_: 節ごとの見積りを記録してexplainで書き出せるようにする
+        explicit cost_estimator(const semantic_data &sd_, bool explain_ = false) : sd(sd_), scopes(), explain_entries(), depth(0), explain(explain_){}
+
+        // 節の費用を見積もる
+        cost operator ()(const eval_target &e);
+
+        // 記号の値の費用
+        cost symbol_cost(const symbol &s) const;
+
+        // 式が実数の定数であれば値を得る
+        bool constant_value(const eval_target &e, fpoint &v) const;
+
+        // where部の束縛の領域
+        void push_scope();
+        void pop_scope();
+        void bind(const symbol &s, const cost &c);
+
+        // 項の数がm, nの多項式の積
+        static cost multiply_cost(double m, double n);
+
+        // 項の数がm, nの多項式の商
+        static cost divide_cost(double m, double n);
+
+        // 項の数がmの多項式の非負整数n乗
+        // 結果の項の数は多項係数C(n + m - 1, m - 1)とm^nの小さい方で抑える
+        static cost power_cost(double m, double n);
+
+        // 節ごとの見積りを行きがけ順に, 深さで字下げして#に続けて書き出す
+        void write_explanation(output_buffer &o) const;
+
+    private:
+        struct entry{
+            std::size_t depth;
+            const eval_target *e;
+            cost c;
+        };
+
+        const semantic_data &sd;
+        std::vector<std::map<str_wrapper, cost>> scopes;
+        std::vector<entry> explain_entries;
+        std::size_t depth;
+        bool explain;
+    };
+
+    // 数値だけで評価する式の命令列
+    // 命令は値の列をblock単位で扱い, 1命令ごとに全ての行をまとめて計算する
+    struct numeric_program{
+        enum opcode{
+            op_constant,
+            op_column,
+            op_load,
+            op_store,
+            op_add,
+            op_sub,
+            op_mul,
+            op_div,
+            op_pow,
+            op_negate
+        };
+
+        struct instruction{
+            opcode op;
+
+            // 列, 局所変数の番号
+            std::size_t index;
+
+            // op_constantの値
+            double value;
+        };
+
+        numeric_program() : code(), columns(), local_count(0), stack_depth(0){}
+
+        // n行を評価してoutに書き出す
+        // column_values[i]はcolumns[i]の列のn個の値を指す
+        // workは評価の作業領域で, 呼び出しの間で使い回せる
+        void run(const double *const *column_values, std::size_t n, double *out, std::vector<double> &work) const;
+
+        std::vector<instruction> code;
+
+        // 式の自由な記号の名前. 番号は列の番号
+        std::vector<std::string> columns;
+
+        std::size_t local_count, stack_depth;
+    };
+
+    // 構文木を数値の命令列に翻訳する
+    // where部の記号は局所変数に, letで実数の定数に束縛された記号は定数に, それ以外の記号は列になる
+    // 古くなった定数は翻訳する時に再計算する
+    // 数値にならない式(lambda式, let, unlet, 複素数, 多項式に束縛された記号)はerrorを投げる
+    class numeric_compiler{
+    public:
+        explicit numeric_compiler(semantic_data &sd_) : sd(sd_), program(), scopes(), columns(), depth(0){}
+
+        numeric_program compile(const eval_target &root);
+
+        void emit_constant(double v);
+        void emit_symbol(const symbol &s);
+
+        // 演算を加える. 被演算子が定数であれば畳み込む
+        void emit(numeric_program::opcode op);
+
+        // where部の束縛の領域
+        void push_scope();
+        void pop_scope();
+
+        // 積まれた値を記号の局所変数に移す
+        void store(const symbol &s);
+
+    private:
+        void push_instruction(numeric_program::opcode op, std::size_t index = 0, double value = 0);
+
+        semantic_data &sd;
+        numeric_program program;
+        std::vector<std::map<str_wrapper, std::size_t>> scopes;
+        std::map<str_wrapper, std::size_t> columns;
+        std::size_t depth;
+    };
+
+    // 演算に渡した被演算子を, 演算が失敗した時にも破棄する
+    class operand_guard{
+    public:
+        operand_guard(scalc::context &cx_, poly::node *l_, poly::node *r_) : cx(cx_), l(l_), r(r_){}
+
+        ~operand_guard(){
+            if(l){ poly::dispose(cx, l); }
+            if(r){ poly::dispose(cx, r); }
+        }
+
+        // 演算が成功し, 被演算子の所有が移ったことを通知する
+        void release(){
+            l = r = nullptr;
+        }
+
+    private:
+        operand_guard(const operand_guard&);
+        operand_guard &operator =(const operand_guard&);
+
+        scalc::context &cx;
+        poly::node *l, *r;
+    };
+
+    struct eval_target{
+        virtual ~eval_target(){}
+        virtual std::string ast_str() const = 0;
+        virtual void eval(semantic_data&) const{ throw(error("missing eval function.")); }
+        virtual cost estimate(cost_estimator&) const{ return cost(); }
+        virtual void compile(numeric_compiler&) const{ throw(error("not a numeric expression, " + ast_str() + ".")); }
+    };
+
+    struct value : eval_target{
+        virtual std::string ast_str() const{
+            std::stringstream ss;
+            ss << v;
+            if(!real){ ss << "i"; }
+            return ss.str();
+        }
+
+        virtual void eval(semantic_data &sd) const{
+            poly::node *ptr;
+            if(real){
+                ptr = poly::constant(sd.ctx(), v, 0);
+            }else{
+                ptr = poly::constant(sd.ctx(), 0, v);
+            }
+            sd.push_stack(ptr);
+        }
+
+        virtual cost estimate(cost_estimator&) const{
+            return cost(1, 1);
+        }
+
+        virtual void compile(numeric_compiler &nc) const{
+            if(!real){ throw(error("complex value is not supported, " + ast_str() + ".")); }
+            nc.emit_constant(v);
+        }
+
+        fpoint v;
+        bool real;
+
+        // 書かれた10進の値. vはこれを丸めたもの. 意味はscalc::numeric_literalと同じ
+        std::uint64_t mantissa;
+        int scale;
+        bool exact;
+    };
+
+    struct symbol : eval_target{
+        virtual std::string ast_str() const{
+            return *s.ptr;
+        }
+
+        virtual void eval(semantic_data &sd) const{
+            stack_element se = sd.inquiry_symbol(this);
+            if(se.node){
+                sd.push_stack(poly::copy(sd.ctx(), se.node));
+            }else{
+                sd.push_stack(poly::variable(sd.ctx(), s));
+            }
+        }
+
+        virtual cost estimate(cost_estimator &ce) const{
+            return ce.symbol_cost(*this);
+        }
+
+        virtual void compile(numeric_compiler &nc) const{
+            nc.emit_symbol(*this);
+        }
+
+        str_wrapper s;
+    };
+
+    struct binary_operator : eval_target{
+        binary_operator() : lhs(nullptr), rhs(nullptr){}
+
+        virtual void eval(semantic_data &sd) const{
+            lhs->eval(sd);
+            rhs->eval(sd);
+            stack_element er = sd.pop_stack(), el = sd.pop_stack();
+            if(!er.node || !el.node){
+                throw(error("stack element is value, in binary operator."));
+            }
+            poly::node *l = el.node, *r = er.node;
+        }
+
+        std::unique_ptr<eval_target> lhs, rhs;
+    };
+
+    struct binary_operator_add : binary_operator{
+        virtual std::string ast_str() const{
+            std::string str;
+            str += "(";
+            str += "+ " + lhs->ast_str() + " " + rhs->ast_str();
+            str += ")";
+            return str;
+        }
+
+        virtual void eval(semantic_data &sd) const{
+            lhs->eval(sd);
+            rhs->eval(sd);
+            stack_element er = sd.pop_stack(), el = sd.pop_stack();
+            if(!er.node || !el.node){
+                throw(error("stack element is value, in add operator."));
+            }
+            poly::node *l = el.node, *r = er.node;
+            operand_guard guard(sd.ctx(), l, nullptr);
+            poly::add(sd.ctx(), l, r);
+            guard.release();
+            sd.push_stack(l);
+        }
+
+        virtual void compile(numeric_compiler &nc) const{
+            lhs->compile(nc);
+            rhs->compile(nc);
+            nc.emit(numeric_program::op_add);
+        }
+
+        // 整列した項の併合
+        virtual cost estimate(cost_estimator &ce) const{
+            cost l = ce(*lhs), r = ce(*rhs);
+            return cost(l.terms + r.terms, l.work + r.work + l.terms + r.terms);
+        }
+    };
+
+    struct binary_operator_sub : binary_operator{
+        virtual std::string ast_str() const{
+            std::string str;
+            str += "(";
+            str += "- " + lhs->ast_str() + " " + rhs->ast_str();
+            str += ")";
+            return str;
+        }
+
+        virtual void eval(semantic_data &sd) const{
+            lhs->eval(sd);
+            rhs->eval(sd);
+            stack_element er = sd.pop_stack(), el = sd.pop_stack();
+            if(!er.node || !el.node){
+                throw(error("stack element is value, in sub operator."));
+            }
+            poly::node *l = el.node, *r = er.node;
+            operand_guard guard(sd.ctx(), l, nullptr);
+            poly::sub(sd.ctx(), l, r);
+            guard.release();
+            sd.push_stack(l);
+        }
+
+        virtual void compile(numeric_compiler &nc) const{
+            lhs->compile(nc);
+            rhs->compile(nc);
+            nc.emit(numeric_program::op_sub);
+        }
+
+        // 整列した項の併合
+        virtual cost estimate(cost_estimator &ce) const{
+            cost l = ce(*lhs), r = ce(*rhs);
+            return cost(l.terms + r.terms, l.work + r.work + l.terms + r.terms);
+        }
+    };
+
+    struct binary_operator_mul : binary_operator{
+        virtual std::string ast_str() const{
+            std::string str;
+            str += "(";
+            str += "* " + lhs->ast_str() + " " + rhs->ast_str();
+            str += ")";
+            return str;
+        }
+
+        virtual void eval(semantic_data &sd) const{
+            lhs->eval(sd);
+            rhs->eval(sd);
+            stack_element er = sd.pop_stack(), el = sd.pop_stack();
+            if(!er.node || !el.node){
+                throw(error("stack element is value, in multiply operator."));
+            }
+            poly::node *l = el.node, *r = er.node;
+            operand_guard guard(sd.ctx(), l, r);
+            sd.push_stack(poly::multiply(sd.ctx(), r, l));
+        }
+
+        virtual void compile(numeric_compiler &nc) const{
+            lhs->compile(nc);
+            rhs->compile(nc);
+            nc.emit(numeric_program::op_mul);
+        }
+
+        virtual cost estimate(cost_estimator &ce) const{
+            cost l = ce(*lhs), r = ce(*rhs), c = cost_estimator::multiply_cost(l.terms, r.terms);
+            c.work += l.work + r.work;
+            return c;
+        }
+    };
+
+    struct binary_operator_div : binary_operator{
+        virtual std::string ast_str() const{
+            std::string str;
+            str += "(";
+            str += "/ " + lhs->ast_str() + " " + rhs->ast_str();
+            str += ")";
+            return str;
+        }
+
+        virtual void eval(semantic_data &sd) const{
+            lhs->eval(sd);
+            rhs->eval(sd);
+            stack_element er = sd.pop_stack(), el = sd.pop_stack();
+            if(!er.node || !el.node){
+                throw(error("stack element is value, in divide operator."));
+            }
+            poly::node *l = el.node, *r = er.node;
+            operand_guard guard(sd.ctx(), l, r);
+            sd.push_stack(poly::divide(sd.ctx(), l, r, nullptr));
+        }
+
+        virtual void compile(numeric_compiler &nc) const{
+            lhs->compile(nc);
+            rhs->compile(nc);
+            nc.emit(numeric_program::op_div);
+        }
+
+        virtual cost estimate(cost_estimator &ce) const{
+            cost l = ce(*lhs), r = ce(*rhs), c = cost_estimator::divide_cost(l.terms, r.terms);
+            c.work += l.work + r.work;
+            return c;
+        }
+    };
+
+    struct binary_operator_pow : binary_operator{
+        virtual std::string ast_str() const{
+            std::string str;
+            str += "(";
+            str += "^ " + lhs->ast_str() + " " + rhs->ast_str();
+            str += ")";
+            return str;
+        }
+
+        virtual void eval(semantic_data &sd) const{
+            lhs->eval(sd);
+            rhs->eval(sd);
+            stack_element er = sd.pop_stack(), el = sd.pop_stack();
+            if(!er.node || !el.node){
+                throw(error("stack element is value, in power operator."));
+            }
+            poly::node *l = el.node, *r = er.node;
+            operand_guard guard(sd.ctx(), l, r);
+            sd.push_stack(poly::power(sd.ctx(), l, r));
+        }
+
+        virtual void compile(numeric_compiler &nc) const{
+            lhs->compile(nc);
+            rhs->compile(nc);
+            nc.emit(numeric_program::op_pow);
+        }
+
+        // 指数が非負整数の定数の時だけ展開の費用が掛かる
+        // それ以外は1項の結果になるか, 評価で拒否される
+        virtual cost estimate(cost_estimator &ce) const{
+            cost l = ce(*lhs), r = ce(*rhs), c;
+            fpoint n;
+            if(l.terms > 1 && ce.constant_value(*rhs, n) && n >= 0 && n == std::floor(n)){
+                c = cost_estimator::power_cost(l.terms, n);
+            }
+            c.work += l.work + r.work;
+            return c;
+        }
+    };
+
+    struct negate_expr : eval_target{
+        negate_expr() : operand(nullptr){}
+
+        virtual std::string ast_str() const{
+            return "-" + operand->ast_str();
+        }
+
+        virtual void eval(semantic_data &sd) const{
+            operand->eval(sd);
+            stack_element a = sd.pop_stack();
+            if(!a.node){
+                throw(error("operand is lambda expression, in neg operator."));
+            }
+            poly::change_sign(a.node);
+            sd.push_stack(a.node);
+        }
+
+        virtual void compile(numeric_compiler &nc) const{
+            operand->compile(nc);
+            nc.emit(numeric_program::op_negate);
+        }
+
+        virtual cost estimate(cost_estimator &ce) const{
+            cost c = ce(*operand);
+            c.work += c.terms;
+            return c;
+        }
+
+        std::unique_ptr<eval_target> operand;
+    };
+
+    struct lambda;
+
+    struct sequence : eval_target{
+        sequence() : e(nullptr), next(nullptr), head(nullptr){}
+
+        virtual std::string ast_str() const{
+            std::string str;
+            str += "(seq";
+            for(const sequence *ptr = head; ptr; ptr = ptr->next.get()){
+                str += " " + ptr->e->ast_str();
+            }
+            str += ")";
+            return str;
+        }
+
+        virtual void eval(semantic_data &sd) const{
+            if(head == this){
+                e->eval(sd);
+                return;
+            }
+            for(const sequence *ptr = head->next.get(); ptr; ptr = ptr->next.get()){
+                ptr->e->eval(sd);
+            }
+            sd.push_stack(head->e.get());
+        }
+
+        virtual cost estimate(cost_estimator &ce) const{
+            if(head == this){ return ce(*e); }
+            cost c;
+            for(const sequence *ptr = head->next.get(); ptr; ptr = ptr->next.get()){
+                c.work += ce(*ptr->e).work;
+            }
+            return c;
+        }
+
+        // 評価対象の式
+        std::unique_ptr<eval_target> e;
+
+        // リンクリスト 次の評価対象の式
+        std::unique_ptr<sequence> next;
+
+        // 先頭
+        sequence *head;
+    };
+
+    struct lambda : sequence{
+        lambda() : args(nullptr), name(){}
+
+        virtual std::string ast_str() const{
+            std::string str;
+            str += *name.ptr;
+            for(const sequence *ptr = args->head; ptr; ptr = ptr->next.get()){
+                str += " " + ptr->e->ast_str();
+            }
+            str += " -> " + e->ast_str();
+            return str;
+        }
+
+        virtual void eval(semantic_data &sd) const{
+            sd.push_stack(this);
+        }
+
+        virtual cost estimate(cost_estimator&) const{
+            return cost(1, 1);
+        }
+
+        // lambda式の引数
+        std::unique_ptr<sequence> args;
+
+        // lambda式の名前
+        str_wrapper name;
+    };
+
+    struct equality : eval_target{
+        equality() : s(nullptr), e(nullptr){}
+
+        virtual std::string ast_str() const{
+            std::string str;
+            str += s->ast_str();
+            str += " = ";
+            str += e->ast_str();
+            return str;
+        }
+
+        virtual void eval(semantic_data &sd) const{
+            e->eval(sd);
+            stack_element se = sd.pop_stack();
+            sd.register_local_arg(s.get(), se);
+        }
+
+        virtual cost estimate(cost_estimator &ce) const{
+            cost c = ce(*e);
+            ce.bind(*s, c);
+            return c;
+        }
+
+        virtual void compile(numeric_compiler &nc) const{
+            e->compile(nc);
+            nc.store(*s);
+        }
+
+        // 左辺 記号
+        std::unique_ptr<symbol> s;
+
+        // 右辺 式
+        std::unique_ptr<eval_target> e;
+    };
+
+    struct equality_sequence : eval_target{
+        equality_sequence() : e(nullptr), next(nullptr), head(nullptr){}
+
+        virtual std::string ast_str() const{
+            return "";
+        }
+
+        virtual void eval(semantic_data &sd) const{
+            for(const equality_sequence *ptr = head; ptr; ptr = ptr->next.get()){
+                ptr->e->eval(sd);
+            }
+        }
+
+        virtual cost estimate(cost_estimator &ce) const{
+            cost c(0, 0);
+            for(const equality_sequence *ptr = head; ptr; ptr = ptr->next.get()){
+                c.work += ce(*ptr->e).work;
+            }
+            return c;
+        }
+
+        virtual void compile(numeric_compiler &nc) const{
+            for(const equality_sequence *ptr = head; ptr; ptr = ptr->next.get()){
+                ptr->e->compile(nc);
+            }
+        }
+
+        // 等式
+        std::unique_ptr<equality> e;
+
+        // リンクリスト 次の等式
+        std::unique_ptr<equality_sequence> next;
+
+        // 先頭
+        equality_sequence *head;
+    };
+
+    struct statement : eval_target{
+        statement() : e(nullptr), w(nullptr){}
+
+        virtual std::string ast_str() const{
+            std::string str;
+            str += e->ast_str();
+            if(w){
+                str += " where";
+                for(const equality_sequence *ptr = w.get()->head; ptr; ptr = ptr->next.get()){
+                    str += (ptr != w.get()->head ? ", " : " ") + ptr->e->ast_str();
+                }
+            }
+            return str;
+        }
+
+        virtual void eval(semantic_data &sd) const{
+            if(!w){
+                e->eval(sd);
+                return;
+            }
+            // where部の束縛はこの文の中でのみ有効
+            sd.push_local_args();
+            w->eval(sd);
+            e->eval(sd);
+            stack_element se = sd.pop_stack();
+            sd.pop_local_args();
+            if(se.node){ sd.push_stack(se.node); }else{ sd.push_stack(se.v); }
+        }
+
+        virtual cost estimate(cost_estimator &ce) const{
+            // where部の無い文は式と同じ行になるので, 式の見積りをそのまま使う
+            if(!w){ return e->estimate(ce); }
+            ce.push_scope();
+            cost b = ce(*w), c = ce(*e);
+            ce.pop_scope();
+            c.work += b.work;
+            return c;
+        }
+
+        virtual void compile(numeric_compiler &nc) const{
+            if(!w){
+                e->compile(nc);
+                return;
+            }
+            nc.push_scope();
+            w->compile(nc);
+            e->compile(nc);
+            nc.pop_scope();
+        }
+
+        // 評価対象の式
+        std::unique_ptr<eval_target> e;
+
+        // where部
+        std::unique_ptr<equality_sequence> w;
+    };
+
+    struct defined_symbol : eval_target{
+        defined_symbol() : e(nullptr), s(nullptr){}
+
+        virtual std::string ast_str() const{
+            std::string str;
+            str += s->ast_str();
+            str += " = ";
+            str += e->ast_str();
+            return str;
+        }
+
+        // 右辺を評価し, 展開された値を大域に束縛する
+        // 依存関係を記録する場合, 右辺は束縛と共有され再計算に使われる
+        // 文の値として束縛した値を返す
+        virtual void eval(semantic_data &sd) const{
+            const poly::node *p = sd.define_let_value(s.get(), e);
+            sd.push_stack(poly::copy(sd.ctx(), p));
+        }
+
+        virtual cost estimate(cost_estimator &ce) const{
+            cost c = ce(*e);
+            c.work += c.terms;
+            return c;
+        }
+
+        // 束縛対象の式
+        std::shared_ptr<eval_target> e;
+
+        // 束縛対象に結び付けられる名前
+        std::unique_ptr<symbol> s;
+    };
+
+    struct undefined_symbol : eval_target{
+        undefined_symbol() : s(nullptr){}
+
+        virtual std::string ast_str() const{
+            return "unlet " + s->ast_str();
+        }
+
+        // 最も新しい束縛を取り消す
+        // 文の値として取り消した後の記号の値を返す
+        virtual void eval(semantic_data &sd) const{
+            if(!sd.unregister_let_value(s.get())){
+                throw(error("symbol is not defined, " + s->ast_str() + "."));
+            }
+            s->eval(sd);
+        }
+
+        // 取り消した後の値は分からないので, 取り消す前の値で上から抑える
+        virtual cost estimate(cost_estimator &ce) const{
+            return ce(*s);
+        }
+
+        // 束縛を取り消す名前
+        std::unique_ptr<symbol> s;
+    };
+
+
+    // ---- semantic action
+    class semantic_action{
+    public:
+        semantic_action() : cx(nullptr){}
+
+        // 構文解析の間に記号表と計数器を使うコンテキスト
+        // 構文解析の前に評価器が設定する
+        scalc::context *cx;
+
+        void syntax_error(){
+            throw(error("syntax error."));
+        }
+
+        void stack_overflow(){
+            throw(error("stack overflow."));
+        }
+
+        // まだどの節点にも持たれていない節点
+        // 構文解析が失敗した時に, 構文解析器のstackに残った葉と作りかけの部分木を解放するために持つ
+        // 連結リストは先頭が残りを持つので, 先頭を置く
+        std::vector<eval_target*> roots;
+
+        void hold(eval_target *x){
+            roots.push_back(x);
+        }
+
+        // xを親の節点が持つようになった. 直前に置いたものほど先に持たれる
+        void adopt(eval_target *x){
+            if(!x){ return; }
+            for(std::size_t i = roots.size(); i > 0; --i){
+                if(roots[i - 1] == x){
+                    roots.erase(roots.begin() + (i - 1));
+                    return;
+                }
+            }
+        }
+
+        // 受理した. 根は呼び出し側が持つ
+        void release(){
+            roots.clear();
+        }
+
+        // 失敗した. 残った節点を解放する
+        void dispose(){
+            for(auto iter = roots.begin(); iter != roots.end(); ++iter){
+                delete *iter;
+            }
+            roots.clear();
+        }
+
+        template<class T>
+        static void downcast(T *&x, eval_target *y){
+            x = static_cast<T*>(y);
+        }
+
+        template<class U>
+        static void upcast(eval_target *&x, U *y){
+            x = y;
+        }
+
+        eval_target *make_statement(eval_target *e, equality_sequence *es){
+            statement *s = new statement;
+            hold(s);
+            adopt(es ? es->head : nullptr);
+            adopt(e);
+            s->e.reset(e);
+            // make_equality_sequenceは列の末尾を返すので, 先頭から持つ
+            s->w.reset(es ? es->head : nullptr);
+            return s;
+        }
+
+        eval_target *define_symbol(symbol *s, eval_target *e){
+            defined_symbol *d = new defined_symbol;
+            hold(d);
+            adopt(e);
+            adopt(s);
+            d->e.reset(e);
+            d->s.reset(s);
+            return d;
+        }
+
+        eval_target *undefine_symbol(symbol *s){
+            undefined_symbol *u = new undefined_symbol;
+            hold(u);
+            adopt(s);
+            u->s.reset(s);
+            return u;
+        }
+
+        equality_sequence *make_equality_sequence(equality *e){
+            equality_sequence *es = new equality_sequence;
+            hold(es);
+            adopt(e);
+            es->e.reset(e);
+            es->head = es;
+            return es;
+        }
+
+        equality_sequence *make_equality_sequence(equality_sequence *es, equality *e){
+            equality_sequence *ptr = new equality_sequence;
+            adopt(e);
+            ptr->e.reset(e);
+            if(es){
+                ptr->head = es->head;
+                es->next.reset(ptr);
+            }else{
+                hold(ptr);
+                ptr->head = ptr;
+            }
+            return ptr;
+        }
+
+        equality *make_equality(symbol *s, eval_target *e){
+            equality *ptr = new equality;
+            hold(ptr);
+            adopt(e);
+            adopt(s);
+            ptr->s.reset(s);
+            ptr->e.reset(e);
+            return ptr;
+        }
+
+        eval_target *make_add(eval_target *lhs, eval_target *rhs){
+            binary_operator_add *e = new binary_operator_add;
+            hold(e);
+            adopt(rhs);
+            adopt(lhs);
+            e->lhs.reset(lhs);
+            e->rhs.reset(rhs);
+            return e;
+        }
+
+        eval_target *make_sub(eval_target *lhs, eval_target *rhs){
+            binary_operator_sub *e = new binary_operator_sub;
+            hold(e);
+            adopt(rhs);
+            adopt(lhs);
+            e->lhs.reset(lhs);
+            e->rhs.reset(rhs);
+            return e;
+        }
+
+        eval_target *make_mul(eval_target *lhs, eval_target *rhs){
+            binary_operator_mul *e = new binary_operator_mul;
+            hold(e);
+            adopt(rhs);
+            adopt(lhs);
+            e->lhs.reset(lhs);
+            e->rhs.reset(rhs);
+            return e;
+        }
+
+        eval_target *make_div(eval_target *lhs, eval_target *rhs){
+            binary_operator_div *e = new binary_operator_div;
+            hold(e);
+            adopt(rhs);
+            adopt(lhs);
+            e->lhs.reset(lhs);
+            e->rhs.reset(rhs);
+            return e;
+        }
+
+        eval_target *make_pow(eval_target *lhs, eval_target *rhs){
+            binary_operator_pow *e = new binary_operator_pow;
+            hold(e);
+            adopt(rhs);
+            adopt(lhs);
+            e->lhs.reset(lhs);
+            e->rhs.reset(rhs);
+            return e;
+        }
+
+        negate_expr *make_negate_expr(eval_target *e){
+            negate_expr *n = new negate_expr;
+            hold(n);
+            adopt(e);
+            n->operand.reset(e);
+            return n;
+        }
+
+        sequence *make_seq(sequence *s, eval_target *e){
+            sequence *ptr = new sequence;
+            adopt(e);
+            ptr->e.reset(e);
+            if(s){
+                ptr->head = s->head;
+                s->next.reset(ptr);
+            }else{
+                hold(ptr);
+                ptr->head = ptr;
+            }
+            return ptr;
+        }
+
+        sequence *make_seq(eval_target *e){
+            sequence *ptr = new sequence;
+            hold(ptr);
+            adopt(e);
+            ptr->e.reset(e);
+            ptr->head = ptr;
+            return ptr;
+        }
+
+        sequence *make_lambda(sequence *s, eval_target *e){
+            lambda *l = new lambda;
+            hold(l);
+            adopt(e);
+            adopt(s ? s->head : nullptr);
+            l->name = lambda_name();
+            l->args.reset(s);
+            l->e.reset(e);
+            l->head = l;
+            return make_seq(nullptr, l);
+        }
+
+        template<class T>
+        T *identity(T *subtree){
+            return subtree;
+        }
+
+    private:
+        str_wrapper lambda_name();
+    };}
+
+#endif // SCALC_ANALYZER_HPP
@@ -0,0 +1,89 @@
+﻿// 連続評価のテスト
+// --batchの逐次, --jobs, --pipelineの出力が, 1文ずつ引数で評価した出力を順に並べたものと同じになることを確かめる
+// make testが作ったscalcを起動する
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include "test.hpp"
+
+namespace{
+    // letを含まず, 文の間で状態を共有しない文
+    // 構文の誤りも混ぜ, 失敗の書き出しも比べる
+    const char *const statements[] = {
+        "1+2",
+        "(x+1)^3",
+        "(a+b)*(a-b)",
+        "2^(1/2)",
+        "x where x = 3",
+        "x+",
+        "(x + y)^8 - 3*x*y",
+        "a * b / c + d - e where a = 1.5, b = 2, c = 3i, d = x^2",
+        "f x y -> x^2 + y^2",
+        ")",
+        "x^2 - 2*x + 1",
+        "(4 * a)^(-3i)",
+        "12345678901234567890 + 0.1",
+        // 0による除算と0の冪は失敗にして, 続く文を評価する
+        "1/0",
+        "x/0",
+        "0^2",
+        "0^x",
+        "x + 1"
+    };
+
+    std::string run(const std::string &command){
+        std::string out;
+        FILE *fp = popen(command.c_str(), "r");
+        if(!fp){ return out; }
+        char buf[4096];
+        std::size_t n;
+        while((n = std::fread(buf, 1, sizeof(buf), fp)) > 0){ out.append(buf, n); }
+        pclose(fp);
+        return out;
+    }
+
+    void batch_matches_single_statements(){
+        char path[] = "/tmp/scalc_batch_testXXXXXX";
+        int fd = mkstemp(path);
+        CHECK(fd >= 0);
+        if(fd < 0){ return; }
+
+        // 数を増やし, 並列の評価でworkerを跨いでも順序が保たれることを見る
+        std::string input, expected;
+        for(int i = 0; i < 20; ++i){
+            for(std::size_t k = 0; k < sizeof(statements) / sizeof(statements[0]); ++k){
+                input += statements[k];
+                input += '\n';
+                if(i == 0){ expected += run(std::string("./scalc '") + statements[k] + "'"); }
+            }
+        }
+        CHECK(run("./scalc '1/0'") == "division by zero.\n");
+        CHECK(run("./scalc 'x/0'") == "division by zero.\n");
+        CHECK(run("./scalc '0^2'") == "0\n");
+        CHECK(run("./scalc '0^x'") == "reject, constant^symbol.\n");
+        std::string single(expected);
+        for(int i = 1; i < 20; ++i){ expected += single; }
+        CHECK(write(fd, input.data(), input.size()) == static_cast<ssize_t>(input.size()));
+        close(fd);
+
+        std::string file(path);
+        CHECK(!single.empty());
+        CHECK(run("./scalc --batch " + file) == expected);
+        CHECK(run("./scalc --batch --jobs 4 " + file) == expected);
+        CHECK(run("./scalc --batch --pipeline " + file) == expected);
+        CHECK(run("./scalc --batch --dfa-lexer " + file) == expected);
+        CHECK(run("./scalc --batch --ast-cache 4 " + file) == expected);
+        CHECK(run("./scalc --batch --cache-size 65536 " + file + " 2>/dev/null") == expected);
+        CHECK(run("./scalc --batch --jobs 4 --cache-size 65536 " + file + " 2>/dev/null") == expected);
+        CHECK(run("./scalc --batch < " + file) == expected);
+        unlink(path);
+    }
+}
+
+int main(){
+    batch_matches_single_statements();
+    return test::result("batch_test");
+}
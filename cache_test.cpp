@@ -0,0 +1,107 @@
+﻿// 結果のcacheのテスト
+// 当たり, 外れ, 古く使われたものからの追い出し, 表記の違う同じ文が当たること,
+// letを含む文と束縛された記号を使う文がcacheされないことを確かめる
+
+#include <string>
+#include <cstring>
+#include "scalc.hpp"
+#include "result_cache.hpp"
+#include "test.hpp"
+
+namespace{
+    std::string eval(scalc::evaluator &ev, scalc::context &cx, const char *statement){
+        try{
+            return ev.eval(cx, statement, statement + std::strlen(statement));
+        }catch(std::exception &e){
+            return e.what();
+        }
+    }
+
+    void hit_and_miss(){
+        scalc::result_cache cache(1 << 16);
+        std::string value;
+        CHECK(!cache.find("a", value));
+        cache.insert("a", "1");
+        CHECK(cache.find("a", value) && value == "1");
+        CHECK(cache.hits() == 1 && cache.misses() == 1);
+        CHECK(cache.size() > 0);
+        cache.clear();
+        CHECK(cache.size() == 0);
+        CHECK(!cache.find("a", value));
+    }
+
+    void eviction(){
+        scalc::result_cache probe(1 << 16);
+        probe.insert("a", "1");
+        std::size_t one = probe.size();
+
+        // 2つだけ収まる
+        scalc::result_cache cache(one * 2 + one / 2);
+        std::string value;
+        cache.insert("a", "1");
+        cache.insert("b", "2");
+        // aを使ってbを古くする
+        CHECK(cache.find("a", value));
+        cache.insert("c", "3");
+        CHECK(cache.size() <= cache.capacity());
+        CHECK(cache.find("a", value) && value == "1");
+        CHECK(!cache.find("b", value));
+        CHECK(cache.find("c", value) && value == "3");
+
+        // 1つでcapacityを超えるものは登録せず, 他を追い出さない
+        cache.insert("d", std::string(one * 4, 'x'));
+        CHECK(!cache.find("d", value));
+        CHECK(cache.find("a", value) && cache.find("c", value));
+    }
+
+    void statements(){
+        scalc::result_cache cache(1 << 16);
+        scalc::context cx;
+        cx.set_result_cache(&cache);
+        scalc::evaluator ev;
+
+        CHECK(eval(ev, cx, "(x + 1)^2") == "x^2+2*x+1");
+        CHECK(cache.misses() == 1 && cache.hits() == 0);
+        // 空白と数値の表記の違いは同じ文
+        CHECK(eval(ev, cx, " ( x+1.0 ) ^ 2.00 ") == "x^2+2*x+1");
+        CHECK(cache.hits() == 1);
+        // 記号の違いは別の文
+        CHECK(eval(ev, cx, "(y + 1)^2") == "y^2+2*y+1");
+        CHECK(cache.misses() == 2);
+
+        // letとunletは引きも登録もしない
+        std::size_t size = cache.size(), hits = cache.hits(), misses = cache.misses();
+        CHECK(eval(ev, cx, "let x = 2") == "2");
+        CHECK(eval(ev, cx, "let x = 2") == "2");
+        CHECK(cache.size() == size && cache.hits() == hits && cache.misses() == misses);
+
+        // 束縛された記号を使う文は束縛の値で評価し, cacheしない
+        CHECK(eval(ev, cx, "(x + 1)^2") == "9");
+        CHECK(eval(ev, cx, "unlet x") == "2");
+        CHECK(eval(ev, cx, "(x + 1)^2") == "9");
+        CHECK(eval(ev, cx, "unlet x") == "x");
+        CHECK(cache.size() == size && cache.hits() == hits && cache.misses() == misses);
+
+        // 束縛が無くなればまた当たる
+        CHECK(eval(ev, cx, "(x + 1)^2") == "x^2+2*x+1");
+        CHECK(cache.hits() == hits + 1);
+
+        // 書式ごとに分ける
+        cx.set_output_format(scalc::output_json);
+        CHECK(eval(ev, cx, "(x + 1)^2") != "x^2+2*x+1");
+        CHECK(cache.misses() == misses + 1);
+
+        // 失敗した文は登録しない
+        cx.set_output_format(scalc::output_text);
+        size = cache.size();
+        CHECK(eval(ev, cx, "x +") == "syntax error.");
+        CHECK(cache.size() == size);
+    }
+}
+
+int main(){
+    hit_and_miss();
+    eviction();
+    statements();
+    return test::result("cache_test");
+}
@@ -0,0 +1,220 @@
+﻿#include <new>
+#include <string>
+#include <memory>
+#include <chrono>
+#include "scalc.hpp"
+#include "wire.hpp"
+#include "scalc.h"
+
+struct scalc_ctx{
+    scalc_ctx() : cx(), ev(), token(){
+        cx.set_cancel_token(&token);
+    }
+
+    scalc::context cx;
+    scalc::evaluator ev;
+    scalc::cancel_token token;
+    std::unique_ptr<scalc::disk_cache> disk;
+};
+
+// 結果の多項式は評価したコンテキストの割り当て器に返す
+struct scalc_result{
+    explicit scalc_result(scalc::context &cx_) : cx(cx_), node(nullptr), message(), peak(0), encoded(){}
+    ~scalc_result(){
+        if(node){ poly::dispose(cx, node); }
+    }
+
+    scalc::context &cx;
+    poly::node *node;
+    std::string message;
+    size_t peak;
+
+    // scalc_result_encodeで書き出した応答
+    std::unique_ptr<output_buffer> encoded;
+};
+
+namespace{
+    // 多項式は先頭に値を持たないnodeを置くリンクリスト
+    // scalc_polyは先頭のnodeを, scalc_termは値を持つnodeを指す
+    inline const poly::node *node_of(const scalc_poly *p){
+        return reinterpret_cast<const poly::node*>(p);
+    }
+
+    inline const poly::node *node_of(const scalc_term *t){
+        return reinterpret_cast<const poly::node*>(t);
+    }
+
+    inline const scalc_term *term_of(const poly::node *p){
+        return reinterpret_cast<const scalc_term*>(p);
+    }
+}
+
+extern "C" {
+
+scalc_ctx *scalc_ctx_new(void){
+    // nothrowは確保の失敗しか防がない. コンテキストの構築で投げられた例外もCの呼び出し側へ出さない
+    try{
+        return new scalc_ctx;
+    }catch(...){
+        return nullptr;
+    }
+}
+
+void scalc_ctx_free(scalc_ctx *ctx){
+    delete ctx;
+}
+
+void scalc_ctx_set_timeout(scalc_ctx *ctx, unsigned long ms){
+    ctx->cx.set_time_limit(std::chrono::milliseconds(ms));
+}
+
+void scalc_ctx_set_memory_limit(scalc_ctx *ctx, size_t bytes){
+    ctx->cx.set_memory_limit(bytes);
+}
+
+void scalc_ctx_set_max_cost(scalc_ctx *ctx, double work){
+    ctx->cx.set_cost_limit(work);
+}
+
+void scalc_ctx_set_ast_cache(scalc_ctx *ctx, size_t n){
+    ctx->cx.set_template_limit(n);
+}
+
+void scalc_ctx_set_let_tracking(scalc_ctx *ctx, int enable){
+    ctx->cx.set_let_tracking(enable != 0);
+}
+
+void scalc_ctx_set_dfa_lexer(scalc_ctx *ctx, int enable){
+    ctx->cx.set_dfa_lexer(enable != 0);
+}
+
+int scalc_ctx_open_disk_cache(scalc_ctx *ctx, const char *path){
+    ctx->cx.set_disk_cache(nullptr);
+    try{
+        ctx->disk.reset(path ? new scalc::disk_cache(path) : nullptr);
+    }catch(std::exception&){
+        ctx->disk.reset();
+        return -1;
+    }
+    ctx->cx.set_disk_cache(ctx->disk.get());
+    return 0;
+}
+
+void scalc_ctx_cancel(scalc_ctx *ctx){
+    ctx->token.cancel();
+}
+
+scalc_result *scalc_eval(scalc_ctx *ctx, const char *str, size_t len){
+    scalc_result *r = new(std::nothrow) scalc_result(ctx->cx);
+    if(!r){ return nullptr; }
+    ctx->token.reset();
+    try{
+        r->node = ctx->ev.evaluate(ctx->cx, str, str + len);
+    }catch(std::exception &e){
+        try{
+            r->message = e.what();
+            if(r->message.empty()){ r->message = "error."; }
+        }catch(...){
+            delete r;
+            return nullptr;
+        }
+    }
+    r->peak = ctx->cx.peak_memory();
+    return r;
+}
+
+scalc_result *scalc_eval_request(scalc_ctx *ctx, const void *request, size_t len){
+    scalc_result *r = new(std::nothrow) scalc_result(ctx->cx);
+    if(!r){ return nullptr; }
+    ctx->token.reset();
+    try{
+        const char *first = static_cast<const char*>(request);
+        std::pair<const char*, const char*> statement;
+        scalc::binding_list bindings;
+        scalc::decode_request(ctx->cx, first, first + len, statement, bindings);
+        r->node = ctx->ev.evaluate(ctx->cx, statement.first, statement.second, bindings);
+    }catch(std::exception &e){
+        try{
+            r->message = e.what();
+            if(r->message.empty()){ r->message = "error."; }
+        }catch(...){
+            delete r;
+            return nullptr;
+        }
+    }
+    r->peak = ctx->cx.peak_memory();
+    return r;
+}
+
+const void *scalc_result_encode(scalc_result *r, size_t *len){
+    try{
+        if(!r->encoded){
+            r->encoded.reset(new output_buffer);
+            if(r->node){
+                scalc::encode_result(r->node, r->peak, *r->encoded);
+            }else{
+                scalc::encode_error(r->message.c_str(), *r->encoded);
+            }
+        }
+    }catch(...){
+        r->encoded.reset();
+        return nullptr;
+    }
+    *len = r->encoded->size();
+    return r->encoded->data();
+}
+
+size_t scalc_result_peak_memory(const scalc_result *r){
+    return r->peak;
+}
+
+void scalc_result_free(scalc_result *r){
+    delete r;
+}
+
+const char *scalc_result_error(const scalc_result *r){
+    return r->node ? nullptr : r->message.c_str();
+}
+
+const scalc_poly *scalc_result_poly(const scalc_result *r){
+    return reinterpret_cast<const scalc_poly*>(r->node);
+}
+
+size_t scalc_poly_term_count(const scalc_poly *p){
+    size_t n = 0;
+    for(const poly::node *q = node_of(p)->next; q; q = q->next){ ++n; }
+    return n;
+}
+
+const scalc_term *scalc_poly_first_term(const scalc_poly *p){
+    return term_of(node_of(p)->next);
+}
+
+const scalc_term *scalc_term_next(const scalc_term *t){
+    return term_of(node_of(t)->next);
+}
+
+double scalc_term_real(const scalc_term *t){
+    return node_of(t)->real;
+}
+
+double scalc_term_imag(const scalc_term *t){
+    return node_of(t)->imag;
+}
+
+size_t scalc_term_factor_count(const scalc_term *t){
+    return node_of(t)->e.size();
+}
+
+size_t scalc_term_factors(const scalc_term *t, scalc_factor *out, size_t n){
+    const poly::exponent_type &e(node_of(t)->e);
+    size_t i = 0;
+    for(auto iter = e.begin(); iter != e.end() && i < n; ++iter, ++i){
+        out[i].symbol = iter->first.ptr->c_str();
+        out[i].symbol_len = iter->first.ptr->size();
+        out[i].exponent = reinterpret_cast<const scalc_poly*>(iter->second);
+    }
+    return i;
+}
+
+}
@@ -0,0 +1,184 @@
+﻿// C APIのテスト
+// コンテキストと結果の生成と破棄, 束縛がコンテキストに残ること, 項と因子の辿り方,
+// 失敗の結果, 設定の効き方, 異なるコンテキストを別々のスレッドで使えることを確かめる
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstring>
+#include <cstdint>
+#include "scalc.h"
+#include "test.hpp"
+
+namespace{
+    scalc_result *eval(scalc_ctx *ctx, const char *statement){
+        return scalc_eval(ctx, statement, std::strlen(statement));
+    }
+
+    // 結果を破棄してエラーメッセージを返す. 成功していれば空
+    std::string error_of(scalc_result *r){
+        const char *e = scalc_result_error(r);
+        std::string s = e ? e : "";
+        scalc_result_free(r);
+        return s;
+    }
+
+    void lifecycle(){
+        scalc_ctx *ctx = scalc_ctx_new();
+        CHECK(ctx != nullptr);
+        if(!ctx){ return; }
+
+        CHECK(error_of(eval(ctx, "let a = 2")) == "");
+        // 3*a*x^2*y + 2i
+        scalc_result *r = eval(ctx, "3*a*x^2*y + 2i");
+        CHECK(scalc_result_error(r) == nullptr);
+        const scalc_poly *p = scalc_result_poly(r);
+        CHECK(p != nullptr && scalc_poly_term_count(p) == 2);
+        const scalc_term *t = scalc_poly_first_term(p);
+        CHECK(t && scalc_term_real(t) == 6 && scalc_term_imag(t) == 0);
+        CHECK(t && scalc_term_factor_count(t) == 2);
+        scalc_factor f[4];
+        CHECK(t && scalc_term_factors(t, f, 4) == 2);
+        CHECK(t && std::strcmp(f[0].symbol, "x") == 0 && f[0].symbol_len == 1);
+        CHECK(t && std::strcmp(f[1].symbol, "y") == 0);
+        const scalc_term *e = t ? scalc_poly_first_term(f[0].exponent) : nullptr;
+        CHECK(e && scalc_term_real(e) == 2 && scalc_term_factor_count(e) == 0 && !scalc_term_next(e));
+        // 書き出す数を絞れる
+        CHECK(t && scalc_term_factors(t, f, 1) == 1 && std::strcmp(f[0].symbol, "x") == 0);
+        t = t ? scalc_term_next(t) : nullptr;
+        CHECK(t && scalc_term_real(t) == 0 && scalc_term_imag(t) == 2 && scalc_term_factor_count(t) == 0);
+        CHECK(t && scalc_term_next(t) == nullptr);
+
+        // 先の結果は後の評価で変わらない
+        scalc_result *s = eval(ctx, "x - x");
+        CHECK(scalc_result_error(s) == nullptr && scalc_poly_term_count(scalc_result_poly(s)) == 0);
+        CHECK(scalc_poly_first_term(scalc_result_poly(s)) == nullptr);
+        CHECK(scalc_poly_term_count(p) == 2);
+        scalc_result_free(s);
+        scalc_result_free(r);
+
+        r = eval(ctx, "x +");
+        CHECK(scalc_result_error(r) && std::strcmp(scalc_result_error(r), "syntax error.") == 0);
+        CHECK(scalc_result_poly(r) == nullptr);
+        scalc_result_free(r);
+
+        // 0による除算と0の冪は失敗の結果になり, ホストを落とさない
+        CHECK(error_of(eval(ctx, "1/0")) == "division by zero.");
+        CHECK(error_of(eval(ctx, "x/0")) == "division by zero.");
+        CHECK(error_of(eval(ctx, "0^x")) == "reject, constant^symbol.");
+        r = eval(ctx, "0^2");
+        CHECK(scalc_result_error(r) == nullptr && scalc_poly_term_count(scalc_result_poly(r)) == 0);
+        scalc_result_free(r);
+
+        // 失敗しても束縛は残る
+        r = eval(ctx, "a");
+        CHECK(scalc_term_real(scalc_poly_first_term(scalc_result_poly(r))) == 2);
+        scalc_result_free(r);
+        CHECK(error_of(eval(ctx, "unlet a")) == "");
+        r = eval(ctx, "a");
+        CHECK(scalc_term_factor_count(scalc_poly_first_term(scalc_result_poly(r))) == 1);
+        scalc_result_free(r);
+
+        scalc_ctx_free(ctx);
+        scalc_ctx_free(nullptr);
+        scalc_result_free(nullptr);
+    }
+
+    void limits(){
+        scalc_ctx *ctx = scalc_ctx_new();
+        scalc_ctx_set_memory_limit(ctx, 4096);
+        scalc_result *r = eval(ctx, "(a + b + c + d)^12");
+        CHECK(error_of(r) == "memory limit exceeded.");
+        scalc_ctx_set_memory_limit(ctx, 0);
+        r = eval(ctx, "(a + b)^3");
+        CHECK(scalc_result_error(r) == nullptr && scalc_result_peak_memory(r) > 0);
+        scalc_result_free(r);
+
+        scalc_ctx_set_max_cost(ctx, 1);
+        CHECK(error_of(eval(ctx, "(a + b + c + d)^12")) == "estimated cost exceeds limit.");
+        scalc_ctx_set_max_cost(ctx, 0);
+
+        // 取り消しは次の評価を始めた時に解除される
+        scalc_ctx_cancel(ctx);
+        CHECK(error_of(eval(ctx, "(a + b)^2")) == "");
+
+        // 雛形とDFAの字句解析は結果を変えない
+        scalc_ctx_set_ast_cache(ctx, 4);
+        scalc_ctx_set_dfa_lexer(ctx, 1);
+        r = eval(ctx, "velocity * 2");
+        CHECK(scalc_result_error(r) == nullptr && scalc_term_real(scalc_poly_first_term(scalc_result_poly(r))) == 2);
+        scalc_result_free(r);
+        r = eval(ctx, "velocity * 3");
+        CHECK(scalc_result_error(r) == nullptr && scalc_term_real(scalc_poly_first_term(scalc_result_poly(r))) == 3);
+        scalc_result_free(r);
+        CHECK(error_of(eval(ctx, "letter * 2")) == "syntax error.");
+
+        CHECK(scalc_ctx_open_disk_cache(ctx, "/nonexistent/scalc/cache") == -1);
+        CHECK(scalc_ctx_open_disk_cache(ctx, nullptr) == 0);
+        scalc_ctx_free(ctx);
+    }
+
+    void requests(){
+        scalc_ctx *ctx = scalc_ctx_new();
+        // x + 1. 束縛は無い
+        std::string req(1, 1);
+        const char statement[] = "x + 1";
+        for(int i = 0; i < 4; ++i){ req += static_cast<char>((sizeof(statement) - 1) >> (i * 8)); }
+        req += statement;
+        req.append(4, '\0');
+        scalc_result *r = scalc_eval_request(ctx, req.data(), req.size());
+        CHECK(scalc_result_error(r) == nullptr && scalc_poly_term_count(scalc_result_poly(r)) == 2);
+        std::size_t len = 0;
+        const char *encoded = static_cast<const char*>(scalc_result_encode(r, &len));
+        CHECK(encoded && len > 9 && encoded[0] == 0);
+        scalc_result_free(r);
+
+        r = scalc_eval_request(ctx, req.data(), req.size() - 1);
+        CHECK(scalc_result_error(r) && std::strcmp(scalc_result_error(r), "broken request.") == 0);
+        encoded = static_cast<const char*>(scalc_result_encode(r, &len));
+        CHECK(encoded && len == 1 + std::strlen("broken request.") && encoded[0] == 1);
+        scalc_result_free(r);
+        scalc_ctx_free(ctx);
+    }
+
+    double first_real(scalc_ctx *ctx, const char *statement){
+        scalc_result *r = eval(ctx, statement);
+        double d = scalc_result_error(r) ? -1 : scalc_term_real(scalc_poly_first_term(scalc_result_poly(r)));
+        scalc_result_free(r);
+        return d;
+    }
+
+    // コンテキストごとにスレッドを分けて同時に評価し, 1つのスレッドで評価したものと比べる
+    void threads(){
+        const char *statement = "(x + y + 1)^6 - (x - y)^5 where x = 1.5, y = 0.25";
+        scalc_ctx *ctx = scalc_ctx_new();
+        double expected = first_real(ctx, statement);
+        scalc_ctx_free(ctx);
+
+        std::vector<int> mismatches(4, 0);
+        std::vector<std::thread> ts;
+        for(std::size_t i = 0; i < mismatches.size(); ++i){
+            ts.push_back(std::thread([i, statement, expected, &mismatches](){
+                scalc_ctx *ctx = scalc_ctx_new();
+                for(int k = 0; k < 50; ++k){
+                    if(first_real(ctx, statement) != expected){ ++mismatches[i]; }
+                }
+                scalc_ctx_free(ctx);
+            }));
+        }
+        for(auto iter = ts.begin(); iter != ts.end(); ++iter){ iter->join(); }
+        bool all = expected > 0;
+        for(std::size_t i = 0; i < mismatches.size(); ++i){
+            if(mismatches[i] != 0){ all = false; }
+        }
+        CHECK(all);
+    }
+}
+
+int main(){
+    lifecycle();
+    limits();
+    requests();
+    threads();
+    return test::result("capi_test");
+}
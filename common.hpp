@@ -10,6 +10,9 @@
 #include <typeinfo>
 #include <iostream>
 #include <stdexcept>
+#include <limits>
+#include <new>
+#include "output.hpp"
 
 typedef double fpoint;
 
@@ -21,9 +24,6 @@ inline std::string to_string(const T &v){
     return ss.str();
 }
 
-// 解析対象の文字列が入るvector.
-typedef std::vector<char> statement_str;
-
 // error
 class error : public std::runtime_error{
 public:
@@ -36,6 +36,13 @@ public:
     }
 };
 
+// 評価の打ち切り
+// 期限を過ぎた時と取り消しを要求された時に投げる
+class timeout_error : public error{
+public:
+    inline timeout_error(std::string message) throw() : error(message){}
+};
+
 // multi-method
 template<class FunctionSignature, bool Symmetry = false>
 class multi_method{
@@ -67,21 +74,12 @@ private:
 };
 
 // str_wrapper
+// scalc::symbol_tableが持つ文字列の実体を指す
+// 同じ記号表から得たもの同士はポインタの比較で等しさが決まる
 class str_wrapper{
 public:
     inline str_wrapper() : ptr(nullptr){}
-    inline str_wrapper(const std::string &str) : ptr(get_ptr(str)){}
-    inline str_wrapper(const char *str) : ptr(get_ptr(str)){}
-
-    inline str_wrapper &operator =(const std::string &other){
-        ptr = get_ptr(other);
-        return *this;
-    }
-
-    inline str_wrapper &operator =(const char *other){
-        ptr = get_ptr(other);
-        return *this;
-    }
+    inline explicit str_wrapper(const std::string *ptr_) : ptr(ptr_){}
 
     inline char operator [](std::size_t idx) const{
         return (*ptr)[idx];
@@ -112,18 +110,6 @@ public:
     }
 
     const std::string *ptr;
-
-private:
-    inline static const std::string *get_ptr(const std::string &str){
-        static std::set<std::string> set;
-        auto iter = set.find(str);
-        if(iter == set.end()){
-            auto p = set.insert(str);
-            return &*p.first;
-        }else{
-            return &*iter;
-        }
-    }
 };
 
 template<class T>
@@ -131,29 +117,72 @@ inline int primitive_compare(const T &lhs, const T &rhs){
     return lhs < rhs ? -1 : lhs > rhs ? 1 : 0;
 }
 
-namespace poly{
-    template<class T>
-    class type_idx_manager{
-    private:
-        inline static std::size_t &get_global_type_idx(){
-            static std::size_t i = 0;
-            return i;
+namespace scalc{
+    class context;
+
+    // 評価が使うメモリの計量
+    // 項と指数部のmapの要素の大きさをbyteで数える
+    struct memory_meter{
+        memory_meter() : used(0), peak(0), threshold(std::numeric_limits<std::size_t>::max()), exceeded(false){}
+
+        void charge(std::size_t n){
+            used += n;
+            if(used > peak){
+                peak = used;
+                if(peak > threshold){ exceeded = true; }
+            }
         }
 
-    public:
-        template<class U>
-        inline static std::size_t get_type_idx(){
-            static const std::size_t idx = get_global_type_idx()++;
-            return idx;
+        void release(std::size_t n){
+            used -= n;
         }
+
+        // 現在の使用量, 計測を始めてからの最大の使用量
+        std::size_t used, peak;
+
+        // peakがこれを超えるとexceededが立つ
+        std::size_t threshold;
+        bool exceeded;
     };
 
+    // 指数部のmapの割り当て器
+    // 要素の大きさをmemory_meterに数える
     template<class T>
-    inline std::size_t get_type_idx(){
-        static const std::size_t idx = type_idx_manager<void>::get_type_idx<T>();
-        return idx;
-    }
+    class exponent_allocator{
+    public:
+        typedef T value_type;
+
+        exponent_allocator() : meter(nullptr){}
+        explicit exponent_allocator(memory_meter *meter_) : meter(meter_){}
 
+        template<class U>
+        exponent_allocator(const exponent_allocator<U> &other) : meter(other.meter){}
+
+        T *allocate(std::size_t n){
+            if(meter){ meter->charge(n * sizeof(T)); }
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+
+        void deallocate(T *p, std::size_t n){
+            if(meter){ meter->release(n * sizeof(T)); }
+            ::operator delete(p);
+        }
+
+        template<class U>
+        bool operator ==(const exponent_allocator<U> &other) const{
+            return meter == other.meter;
+        }
+
+        template<class U>
+        bool operator !=(const exponent_allocator<U> &other) const{
+            return meter != other.meter;
+        }
+
+        memory_meter *meter;
+    };
+}
+
+namespace poly{
     inline std::ostream &operator <<(std::ostream &o, const str_wrapper &s){
         o << *s.ptr;
         return o;
@@ -167,12 +196,21 @@ namespace poly{
         }
     };
 
-    typedef std::map<str_wrapper, node*, str_wrapper_less> exponent_type;
+    typedef std::map<
+        str_wrapper,
+        node*,
+        str_wrapper_less,
+        scalc::exponent_allocator<std::pair<const str_wrapper, node*>>
+    > exponent_type;
 
     // 多項式
+    // 項はscalc::contextの割り当て器から得て, 同じコンテキストへ返す
     struct node{
         node();
-        ~node();
+
+        // 指数部の要素をmeterに数える
+        explicit node(scalc::memory_meter *meter);
+
         void negate();
         void complex_conjugate();
 
@@ -186,23 +224,27 @@ namespace poly{
         node *next;
     };
 
-    node *new_node();
-    void dispose_node(node *p);
-    void dispose(node *p);
-    node *constant(fpoint re, fpoint im = 0);
-    node *variable(const std::string &str);
-    node *variable(const std::string &str, fpoint re, fpoint im = 0);
-    node *variable(const std::string &str, node *ptr);
+    node *new_node(scalc::context &cx);
+    void dispose_node(scalc::context &cx, node *p);
+    void dispose(scalc::context &cx, node *p);
+    node *constant(scalc::context &cx, fpoint re, fpoint im = 0);
+    node *variable(scalc::context &cx, const str_wrapper &str);
+    node *variable(scalc::context &cx, const str_wrapper &str, fpoint re, fpoint im = 0);
+    node *variable(scalc::context &cx, const str_wrapper &str, node *ptr);
     int lexicographic_compare(const node *l, const node *r);
-    node *copy(const node *p);
+    int term_compare(const node *l, const node *r);
+    node *copy(scalc::context &cx, const node *p);
     void change_sign(node *p);
     void complex_conjugate(node *p);
-    void add(node *p, node *q);
-    void sub(node *p, node *q);
-    node *multiply(const node *x, const node *y);
-    node *divide(const node *f_, const node *g, node *rem);
-    node *power(node *x, node *n);
+    void add(scalc::context &cx, node *p, node *q);
+    void sub(scalc::context &cx, node *p, node *q);
+    node *multiply(scalc::context &cx, const node *x, const node *y);
+    node *divide(scalc::context &cx, const node *f_, const node *g, node *rem);
+    node *power(scalc::context &cx, node *x, node *n);
     std::string poly_to_string(const node *p);
+    void poly_to_string(const node *p, output_buffer &o);
+    void poly_to_json(const node *p, output_buffer &o);
+    void string_to_json(const std::string &str, output_buffer &o);
 }
 
 #endif // SCALC_COMMON_HPP
@@ -0,0 +1,46 @@
+﻿#include "context.hpp"
+#include "analyzer.hpp"
+
+namespace scalc{
+    context::context(std::size_t max_let_values) : symbols(), meter(), nodes(meter), lambda_counter(0),
+        time_limit(0), deadline(), has_deadline(false), token(nullptr), interrupt_countdown(interrupt_interval),
+        memory_limit(0), memory_base(0), cost_limit_(0), cache(nullptr), disk(nullptr), template_limit_(0), dfa_lexer_(false), format_(output_text), sd()
+    {
+        sd.reset(new analyzer::semantic_data(*this));
+        sd->set_let_value_limit(max_let_values);
+    }
+
+    context::~context(){
+        close();
+    }
+
+    void context::close(){
+        sd->clear();
+        sd->clear_let_values();
+    }
+
+    std::size_t context::let_value_count() const{
+        return sd->let_value_count();
+    }
+
+    void context::set_let_tracking(bool b){
+        sd->set_let_tracking(b);
+    }
+
+    bool context::let_tracking() const{
+        return sd->let_tracking();
+    }
+
+    void context::check_interrupt_slow(){
+        interrupt_countdown = interrupt_interval;
+        if(meter.exceeded){
+            throw(error("memory limit exceeded."));
+        }
+        if(token && token->cancelled()){
+            throw(timeout_error("cancelled."));
+        }
+        if(has_deadline && clock::now() >= deadline){
+            throw(timeout_error("timeout."));
+        }
+    }
+}
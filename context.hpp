@@ -0,0 +1,312 @@
+﻿#ifndef SCALC_CONTEXT_HPP
+#define SCALC_CONTEXT_HPP
+
+#include <set>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include "common.hpp"
+
+namespace analyzer{
+    class semantic_data;
+}
+
+namespace scalc{
+    class result_cache;
+    class disk_cache;
+
+    // 結果の書式
+    enum output_format{
+        // poly_to_string
+        output_text,
+
+        // poly_to_json. 失敗は{"error":メッセージ}
+        output_json
+    };
+
+    // 記号表
+    // 記号の文字列の実体を1つにまとめる
+    // 得たstr_wrapperは記号表が破棄されるまで有効
+    class symbol_table{
+    public:
+        symbol_table() : set(), probe(){}
+
+        str_wrapper intern(const std::string &str){
+            return str_wrapper(&*set.insert(str).first);
+        }
+
+        str_wrapper intern(const char *first, const char *last){
+            return intern(std::string(first, last));
+        }
+
+        // 登録せずに引く. 無ければnullptrを返す
+        // 引く名前は使い回す文字列に写すので, 文ごとに文字列を作らない
+        const std::string *find(const char *first, const char *last) const{
+            probe.assign(first, last);
+            auto iter = set.find(probe);
+            return iter != set.end() ? &*iter : nullptr;
+        }
+
+        std::size_t size() const{
+            return set.size();
+        }
+
+    private:
+        symbol_table(const symbol_table&);
+        symbol_table &operator =(const symbol_table&);
+
+        std::set<std::string> set;
+        mutable std::string probe;
+    };
+
+    // 項の割り当て器
+    // 返された項を捨てずに保持し, 次の割り当てで再利用する
+    // 使用中の項と, その指数部の要素をmeterに数える
+    class node_allocator{
+    public:
+        explicit node_allocator(memory_meter &meter_) : meter(meter_), free_list(nullptr){}
+
+        ~node_allocator(){
+            while(free_list){
+                poly::node *p = free_list;
+                free_list = p->next;
+                delete p;
+            }
+        }
+
+        poly::node *allocate(){
+            meter.charge(sizeof(poly::node));
+            if(!free_list){ return new poly::node(&meter); }
+            poly::node *p = free_list;
+            free_list = p->next;
+            p->next = nullptr;
+            return p;
+        }
+
+        // 指数部は空にしてから返すこと
+        void deallocate(poly::node *p){
+            meter.release(sizeof(poly::node));
+            p->real = 0, p->imag = 0;
+            p->next = free_list;
+            free_list = p;
+        }
+
+    private:
+        node_allocator(const node_allocator&);
+        node_allocator &operator =(const node_allocator&);
+
+        memory_meter &meter;
+        poly::node *free_list;
+    };
+
+    // 評価の取り消し
+    // 他のスレッドからcancelを呼ぶと, このtokenを持つコンテキストは演算の途中で評価を打ち切る
+    class cancel_token{
+    public:
+        cancel_token() : flag(false){}
+
+        void cancel(){
+            flag.store(true, std::memory_order_relaxed);
+        }
+
+        void reset(){
+            flag.store(false, std::memory_order_relaxed);
+        }
+
+        bool cancelled() const{
+            return flag.load(std::memory_order_relaxed);
+        }
+
+    private:
+        cancel_token(const cancel_token&);
+        cancel_token &operator =(const cancel_token&);
+
+        std::atomic<bool> flag;
+    };
+
+    // 評価のコンテキスト
+    // 記号表, 項の割り当て器, 計数器とletによる束縛を持ち, プロセス全体で共有する状態を持たない
+    // 1つのコンテキストは同時に1つのスレッドからのみ使う
+    // ただし構文解析が使う記号表と計数器, 評価が使う割り当て器と束縛は互いに独立で,
+    // 構文解析と評価を別々のスレッドで並行して行える
+    // 異なるコンテキストは互いに干渉せず, 別々のスレッドで排他なく評価できる
+    // letによる束縛はコンテキストが閉じられるまで文の間で保持される
+    class context{
+    public:
+        // max_let_values: 同時に保持できる束縛の数. 0は無制限
+        explicit context(std::size_t max_let_values = 0);
+
+        ~context();
+
+        // 全ての束縛を破棄する
+        // コンテキストは閉じた後も空の状態から使い続けられる
+        void close();
+
+        // 保持している束縛の数
+        std::size_t let_value_count() const;
+
+        analyzer::semantic_data &data(){
+            return *sd;
+        }
+
+        typedef std::chrono::steady_clock clock;
+
+        // 1文の評価に掛けてよい時間を設定する. 0は無制限
+        // 期限は文の評価を始める度にbegin_evaluationで決まる
+        void set_time_limit(std::chrono::milliseconds limit){
+            time_limit = limit;
+        }
+
+        // 評価を取り消すtokenを設定する. nullptrであれば取り消しを受け付けない
+        void set_cancel_token(const cancel_token *token_){
+            token = token_;
+        }
+
+        // 1文の評価で新たに使ってよいメモリをbyteで設定する. 0は無制限
+        // 項と指数部のmapの要素を数える
+        void set_memory_limit(std::size_t bytes){
+            memory_limit = bytes;
+        }
+
+        // 評価の前に見積もった費用(analyzer::cost::work)の上限を設定する. 0は無制限
+        void set_cost_limit(double work){
+            cost_limit_ = work;
+        }
+
+        double cost_limit() const{
+            return cost_limit_;
+        }
+
+        // 文の結果のcacheを設定する. nullptrであれば使わない
+        // cacheは所有せず, 複数のコンテキストで共有できる
+        void set_result_cache(result_cache *cache_){
+            cache = cache_;
+        }
+
+        result_cache *result_cache_ptr() const{
+            return cache;
+        }
+
+        // 文の結果の多項式をファイルに残すcacheを設定する. nullptrであれば使わない
+        // 所有しない
+        void set_disk_cache(disk_cache *disk_cache_){
+            disk = disk_cache_;
+        }
+
+        disk_cache *disk_cache_ptr() const{
+            return disk;
+        }
+
+        // 評価器が保持する構文木の雛形の数の上限を設定する. 0は雛形を使わない
+        // token種別の列が同じ文は構文解析を省き, 雛形の数値と記号を入れ替えて評価する
+        void set_template_limit(std::size_t n){
+            template_limit_ = n;
+        }
+
+        std::size_t template_limit() const{
+            return template_limit_;
+        }
+
+        // 字句解析にlexer.txtから生成したDFA(lexer_dfa.hpp)を使うかを設定する. 既定は使わない
+        // 結果は変わらない. 長い空白, 数字, 記号が続く文で速い
+        void set_dfa_lexer(bool b){
+            dfa_lexer_ = b;
+        }
+
+        bool dfa_lexer() const{
+            return dfa_lexer_;
+        }
+
+        // 評価器が結果を書き出す書式を設定する
+        void set_output_format(output_format f){
+            format_ = f;
+        }
+
+        output_format format() const{
+            return format_;
+        }
+
+        // letの依存関係を記録するかを設定する. 既定は記録しない
+        // 記録すると, 記号を束縛し直した時にその記号に依存する束縛だけを参照された時に再計算する
+        void set_let_tracking(bool b);
+
+        bool let_tracking() const;
+
+        // 最後に評価した文が, 評価を始めた時より多く使ったメモリの最大値
+        std::size_t peak_memory() const{
+            return meter.peak - memory_base;
+        }
+
+        // 最後に評価した文がメモリの上限を超えたかどうか
+        bool memory_exceeded() const{
+            return meter.exceeded;
+        }
+
+        // 文の評価を始める. 時間制限があれば期限を, メモリの上限があれば閾値を決める
+        void begin_evaluation(){
+            has_deadline = time_limit.count() > 0;
+            if(has_deadline){ deadline = clock::now() + time_limit; }
+            interrupt_countdown = interrupt_interval;
+            memory_base = meter.used;
+            meter.peak = meter.used;
+            meter.threshold = memory_limit > 0 ? meter.used + memory_limit : std::numeric_limits<std::size_t>::max();
+            meter.exceeded = false;
+        }
+
+        // 演算の内側の繰り返しから呼ぶ
+        // interrupt_interval回に1度だけ期限と取り消しを確かめ, 打ち切る場合はtimeout_errorを投げる
+        // メモリの上限を超えていれば直ちにerrorを投げる
+        void check_interrupt(){
+            if(--interrupt_countdown == 0 || meter.exceeded){ check_interrupt_slow(); }
+        }
+
+        // lambda式に付ける通し番号を得る
+        std::size_t next_lambda_id(){
+            return lambda_counter++;
+        }
+
+        symbol_table symbols;
+        memory_meter meter;
+        node_allocator nodes;
+
+    private:
+        context(const context&);
+        context &operator =(const context&);
+
+        void check_interrupt_slow();
+
+        static const std::size_t interrupt_interval = 1024;
+
+        std::size_t lambda_counter;
+
+        // 評価の打ち切り
+        std::chrono::milliseconds time_limit;
+        clock::time_point deadline;
+        bool has_deadline;
+        const cancel_token *token;
+        std::size_t interrupt_countdown;
+
+        // メモリの上限
+        std::size_t memory_limit, memory_base;
+
+        // 見積りの上限
+        double cost_limit_;
+
+        result_cache *cache;
+        disk_cache *disk;
+
+        std::size_t template_limit_;
+
+        bool dfa_lexer_;
+
+        output_format format_;
+
+        // symbols, nodesより後に宣言し, 先に破棄する
+        std::unique_ptr<analyzer::semantic_data> sd;
+    };
+}
+
+#endif // SCALC_CONTEXT_HPP
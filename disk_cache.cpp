@@ -0,0 +1,222 @@
+﻿#include <cstring>
+#include <string>
+#include <memory>
+#if defined(__unix__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "disk_cache.hpp"
+#include "session.hpp"
+
+namespace scalc{
+    namespace{
+        const char magic[8] = { 'S', 'C', 'A', 'L', 'C', 'D', 'C', 2 };
+        const std::size_t header_size = 64;
+
+        // headerの各欄の位置
+        const std::size_t slot_count_pos = 8, data_pos_pos = 16, data_size_pos = 24, data_end_pos = 32;
+
+        static_assert(sizeof(std::atomic<std::uint64_t>) == 8, "std::atomic<std::uint64_t> must be 8 bytes.");
+
+        std::uint64_t load_u64(const char *p){
+            std::uint64_t n;
+            std::memcpy(&n, p, 8);
+            return n;
+        }
+
+        void store_u64(char *p, std::uint64_t n){
+            std::memcpy(p, &n, 8);
+        }
+
+        inline std::uint64_t rotl(std::uint64_t x, int r){
+            return (x << r) | (x >> (64 - r));
+        }
+
+        inline std::uint64_t fmix(std::uint64_t k){
+            k ^= k >> 33;
+            k *= 0xff51afd7ed558ccdULL;
+            k ^= k >> 33;
+            k *= 0xc4ceb9fe1a85ec53ULL;
+            k ^= k >> 33;
+            return k;
+        }
+
+#if defined(__unix__)
+        // flockで他のプロセスと排他する
+        struct lock_guard{
+            explicit lock_guard(int fd_) : fd(fd_){
+                ::flock(fd, LOCK_EX);
+            }
+
+            ~lock_guard(){
+                ::flock(fd, LOCK_UN);
+            }
+
+            int fd;
+        };
+#endif
+    }
+
+    // MurmurHash3 x64 128bit
+    void disk_cache::hash128(const std::string &key, std::uint64_t &lo, std::uint64_t &hi){
+        const std::uint64_t c1 = 0x87c37b91114253d5ULL, c2 = 0x4cf5ad432745937fULL;
+        const unsigned char *p = reinterpret_cast<const unsigned char*>(key.data());
+        std::size_t n = key.size(), blocks = n / 16;
+        std::uint64_t h1 = 0, h2 = 0;
+        for(std::size_t i = 0; i < blocks; ++i){
+            std::uint64_t k1 = load_u64(reinterpret_cast<const char*>(p + i * 16));
+            std::uint64_t k2 = load_u64(reinterpret_cast<const char*>(p + i * 16 + 8));
+            k1 *= c1, k1 = rotl(k1, 31), k1 *= c2, h1 ^= k1;
+            h1 = rotl(h1, 27), h1 += h2, h1 = h1 * 5 + 0x52dce729;
+            k2 *= c2, k2 = rotl(k2, 33), k2 *= c1, h2 ^= k2;
+            h2 = rotl(h2, 31), h2 += h1, h2 = h2 * 5 + 0x38495ab5;
+        }
+        const unsigned char *tail = p + blocks * 16;
+        std::uint64_t k1 = 0, k2 = 0;
+        std::size_t r = n & 15;
+        for(std::size_t i = r; i > 8; --i){ k2 ^= static_cast<std::uint64_t>(tail[i - 1]) << ((i - 9) * 8); }
+        if(r > 8){ k2 *= c2, k2 = rotl(k2, 33), k2 *= c1, h2 ^= k2; }
+        for(std::size_t i = r < 8 ? r : 8; i > 0; --i){ k1 ^= static_cast<std::uint64_t>(tail[i - 1]) << ((i - 1) * 8); }
+        if(r > 0){ k1 *= c1, k1 = rotl(k1, 31), k1 *= c2, h1 ^= k1; }
+        h1 ^= n, h2 ^= n;
+        h1 += h2, h2 += h1;
+        h1 = fmix(h1), h2 = fmix(h2);
+        h1 += h2, h2 += h1;
+        lo = h1, hi = h2;
+    }
+
+    disk_cache::disk_cache(const std::string &path, std::size_t slot_count_, std::size_t data_size_)
+        : map(nullptr), map_size(0), slot_count(0), slots(nullptr), data(nullptr), data_size(0), hits_(0), misses_(0)
+    {
+#if defined(__unix__)
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if(fd < 0){
+            throw(error("cannot open " + path + "."));
+        }
+        std::unique_ptr<int, void(*)(int*)> fd_guard(&fd, [](int *p){ ::close(*p); });
+        {
+            // 作るのは最初に開いたプロセスだけ
+            lock_guard lock(fd);
+            struct stat st;
+            if(::fstat(fd, &st) != 0){
+                throw(error("cannot open " + path + "."));
+            }
+            if(st.st_size == 0){
+                std::uint64_t n = 1;
+                while(n < slot_count_){ n <<= 1; }
+                std::uint64_t data_pos = header_size + n * sizeof(slot);
+                char header[header_size] = {};
+                store_u64(header + slot_count_pos, n);
+                store_u64(header + data_pos_pos, data_pos);
+                store_u64(header + data_size_pos, data_size_);
+                // magicは最後に書き, 途中で失敗したファイルを使わないようにする
+                if(::ftruncate(fd, static_cast<off_t>(data_pos + data_size_)) != 0 || ::pwrite(fd, header + 8, header_size - 8, 8) != static_cast<ssize_t>(header_size - 8)){
+                    throw(error("cannot write " + path + "."));
+                }
+                if(::pwrite(fd, magic, sizeof(magic), 0) != static_cast<ssize_t>(sizeof(magic))){
+                    throw(error("cannot write " + path + "."));
+                }
+                st.st_size = static_cast<off_t>(data_pos + data_size_);
+            }
+            char header[header_size];
+            if(static_cast<std::size_t>(st.st_size) < header_size || ::pread(fd, header, header_size, 0) != static_cast<ssize_t>(header_size) || std::memcmp(header, magic, sizeof(magic)) != 0){
+                throw(error("broken cache file."));
+            }
+            slot_count = load_u64(header + slot_count_pos);
+            std::uint64_t data_pos = load_u64(header + data_pos_pos);
+            data_size = load_u64(header + data_size_pos);
+            if(slot_count == 0 || (slot_count & (slot_count - 1)) != 0 || data_pos != header_size + slot_count * sizeof(slot) || data_pos + data_size != static_cast<std::uint64_t>(st.st_size)){
+                throw(error("broken cache file."));
+            }
+            map_size = static_cast<std::size_t>(st.st_size);
+        }
+        void *p = ::mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(p == MAP_FAILED){
+            throw(error("cannot map " + path + "."));
+        }
+        map = static_cast<char*>(p);
+        slots = reinterpret_cast<slot*>(map + header_size);
+        data = map + header_size + slot_count * sizeof(slot);
+#else
+        throw(error("disk cache is not supported."));
+#endif
+    }
+
+    disk_cache::~disk_cache(){
+#if defined(__unix__)
+        if(map){ ::munmap(map, map_size); }
+#endif
+    }
+
+    std::atomic<std::uint64_t> &disk_cache::data_end() const{
+        return *reinterpret_cast<std::atomic<std::uint64_t>*>(map + data_end_pos);
+    }
+
+    poly::node *disk_cache::find(context &cx, const std::string &key){
+        std::uint64_t lo, hi;
+        hash128(key, lo, hi);
+        std::uint64_t tag = tag_of(lo), mask = slot_count - 1;
+        for(std::uint64_t i = 0; i < slot_count; ++i){
+            slot &s(slots[(lo + i) & mask]);
+            std::uint64_t state = s.state.load(std::memory_order_acquire);
+            if(state == 0){ break; }
+            if(state != tag || s.hash_hi != hi){ continue; }
+            std::uint64_t offset = s.offset, length = s.length;
+            if(offset > data_size || length > data_size - offset || length < 8){ break; }
+            // 同じhashの鍵は1つしか登録しないので, 鍵が違えば外れ
+            const char *first = data + offset, *last = first + length;
+            std::uint64_t key_length = load_u64(first);
+            first += 8;
+            if(key_length != key.size() || key_length > static_cast<std::uint64_t>(last - first) || std::memcmp(first, key.data(), key.size()) != 0){ break; }
+            first += key_length;
+            try{
+                poly::node *q = deserialize_poly(cx, first, last);
+                ++hits_;
+                return q;
+            }catch(error&){
+                break;
+            }
+        }
+        ++misses_;
+        return nullptr;
+    }
+
+    void disk_cache::insert(const std::string &key, const poly::node *p){
+        output_buffer o;
+        char n[8];
+        store_u64(n, key.size());
+        o.write(n, 8);
+        o.write(key);
+        serialize_poly(p, o);
+        std::uint64_t length = o.size();
+
+        // データ領域を予約する. 収まらなければ予約しない
+        std::atomic<std::uint64_t> &end(data_end());
+        std::uint64_t offset = end.load(std::memory_order_relaxed);
+        do{
+            if(offset > data_size || length > data_size - offset){ return; }
+        }while(!end.compare_exchange_weak(offset, offset + length, std::memory_order_relaxed));
+        std::memcpy(data + offset, o.data(), length);
+
+        std::uint64_t lo, hi;
+        hash128(key, lo, hi);
+        std::uint64_t tag = tag_of(lo), mask = slot_count - 1;
+        for(std::uint64_t i = 0; i < slot_count; ++i){
+            slot &s(slots[(lo + i) & mask]);
+            std::uint64_t state = s.state.load(std::memory_order_acquire);
+            if(state == tag && s.hash_hi == hi){ return; }
+            if(state != 0){ continue; }
+            if(!s.state.compare_exchange_strong(state, 1, std::memory_order_acquire)){
+                // 他のプロセスが先に取った
+                if(state == tag && s.hash_hi == hi){ return; }
+                continue;
+            }
+            s.hash_hi = hi, s.offset = offset, s.length = length;
+            s.state.store(tag, std::memory_order_release);
+            return;
+        }
+    }
+}
@@ -0,0 +1,69 @@
+﻿#ifndef SCALC_DISK_CACHE_HPP
+#define SCALC_DISK_CACHE_HPP
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include "context.hpp"
+
+namespace scalc{
+    // 文の結果の多項式をファイルに残すcache
+    // 正規化したtoken列の128bit hashから, serialize_polyで書き出した多項式を引く
+    // ファイルはmmapし, 同じホストの複数のプロセスから同時に読み書きできる
+    //     header : "SCALCDC" 版数(1byte) slotの数(u64) データ領域の位置(u64) 大きさ(u64) 使った大きさ(u64)
+    //     slot   : 状態(u64) hashの上位(u64) データの位置(u64) 長さ(u64)
+    //     データ : 鍵の長さ(u64) 鍵 多項式. 追記するだけで書き換えない
+    // hashが衝突した鍵と, 読めない多項式は外れとする
+    // slotの状態は0が空, 1が書き込み中, それ以外はhashの下位で, 書き終えてから状態を書くことで公開する
+    // 領域が埋まった後は登録せず, 既にある結果だけを返す
+    class disk_cache{
+    public:
+        // ファイルが無ければslot_count(2の冪に切り上げる)とdata_sizeで作る
+        // 既にあればその大きさのまま使う. 開けない, 壊れている場合はerrorを投げる
+        explicit disk_cache(const std::string &path, std::size_t slot_count = 1 << 16, std::size_t data_size = 64 << 20);
+        ~disk_cache();
+
+        // keyの結果があればコンテキストの中に多項式を作って返す. 無ければnullptrを返す
+        // 同じhashの別の鍵の結果と, 壊れた結果は返さない
+        poly::node *find(context &cx, const std::string &key);
+
+        // 結果を登録する. 空きが無ければ何もしない
+        void insert(const std::string &key, const poly::node *p);
+
+        std::size_t hits() const{
+            return hits_;
+        }
+
+        std::size_t misses() const{
+            return misses_;
+        }
+
+    private:
+        disk_cache(const disk_cache&);
+        disk_cache &operator =(const disk_cache&);
+
+        struct slot{
+            std::atomic<std::uint64_t> state;
+            std::uint64_t hash_hi, offset, length;
+        };
+
+        // 状態に使う値を避けたhashの下位
+        static std::uint64_t tag_of(std::uint64_t lo){
+            return lo < 2 ? lo + 2 : lo;
+        }
+
+        static void hash128(const std::string &key, std::uint64_t &lo, std::uint64_t &hi);
+
+        std::atomic<std::uint64_t> &data_end() const;
+
+        char *map;
+        std::size_t map_size;
+        std::uint64_t slot_count;
+        slot *slots;
+        char *data;
+        std::uint64_t data_size;
+        std::atomic<std::size_t> hits_, misses_;
+    };
+}
+
+#endif // SCALC_DISK_CACHE_HPP
@@ -0,0 +1,161 @@
+﻿// ファイルに残すcacheのテスト
+// 当たり, 外れ, 開き直しても結果が残ること, 鍵の違う結果と壊れた結果を外れとすること,
+// letを含む文と束縛された記号を使う文が登録されないことを確かめる
+
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include "scalc.hpp"
+#include "disk_cache.hpp"
+#include "test.hpp"
+
+namespace{
+    std::string eval(scalc::evaluator &ev, scalc::context &cx, const char *statement){
+        try{
+            return ev.eval(cx, statement, statement + std::strlen(statement));
+        }catch(std::exception &e){
+            return e.what();
+        }
+    }
+
+    // 空きのファイル名を得る. cacheが作る
+    std::string temporary_path(){
+        char path[] = "/tmp/scalc_disk_cache_testXXXXXX";
+        int fd = mkstemp(path);
+        if(fd >= 0){
+            close(fd);
+            unlink(path);
+        }
+        return path;
+    }
+
+    std::string text(scalc::context &cx, poly::node *p){
+        if(!p){ return "(none)"; }
+        std::string s = poly::poly_to_string(p);
+        poly::dispose(cx, p);
+        return s;
+    }
+
+    poly::node *poly_of(scalc::context &cx, const char *statement){
+        scalc::evaluator ev;
+        return ev.evaluate(cx, statement, statement + std::strlen(statement));
+    }
+
+    // ファイルの中のsをtoに書き換える
+    bool patch(const std::string &path, const std::string &s, std::size_t offset, char to){
+        std::FILE *fp = std::fopen(path.c_str(), "r+b");
+        if(!fp){ return false; }
+        std::string image;
+        char buf[4096];
+        std::size_t n;
+        while((n = std::fread(buf, 1, sizeof(buf), fp)) > 0){ image.append(buf, n); }
+        std::size_t pos = image.find(s);
+        bool found = pos != std::string::npos;
+        if(found){
+            std::fseek(fp, static_cast<long>(pos + offset), SEEK_SET);
+            std::fputc(to, fp);
+        }
+        std::fclose(fp);
+        return found;
+    }
+
+    void hit_and_miss(){
+        std::string path = temporary_path();
+        scalc::context cx;
+        {
+            scalc::disk_cache cache(path, 16, 1 << 16);
+            CHECK(cache.find(cx, "alpha") == nullptr);
+            poly::node *p = poly_of(cx, "(x + 2*y)^2");
+            cache.insert("alpha", p);
+            poly::dispose(cx, p);
+            CHECK(text(cx, cache.find(cx, "alpha")) == "x^2+4*x*y+4*y^2");
+            CHECK(cache.find(cx, "beta") == nullptr);
+            CHECK(cache.hits() == 1 && cache.misses() == 2);
+        }
+        // 開き直しても残り, 別のコンテキストに作れる
+        {
+            scalc::context cy;
+            scalc::disk_cache cache(path);
+            CHECK(text(cy, cache.find(cy, "alpha")) == "x^2+4*x*y+4*y^2");
+        }
+        unlink(path.c_str());
+    }
+
+    // 領域が埋まれば登録せず, 既にある結果は返す
+    void full(){
+        std::string path = temporary_path();
+        scalc::context cx;
+        scalc::disk_cache cache(path, 16, 256);
+        poly::node *p = poly_of(cx, "x + 1");
+        const char *const keys[] = {"k0", "k1", "k2", "k3", "k4", "k5", "k6", "k7", "k8", "k9"};
+        for(int i = 0; i < 10; ++i){ cache.insert(keys[i], p); }
+        poly::dispose(cx, p);
+        CHECK(text(cx, cache.find(cx, "k0")) == "x+1");
+        CHECK(cache.find(cx, "k9") == nullptr);
+        unlink(path.c_str());
+    }
+
+    void broken_entries(){
+        std::string path = temporary_path();
+        scalc::context cx;
+        {
+            scalc::disk_cache cache(path, 16, 1 << 16);
+            poly::node *p = poly_of(cx, "x^2 + 1");
+            cache.insert("gamma_key", p);
+            cache.insert("delta_key", p);
+            poly::dispose(cx, p);
+        }
+        // 鍵を書き換える. hashは同じslotを指したまま鍵が一致しない
+        CHECK(patch(path, "gamma_key", 0, 'G'));
+        // 鍵に続く記号の数を壊す
+        CHECK(patch(path, "delta_key", 9, '\x7f'));
+        {
+            scalc::disk_cache cache(path);
+            CHECK(cache.find(cx, "gamma_key") == nullptr);
+            CHECK(cache.find(cx, "Gamma_key") == nullptr);
+            CHECK(cache.find(cx, "delta_key") == nullptr);
+            CHECK(cache.misses() == 3 && cache.hits() == 0);
+        }
+        unlink(path.c_str());
+    }
+
+    void statements(){
+        std::string path = temporary_path();
+        {
+            scalc::disk_cache cache(path, 64, 1 << 16);
+            scalc::context cx;
+            cx.set_disk_cache(&cache);
+            scalc::evaluator ev;
+            CHECK(eval(ev, cx, "(x - 1)^3") == "x^3-3*x^2+3*x-1");
+            CHECK(cache.misses() == 1);
+            CHECK(eval(ev, cx, "(x-1.0)^3") == "x^3-3*x^2+3*x-1");
+            CHECK(cache.hits() == 1);
+
+            // letとunlet, 束縛された記号を使う文は引きも登録もしない
+            CHECK(eval(ev, cx, "let y = 4") == "4");
+            CHECK(eval(ev, cx, "(y - 1)^3") == "27");
+            CHECK(eval(ev, cx, "unlet y") == "y");
+            CHECK(cache.hits() == 1 && cache.misses() == 1);
+        }
+        {
+            scalc::disk_cache cache(path);
+            scalc::context cx;
+            cx.set_disk_cache(&cache);
+            scalc::evaluator ev;
+            CHECK(eval(ev, cx, "(x - 1)^3") == "x^3-3*x^2+3*x-1");
+            CHECK(cache.hits() == 1);
+            CHECK(eval(ev, cx, "(y - 1)^3") == "y^3-3*y^2+3*y-1");
+            CHECK(cache.misses() == 1);
+        }
+        unlink(path.c_str());
+    }
+}
+
+int main(){
+    hit_and_miss();
+    full();
+    broken_entries();
+    statements();
+    return test::result("disk_cache_test");
+}
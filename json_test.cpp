@@ -0,0 +1,106 @@
+﻿// JSONの書き出しのテスト
+// 文字列の引用符, 逆斜線, 制御文字の逃がし方, 数値の書き方, 多項式と失敗の形を確かめる
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+#include "scalc.hpp"
+#include "session.hpp"
+#include "test.hpp"
+
+namespace{
+    std::string json(const std::string &s){
+        output_buffer o;
+        poly::string_to_json(s, o);
+        return o.str();
+    }
+
+    std::string eval(scalc::evaluator &ev, scalc::context &cx, const char *statement){
+        output_buffer o;
+        try{
+            ev.eval(cx, statement, statement + std::strlen(statement), o);
+        }catch(std::exception &e){
+            o.clear();
+            scalc::evaluator::write_error(cx, e.what(), o);
+        }
+        return o.str();
+    }
+
+    void put_u32(std::string &s, std::uint32_t n){
+        for(int i = 0; i < 4; ++i){ s += static_cast<char>(n >> (i * 8)); }
+    }
+
+    void put_f64(std::string &s, double d){
+        std::uint64_t n;
+        std::memcpy(&n, &d, 8);
+        for(int i = 0; i < 8; ++i){ s += static_cast<char>(n >> (i * 8)); }
+    }
+
+    // 記号nameの1次の項. 字句解析を通らない名前も作れる
+    poly::node *monomial(scalc::context &cx, const std::string &name, double re){
+        std::string s;
+        put_u32(s, 1);
+        put_u32(s, static_cast<std::uint32_t>(name.size()));
+        s += name;
+        put_u32(s, 1);
+        put_f64(s, re);
+        put_f64(s, 0);
+        put_u32(s, 1);
+        put_u32(s, 0);
+        put_u32(s, 1);
+        put_f64(s, 1);
+        put_f64(s, 0);
+        put_u32(s, 0);
+        return scalc::deserialize_poly(cx, s.data(), s.data() + s.size());
+    }
+
+    void strings(){
+        CHECK(json("") == "\"\"");
+        CHECK(json("plain text.") == "\"plain text.\"");
+        CHECK(json("say \"hi\"") == "\"say \\\"hi\\\"\"");
+        CHECK(json("a\\b") == "\"a\\\\b\"");
+        CHECK(json("tab\there\nnewline") == "\"tab\\u0009here\\u000anewline\"");
+        CHECK(json(std::string("nul\0end", 7)) == "\"nul\\u0000end\"");
+        CHECK(json("\x1f\x20\x7f") == "\"\\u001f \x7f\"");
+        // UTF-8はそのまま書き出す
+        CHECK(json("\xe6\x95\xb0\xe5\xbc\x8f") == "\"\xe6\x95\xb0\xe5\xbc\x8f\"");
+    }
+
+    void polynomials(){
+        scalc::context cx;
+        cx.set_output_format(scalc::output_json);
+        scalc::evaluator ev;
+        CHECK(eval(ev, cx, "x^2*y - 0.5") ==
+            "[{\"re\":1,\"im\":0,\"factors\":[{\"sym\":\"x\",\"exp\":[{\"re\":2,\"im\":0,\"factors\":[]}]},"
+            "{\"sym\":\"y\",\"exp\":[{\"re\":1,\"im\":0,\"factors\":[]}]}]},"
+            "{\"re\":-0.5,\"im\":0,\"factors\":[]}]");
+        CHECK(eval(ev, cx, "x - x") == "[]");
+        CHECK(eval(ev, cx, "-3i") == "[{\"re\":0,\"im\":-3,\"factors\":[]}]");
+        // 整数でない値は読み戻せる桁数で書く
+        CHECK(eval(ev, cx, "0.1") == "[{\"re\":0.10000000000000001,\"im\":0,\"factors\":[]}]");
+        CHECK(eval(ev, cx, "9007199254740993") == "[{\"re\":9007199254740992,\"im\":0,\"factors\":[]}]");
+        CHECK(eval(ev, cx, "x +") == "{\"error\":\"syntax error.\"}");
+
+        // 記号の名前も逃がす
+        poly::node *p = monomial(cx, "a\"b\\c\n", 2);
+        output_buffer o;
+        poly::poly_to_json(p, o);
+        CHECK(o.str() == "[{\"re\":2,\"im\":0,\"factors\":[{\"sym\":\"a\\\"b\\\\c\\u000a\",\"exp\":[{\"re\":1,\"im\":0,\"factors\":[]}]}]}]");
+
+        // 有限でない係数はnull
+        p->next->real = std::numeric_limits<double>::infinity();
+        p->next->imag = std::numeric_limits<double>::quiet_NaN();
+        o.clear();
+        poly::poly_to_json(p, o);
+        std::string head("[{\"re\":null,\"im\":null,");
+        CHECK(o.str().compare(0, head.size(), head) == 0);
+        poly::dispose(cx, p);
+    }
+}
+
+int main(){
+    strings();
+    polynomials();
+    return test::result("json_test");
+}
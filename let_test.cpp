@@ -0,0 +1,104 @@
+﻿// letとunletのテスト
+// 束縛が文を跨いで残ること, 同じ名前のletが前の束縛を隠しunletで戻ること,
+// 束縛の数の上限, unletとcloseで束縛の多項式が解放されることを確かめる
+
+#include <string>
+#include <cstring>
+#include "scalc.hpp"
+#include "test.hpp"
+
+namespace{
+    std::string eval(scalc::evaluator &ev, scalc::context &cx, const char *statement){
+        try{
+            return ev.eval(cx, statement, statement + std::strlen(statement));
+        }catch(std::exception &e){
+            return e.what();
+        }
+    }
+
+    void shadowing(){
+        scalc::context cx;
+        scalc::evaluator ev;
+        CHECK(eval(ev, cx, "let x = 2") == "2");
+        CHECK(eval(ev, cx, "x + 1") == "3");
+        // where部の束縛はletより内側にあり, 文の間だけ隠す
+        CHECK(eval(ev, cx, "x where x = 5") == "5");
+        CHECK(eval(ev, cx, "x") == "2");
+        CHECK(eval(ev, cx, "let x = 3") == "3");
+        CHECK(eval(ev, cx, "x") == "3");
+        CHECK(cx.let_value_count() == 2);
+        CHECK(eval(ev, cx, "unlet x") == "2");
+        CHECK(eval(ev, cx, "x") == "2");
+        CHECK(eval(ev, cx, "unlet x") == "x");
+        CHECK(eval(ev, cx, "x") == "x");
+        CHECK(eval(ev, cx, "unlet x") == "symbol is not defined, x.");
+        CHECK(cx.let_value_count() == 0);
+    }
+
+    // letの右辺は束縛した時の値で, 後から右辺の記号を束縛し直しても変わらない
+    void value_at_binding(){
+        scalc::context cx;
+        scalc::evaluator ev;
+        CHECK(eval(ev, cx, "let x = 2") == "2");
+        CHECK(eval(ev, cx, "let y = x*a") == "2*a");
+        CHECK(eval(ev, cx, "let x = 3") == "3");
+        CHECK(eval(ev, cx, "y") == "2*a");
+        CHECK(eval(ev, cx, "y * x") == "6*a");
+    }
+
+    void limit(){
+        scalc::context cx(2);
+        scalc::evaluator ev;
+        CHECK(eval(ev, cx, "let x = 1") == "1");
+        CHECK(eval(ev, cx, "let y = 2") == "2");
+        // 同じ名前でも新たな束縛として数える
+        CHECK(eval(ev, cx, "let x = 3") == "too many let values.");
+        CHECK(eval(ev, cx, "let z = 3") == "too many let values.");
+        CHECK(cx.let_value_count() == 2);
+        CHECK(eval(ev, cx, "x + y") == "3");
+        // 減らせばまた束縛できる
+        CHECK(eval(ev, cx, "unlet y") == "y");
+        CHECK(eval(ev, cx, "let z = 3") == "3");
+        CHECK(eval(ev, cx, "x + z") == "4");
+        cx.close();
+        CHECK(cx.let_value_count() == 0);
+        CHECK(eval(ev, cx, "let y = 5") == "5");
+        CHECK(eval(ev, cx, "x + y") == "x+5");
+    }
+
+    // 束縛の多項式はmeterに数えられ, unletとcloseで返される
+    void release(){
+        scalc::context cx;
+        scalc::evaluator ev;
+        std::size_t base = cx.meter.used;
+        eval(ev, cx, "let p = (a + b + c)^4");
+        std::size_t one = cx.meter.used;
+        CHECK(one > base);
+        eval(ev, cx, "let p = (a + b)^2");
+        eval(ev, cx, "let q = p * p");
+        CHECK(cx.meter.used > one);
+        eval(ev, cx, "unlet q");
+        eval(ev, cx, "unlet p");
+        CHECK(cx.meter.used == one);
+        eval(ev, cx, "unlet p");
+        CHECK(cx.meter.used == base);
+
+        eval(ev, cx, "let p = (a + b + c)^4");
+        eval(ev, cx, "let q = p - 1");
+        CHECK(cx.meter.used > base);
+        cx.close();
+        CHECK(cx.meter.used == base);
+
+        // 失敗した文の途中の結果も残らない
+        CHECK(eval(ev, cx, "(a + b)^3 * (c + ") == "syntax error.");
+        CHECK(cx.meter.used == base);
+    }
+}
+
+int main(){
+    shadowing();
+    value_at_binding();
+    limit();
+    release();
+    return test::result("let_test");
+}
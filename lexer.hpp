@@ -25,6 +25,7 @@ enum token{
     token_identifier,
     token_keyword_where,
     token_keyword_let,
+    token_keyword_unlet,
     token_symbol
 };
 
@@ -448,6 +449,43 @@ public:
         return std::make_pair(match, iter);
     }
 
+    template<class InputIter>
+    static std::pair<bool, InputIter> reg_keyword_unlet(InputIter first, InputIter last){
+        InputIter iter = first;
+        bool match = true;
+        if(iter == last){ match = false; }else{
+            InputIter iter_prime = iter;
+            do{
+                if(iter != last && *iter == 'u'){
+                    ++iter;
+                    match = true;
+                }else{ match = false; }
+                if(!match){ iter = iter_prime; break; }
+                if(iter != last && *iter == 'n'){
+                    ++iter;
+                    match = true;
+                }else{ match = false; }
+                if(!match){ iter = iter_prime; break; }
+                if(iter != last && *iter == 'l'){
+                    ++iter;
+                    match = true;
+                }else{ match = false; }
+                if(!match){ iter = iter_prime; break; }
+                if(iter != last && *iter == 'e'){
+                    ++iter;
+                    match = true;
+                }else{ match = false; }
+                if(!match){ iter = iter_prime; break; }
+                if(iter != last && *iter == 't'){
+                    ++iter;
+                    match = true;
+                }else{ match = false; }
+                if(!match){ iter = iter_prime; break; }
+            }while(false);
+        }
+        return std::make_pair(match, iter);
+    }
+
     template<class InputIter>
     static std::pair<bool, InputIter> reg_symbol(InputIter first, InputIter last){
         InputIter iter = first;
@@ -589,6 +627,12 @@ public:
                 iter = result.second;
                 continue;
             }
+            result = reg_keyword_unlet(iter, last);
+            if(result.first){
+                *token_inserter = std::make_pair(token_keyword_unlet, std::make_pair(iter, result.second));
+                iter = result.second;
+                continue;
+            }
             result = reg_symbol(iter, last);
             if(result.first){
                 *token_inserter = std::make_pair(token_symbol, std::make_pair(iter, result.second));
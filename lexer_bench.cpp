@@ -0,0 +1,189 @@
+﻿// 字句解析の速さを比べる
+//     lexer_bench [MB]
+// 同じ文を並べた入力, 長さの揃わないtokenを乱数で並べた入力, 長い空白と数字と記号を並べた入力を作り,
+// lexer::tokenizeと, 連なりの読み飛ばしに使う命令ごとのdfa_lexer::tokenize, 64KBずつ読むstream_lexerのbyte/秒を書き出す
+// 全ての結果が一致することも確かめる. stream_lexerは乱数で決めた長さの断片に分けても確かめる
+
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include "lexer.hpp"
+#include "lexer_dfa.hpp"
+#include "lexer_simd.hpp"
+
+namespace{
+    typedef std::pair<const char*, const char*> token_range;
+    typedef std::vector<std::pair<lexer::token, token_range>> token_sequence;
+
+    const char *const statements[] = {
+        "(x + y)^12 - 3*x*y",
+        "a * b / c + d - e where a = 1.5, b = 2, c = 3i, d = x^2",
+        "let velocity = distance / elapsed_time",
+        "unlet velocity",
+        "f x y -> x^2 + y^2",
+        "(((alpha+beta)*(gamma-delta))//epsilon) ^ 0.25",
+        "   sum_of_squares   =   x_1^2 + x_2^2 + x_3^2   ",
+        "letter + lets * wherex - unletx"
+    };
+
+    std::string repeated_input(std::size_t size){
+        std::string input;
+        for(std::size_t i = 0; input.size() < size; ++i){
+            input += statements[i % (sizeof(statements) / sizeof(statements[0]))];
+            input += ' ';
+        }
+        return input;
+    }
+
+    std::string random_input(std::size_t size){
+        const char *const operators[] = { "+", "-", "*", "/", "//", "^", "(", ")", "=", ",", "->" };
+        const char alpha[] = "abcdefghijklmnopqrstuvwxyz_";
+        std::string input;
+        unsigned int x = 12345;
+        auto next = [&x](unsigned int n){ x = x * 1103515245u + 12345u; return (x >> 16) % n; };
+        while(input.size() < size){
+            switch(next(3)){
+            case 0:
+                for(unsigned int n = next(12) + 1; n > 0; --n){
+                    input += alpha[next(sizeof(alpha) - 1)];
+                }
+                break;
+            case 1:
+                for(unsigned int n = next(8) + 1; n > 0; --n){ input += static_cast<char>('0' + next(10)); }
+                if(next(2)){
+                    input += '.';
+                    for(unsigned int n = next(6) + 1; n > 0; --n){ input += static_cast<char>('0' + next(10)); }
+                }
+                break;
+            default:
+                input += operators[next(sizeof(operators) / sizeof(operators[0]))];
+                break;
+            }
+            input.append(next(3) + 1, ' ');
+        }
+        return input;
+    }
+
+    // 機械で作った式のような長い連なり
+    std::string long_run_input(std::size_t size){
+        const char alpha[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_0123456789";
+        std::string input;
+        unsigned int x = 54321;
+        auto next = [&x](unsigned int n){ x = x * 1103515245u + 12345u; return (x >> 16) % n; };
+        while(input.size() < size){
+            input += static_cast<char>('x' + next(3));
+            for(unsigned int n = next(48) + 16; n > 0; --n){ input += alpha[next(sizeof(alpha) - 1)]; }
+            input.append(next(24) + 1, ' ');
+            input += "+ ";
+            input += static_cast<char>('1' + next(9));
+            for(unsigned int n = next(32) + 8; n > 0; --n){ input += static_cast<char>('0' + next(10)); }
+            input.append(next(24) + 1, ' ');
+            input += "* ";
+        }
+        input += "1";
+        return input;
+    }
+
+    typedef std::vector<std::pair<lexer::token, std::string>> text_sequence;
+
+    // stream_lexerのtokenは次の断片までしか有効でないので, 文字列に写して溜める
+    class text_inserter{
+    public:
+        explicit text_inserter(text_sequence &seq_) : seq(&seq_){}
+
+        text_inserter &operator =(const std::pair<lexer::token, token_range> &t){
+            seq->push_back(std::make_pair(t.first, std::string(t.second.first, t.second.second)));
+            return *this;
+        }
+
+        text_inserter &operator *(){ return *this; }
+        text_inserter &operator ++(){ return *this; }
+        text_inserter &operator ++(int){ return *this; }
+
+    private:
+        text_sequence *seq;
+    };
+
+    bool stream_matches(const std::string &input, const token_sequence &expected){
+        text_sequence a, b;
+        for(auto iter = expected.begin(); iter != expected.end(); ++iter){
+            a.push_back(std::make_pair(iter->first, std::string(iter->second.first, iter->second.second)));
+        }
+        lexer::stream_lexer l;
+        unsigned int x = 777;
+        for(std::size_t pos = 0; pos < input.size(); ){
+            x = x * 1103515245u + 12345u;
+            std::size_t n = std::min<std::size_t>((x >> 16) % 97 + 1, input.size() - pos);
+            if(!l.feed(input.data() + pos, n, text_inserter(b))){ return false; }
+            pos += n;
+        }
+        return l.finish(text_inserter(b)) && a == b;
+    }
+
+    template<class F>
+    double measure(const std::string &input, token_sequence &seq, F tokenize){
+        const int repeat = 5;
+        double best = 0;
+        for(int i = 0; i < repeat; ++i){
+            seq.clear();
+            auto t0 = std::chrono::steady_clock::now();
+            bool ok = tokenize(input.data(), input.data() + input.size(), std::back_inserter(seq));
+            auto t1 = std::chrono::steady_clock::now();
+            if(!ok){
+                std::cerr << "lexical error." << std::endl;
+                std::exit(1);
+            }
+            double sec = std::chrono::duration<double>(t1 - t0).count();
+            double rate = input.size() / sec;
+            if(rate > best){ best = rate; }
+        }
+        return best;
+    }
+}
+
+int main(int argc, char *argv[]){
+    std::size_t size = (argc >= 2 ? std::strtoul(argv[1], nullptr, 10) : 16) << 20;
+    const char *const names[] = { "repeated", "random", "long runs" };
+    const char *const levels[] = { "scalar", "sse2", "avx2" };
+    lexer::simd_level detected = lexer::detected_simd_level();
+    for(int k = 0; k < 3; ++k){
+        std::string input = k == 0 ? repeated_input(size) : k == 1 ? random_input(size) : long_run_input(size);
+        token_sequence a, b;
+        double old_rate = measure(input, a, [](const char *first, const char *last, std::back_insert_iterator<token_sequence> o){
+            return lexer::lexer::tokenize(first, last, o).first;
+        });
+        std::printf("%-9s %zu bytes, %zu tokens\n", names[k], input.size(), a.size());
+        std::printf("  tokenize     %.1f MB/s\n", old_rate / (1 << 20));
+        for(int level = lexer::simd_scalar; level <= detected; ++level){
+            lexer::set_simd_level(static_cast<lexer::simd_level>(level));
+            double dfa_rate = measure(input, b, [](const char *first, const char *last, std::back_insert_iterator<token_sequence> o){
+                return lexer::dfa_lexer::tokenize(first, last, o).first;
+            });
+            if(a != b){
+                std::cerr << names[k] << ": token sequences differ." << std::endl;
+                return 1;
+            }
+            std::printf("  dfa %-8s %.1f MB/s\n", levels[level], dfa_rate / (1 << 20));
+        }
+        lexer::set_simd_level(detected);
+        double stream_rate = measure(input, b, [](const char *first, const char *last, std::back_insert_iterator<token_sequence> o){
+            lexer::stream_lexer l;
+            const std::size_t chunk = 1 << 16;
+            for(; static_cast<std::size_t>(last - first) > chunk; first += chunk){
+                if(!l.feed(first, chunk, o)){ return false; }
+            }
+            return l.feed(first, last - first, o) && l.finish(o);
+        });
+        if(!stream_matches(input, a)){
+            std::cerr << names[k] << ": stream_lexer differs." << std::endl;
+            return 1;
+        }
+        std::printf("  stream       %.1f MB/s\n", stream_rate / (1 << 20));
+    }
+    return 0;
+}
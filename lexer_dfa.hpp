@@ -0,0 +1,242 @@
+﻿#ifndef LEXER_DFA_HPP_
+#define LEXER_DFA_HPP_
+
+#include <utility>
+#include <iterator>
+#include <cstddef>
+#include <string>
+#include <deque>
+#include "lexer.hpp"
+#include "lexer_dfa_table.hpp"
+#include "lexer_simd.hpp"
+
+namespace lexer{
+
+// lexer.txtから生成した最小DFAによる字句解析
+// 入力を左から1度だけ走査し, 最長一致でtokenを切り出す. 先に書かれた規則に一致すればそれを採る
+// lexer::tokenizeと同じtoken列を返す. キーワードで始まる記号(letter等)もキーワードと記号に分ける
+// 短いtokenが続く入力ではlexer::tokenizeより遅いので, 評価器はcontext::set_dfa_lexerで選んだ時だけ使う
+// const char*の入力では, 空白, 数字, 記号の連なりをSIMD命令でまとめて読み飛ばす
+class dfa_lexer{
+public:
+    // lexer::tokenizeと同じく, 全て切り出せれば(true, last)を返す
+    // 空の入力と, どのtokenにも一致しない位置がある入力は(false, そのtokenの先頭)を返す
+    template<class InputIter, class InsertIter>
+    static std::pair<bool, InputIter> tokenize(InputIter first, InputIter last, InsertIter token_inserter){
+        using namespace dfa_table;
+        if(first == last){ return std::make_pair(false, first); }
+
+        InputIter iter = first, head = first;
+        // 状態は表の行の先頭の位置で持つ
+        unsigned int row = start_state << class_shift;
+        for(; ; ){
+            scan(row, head, iter, last, token_inserter);
+            if(iter == last){
+                unsigned int state = row >> class_shift;
+                if(accept[state] >= 0){
+                    if(emitted[state] >= 0){
+                        *token_inserter = std::make_pair(static_cast<token>(emitted[state]), std::make_pair(head, last));
+                    }
+                    return std::make_pair(true, last);
+                }
+                if(head == last){ return std::make_pair(true, last); }
+            }
+
+            // 受理していない状態で行き止まりになった. 最後に受理した位置まで戻って切り出し直す
+            std::pair<bool, InputIter> r = longest_match(head, last, token_inserter);
+            if(!r.first){ return std::make_pair(false, head); }
+            iter = head = r.second;
+            row = start_state << class_shift;
+        }
+    }
+
+    // 状態rowで[iter, last)を読み進め, 終わりに着くか受理していない状態で行き止まりになれば戻る
+    // 読み終えたtokenを書き出し, headは読みかけのtokenの先頭を指す
+    template<class InputIter, class InsertIter>
+    static void scan(unsigned int &row_, InputIter &head_, InputIter &iter_, InputIter last, InsertIter &token_inserter){
+        using namespace dfa_table;
+        // 参照のままでは書き出しの度に読み直すことになるので, 手元に写して回す
+        unsigned int row = row_;
+        InputIter head = head_, iter = iter_;
+        while(iter != last){
+            unsigned int next = advance[row + char_class[static_cast<unsigned char>(*iter)]];
+            if(next == 0){ break; }
+            if(next & emit_flag){
+                int t = emitted[row >> class_shift];
+                if(t >= 0){
+                    *token_inserter = std::make_pair(static_cast<token>(t), std::make_pair(head, iter));
+                }
+                head = iter;
+            }
+            row = next & row_mask;
+            ++iter;
+            // 空白, 数字, 記号の連なりに入ったらまとめて読み飛ばす
+            if(next & run_flag){
+                iter = skip_run(run[row >> class_shift], iter, last);
+            }
+        }
+        row_ = row, head_ = head, iter_ = iter;
+    }
+
+    // firstから1つのtokenを最長一致で切り出し, (一致したか, tokenの終わり)を返す
+    template<class InputIter, class InsertIter>
+    static std::pair<bool, InputIter> longest_match(InputIter first, InputIter last, InsertIter &token_inserter){
+        using namespace dfa_table;
+        unsigned int state = start_state;
+        int accepted = -1;
+        InputIter iter = first, end = first;
+        while(iter != last){
+            state = transition[state][char_class[static_cast<unsigned char>(*iter)]];
+            if(state == dead_state){ break; }
+            ++iter;
+            if(accept[state] >= 0){
+                accepted = accept[state];
+                end = iter;
+            }
+        }
+        if(accepted < 0){ return std::make_pair(false, first); }
+        if(!skip[accepted]){
+            *token_inserter = std::make_pair(static_cast<token>(accepted), std::make_pair(first, end));
+        }
+        return std::make_pair(true, end);
+    }
+
+private:
+    // 連続した領域でなければ1byteずつ読む
+    template<class InputIter>
+    static InputIter skip_run(unsigned int, InputIter first, InputIter){
+        return first;
+    }
+
+    static const char *skip_run(unsigned int run, const char *first, const char *last){
+        return ::lexer::skip_run(run, first, last);
+    }
+};
+
+// 断片ごとに届く入力の字句解析
+// DFAの状態と読みかけのtokenを持ち越すので, tokenが断片を跨いでもよい
+// 読み終えたtokenはdfa_lexer::tokenizeと同じ形で書き出す
+// サーバはDFAで字句解析する設定で, 接続ごとに持って文の要求を届いた端から読む
+class stream_lexer{
+public:
+    stream_lexer() : row(dfa_table::start_state << dfa_table::class_shift), carry(), kept(), fed(false), failed(false){}
+
+    // 次の断片を読み, 読み終えたtokenを書き出す. どのtokenにも一致しない入力があればfalseを返す
+    // tokenは断片の中を直接指し, 断片を跨いだtokenだけは内部に写したものを指す. いずれも次にfeedかfinishを呼ぶまで有効
+    template<class InsertIter>
+    bool feed(const char *first, std::size_t size, InsertIter token_inserter){
+        kept.clear();
+        if(failed){ return false; }
+        fed = fed || size > 0;
+        consume(first, first + size, token_inserter);
+        return !failed;
+    }
+
+    // 入力の終わり. 読みかけのtokenを書き出し, 次の入力のために状態を戻す
+    // dfa_lexer::tokenizeと同じく, 空の入力はfalseを返す
+    template<class InsertIter>
+    bool finish(InsertIter token_inserter){
+        using namespace dfa_table;
+        kept.clear();
+        while(!failed && !carry.empty()){
+            kept.push_back(std::string());
+            kept.back().swap(carry);
+            const char *first = kept.back().data(), *last = first + kept.back().size();
+            unsigned int state = row >> class_shift;
+            row = start_state << class_shift;
+            if(accept[state] >= 0){
+                if(emitted[state] >= 0){
+                    *token_inserter = std::make_pair(static_cast<token>(emitted[state]), std::make_pair(first, last));
+                }
+                break;
+            }
+            std::pair<bool, const char*> r = dfa_lexer::longest_match(first, last, token_inserter);
+            if(!r.first){
+                failed = true;
+                break;
+            }
+            consume(r.second, last, token_inserter);
+        }
+        bool result = fed && !failed;
+        reset();
+        return result;
+    }
+
+    // 読みかけのtokenを捨てて始めの状態に戻す
+    void reset(){
+        row = dfa_table::start_state << dfa_table::class_shift;
+        carry.clear();
+        fed = failed = false;
+    }
+
+private:
+    template<class InsertIter>
+    void consume(const char *first, const char *last, InsertIter &token_inserter){
+        using namespace dfa_table;
+        const char *iter = first;
+        if(!carry.empty()){
+            // 持ち越したtokenの続きを, 終わるまで1byteずつ読む
+            unsigned int next = 0;
+            for(; iter != last; ++iter){
+                next = advance[row + char_class[static_cast<unsigned char>(*iter)]];
+                if(next == 0 || (next & emit_flag)){ break; }
+                row = next & row_mask;
+            }
+            if(iter == last){
+                carry.append(first, last);
+                return;
+            }
+            kept.push_back(std::string());
+            kept.back().swap(carry);
+            kept.back().append(first, iter);
+            const char *t_first = kept.back().data(), *t_last = t_first + kept.back().size();
+            unsigned int state = row >> class_shift;
+            row = start_state << class_shift;
+            if(next != 0){
+                if(emitted[state] >= 0){
+                    *token_inserter = std::make_pair(static_cast<token>(emitted[state]), std::make_pair(t_first, t_last));
+                }
+            }else{
+                // 受理していない状態で行き止まりになった. 写したものから切り出し直し, 残りを読んでから断片に戻る
+                std::pair<bool, const char*> r = dfa_lexer::longest_match(t_first, t_last, token_inserter);
+                if(!r.first){
+                    failed = true;
+                    return;
+                }
+                consume(r.second, t_last, token_inserter);
+                if(failed){ return; }
+                consume(iter, last, token_inserter);
+                return;
+            }
+        }
+
+        const char *head = iter;
+        for(; ; ){
+            dfa_lexer::scan(row, head, iter, last, token_inserter);
+            if(iter == last){
+                carry.assign(head, last);
+                return;
+            }
+            std::pair<bool, const char*> r = dfa_lexer::longest_match(head, last, token_inserter);
+            if(!r.first){
+                failed = true;
+                return;
+            }
+            iter = head = r.second;
+            row = start_state << class_shift;
+        }
+    }
+
+    // 状態と, それまでの断片に残した読みかけのtoken
+    unsigned int row;
+    std::string carry;
+
+    // 断片を跨いだtokenを写したもの
+    std::deque<std::string> kept;
+
+    bool fed, failed;
+};
+
+} // namespace lexer
+
+#endif // LEXER_DFA_HPP_
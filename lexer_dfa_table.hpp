@@ -0,0 +1,234 @@
+﻿#ifndef LEXER_DFA_TABLE_HPP_
+#define LEXER_DFA_TABLE_HPP_
+
+// lexer.txtからlexgenで生成した. 直接編集しないこと
+
+#include "lexer.hpp"
+
+namespace lexer{
+namespace dfa_table{
+
+static_assert(token_whitespace == 0, "lexer.txt and lexer.hpp disagree.");
+static_assert(token_right_arrow == 1, "lexer.txt and lexer.hpp disagree.");
+static_assert(token_double_slash == 2, "lexer.txt and lexer.hpp disagree.");
+static_assert(token_hat == 3, "lexer.txt and lexer.hpp disagree.");
+static_assert(token_asterisk == 4, "lexer.txt and lexer.hpp disagree.");
+static_assert(token_slash == 5, "lexer.txt and lexer.hpp disagree.");
+static_assert(token_plus == 6, "lexer.txt and lexer.hpp disagree.");
+static_assert(token_minus == 7, "lexer.txt and lexer.hpp disagree.");
+static_assert(token_left_paren == 8, "lexer.txt and lexer.hpp disagree.");
+static_assert(token_right_paren == 9, "lexer.txt and lexer.hpp disagree.");
+static_assert(token_equal == 10, "lexer.txt and lexer.hpp disagree.");
+static_assert(token_comma == 11, "lexer.txt and lexer.hpp disagree.");
+static_assert(token_identifier == 12, "lexer.txt and lexer.hpp disagree.");
+static_assert(token_keyword_where == 13, "lexer.txt and lexer.hpp disagree.");
+static_assert(token_keyword_let == 14, "lexer.txt and lexer.hpp disagree.");
+static_assert(token_keyword_unlet == 15, "lexer.txt and lexer.hpp disagree.");
+static_assert(token_symbol == 16, "lexer.txt and lexer.hpp disagree.");
+
+const int token_count = 17;
+const int state_count = 61;
+const int class_count = 25;
+
+// 行き止まりの状態と開始状態
+const unsigned char dead_state = 0, start_state = 1;
+
+// byteの文字クラス
+const unsigned char char_class[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    1, 0, 0, 0, 0, 0, 0, 0, 2, 3, 4, 5, 6, 7, 8, 9,
+    10, 11, 11, 11, 11, 11, 11, 11, 11, 11, 0, 0, 0, 12, 13, 0,
+    0, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14,
+    14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 0, 0, 0, 15, 14,
+    0, 14, 14, 14, 14, 16, 14, 14, 17, 18, 14, 14, 19, 14, 20, 14,
+    14, 14, 21, 14, 22, 23, 14, 24, 14, 14, 14, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+// 状態と文字クラスから次の状態
+const unsigned char transition[state_count][class_count] = {
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 2, 3, 4, 5, 6, 7, 8, 0, 9, 10, 11, 12, 0, 13, 14, 13, 13, 13, 15, 13, 13, 13, 16, 17},
+    {0, 33, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 18, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 19, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 20, 0, 0, 0, 0, 0, 0, 0, 0, 0, 21, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 20, 0, 40, 40, 0, 0, 0, 0, 0, 0, 21, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 47, 47, 0, 0, 47, 0, 47, 47, 47, 47, 47, 47, 47, 47, 47},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 13, 13, 0, 0, 13, 0, 22, 13, 13, 13, 13, 13, 13, 13, 13},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 13, 13, 0, 0, 13, 0, 13, 13, 13, 13, 23, 13, 13, 13, 13},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 13, 13, 0, 0, 13, 0, 13, 24, 13, 13, 13, 13, 13, 13, 13},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 25, 25, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 13, 13, 0, 0, 13, 0, 13, 13, 13, 13, 13, 13, 26, 13, 13},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 13, 13, 0, 0, 13, 0, 13, 13, 13, 27, 13, 13, 13, 13, 13},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 13, 13, 0, 0, 13, 0, 28, 13, 13, 13, 13, 13, 13, 13, 13},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 54, 54, 0, 0, 0, 0, 0, 0, 21, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 13, 13, 0, 0, 13, 0, 29, 13, 13, 13, 13, 13, 13, 13, 13},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 13, 13, 0, 0, 13, 0, 13, 13, 13, 13, 13, 30, 13, 13, 13},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 13, 13, 0, 0, 13, 0, 13, 13, 13, 13, 13, 13, 31, 13, 13},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 13, 13, 0, 0, 13, 0, 32, 13, 13, 13, 13, 13, 13, 13, 13},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 34, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 35, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 36, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 37, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 38, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 39, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 39, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 20, 0, 41, 41, 0, 0, 0, 0, 0, 0, 21, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 20, 0, 42, 42, 0, 0, 0, 0, 0, 0, 21, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 20, 0, 43, 43, 0, 0, 0, 0, 0, 0, 21, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 20, 0, 44, 44, 0, 0, 0, 0, 0, 0, 21, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 20, 0, 45, 45, 0, 0, 0, 0, 0, 0, 21, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 20, 0, 46, 46, 0, 0, 0, 0, 0, 0, 21, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 20, 0, 46, 46, 0, 0, 0, 0, 0, 0, 21, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 48, 48, 0, 0, 48, 0, 48, 48, 48, 48, 48, 48, 48, 48, 48},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 49, 49, 0, 0, 49, 0, 49, 49, 49, 49, 49, 49, 49, 49, 49},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 50, 50, 0, 0, 50, 0, 50, 50, 50, 50, 50, 50, 50, 50, 50},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 51, 51, 0, 0, 51, 0, 51, 51, 51, 51, 51, 51, 51, 51, 51},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 52, 52, 0, 0, 52, 0, 52, 52, 52, 52, 52, 52, 52, 52, 52},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 53, 53, 0, 0, 53, 0, 53, 53, 53, 53, 53, 53, 53, 53, 53},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 53, 53, 0, 0, 53, 0, 53, 53, 53, 53, 53, 53, 53, 53, 53},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 55, 55, 0, 0, 0, 0, 0, 0, 21, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 56, 56, 0, 0, 0, 0, 0, 0, 21, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 57, 57, 0, 0, 0, 0, 0, 0, 21, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 58, 58, 0, 0, 0, 0, 0, 0, 21, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 59, 59, 0, 0, 0, 0, 0, 0, 21, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 60, 60, 0, 0, 0, 0, 0, 0, 21, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 60, 60, 0, 0, 0, 0, 0, 0, 21, 0, 0, 0, 0, 0, 0}
+};
+
+// 途切れずに読み進める時の表. 状態sの行はadvance[s << class_shift]から始まり, 次の状態の行の先頭を置く
+// 行き止まりになる文字で, 今の状態が受理していればemit_flagを立て, その文字から次のtokenを始めた状態を置く
+// 連なりを読み飛ばせる状態で自分へ戻る時はrun_flagを立てる. 1byteで終わる連なりでは読み飛ばさない
+// 0は受理していない状態での行き止まりで, 最後に受理した位置まで戻って切り出し直す
+const int class_shift = 5;
+const unsigned short emit_flag = 0x8000, run_flag = 0x4000, row_mask = 0x3fff;
+const unsigned short advance[state_count << class_shift] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 64, 96, 128, 160, 192, 224, 256, 0, 288, 320, 352, 384, 0, 416, 448, 416, 416, 416, 480, 416, 416, 416, 512, 544, 0, 0, 0, 0, 0, 0, 0,
+    0, 1056, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 33088, 33120, 33152, 0, 33184, 33216, 33184, 33184, 33184, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 33088, 33120, 33152, 0, 33184, 33216, 33184, 33184, 33184, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 33088, 33120, 33152, 0, 33184, 33216, 33184, 33184, 33184, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 33088, 33120, 33152, 0, 33184, 33216, 33184, 33184, 33184, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 33088, 33120, 33152, 0, 33184, 33216, 33184, 33184, 33184, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 33088, 33120, 33152, 0, 33184, 33216, 33184, 33184, 33184, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 33088, 33120, 33152, 576, 33184, 33216, 33184, 33184, 33184, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 608, 33088, 33120, 33152, 0, 33184, 33216, 33184, 33184, 33184, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 640, 33056, 33088, 33120, 33152, 0, 33184, 33216, 33184, 33184, 672, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 640, 33056, 1280, 1280, 33152, 0, 33184, 33216, 33184, 33184, 672, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 33088, 33120, 33152, 0, 33184, 33216, 33184, 33184, 33184, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 1504, 1504, 33152, 0, 1504, 33216, 1504, 1504, 1504, 1504, 1504, 1504, 1504, 1504, 1504, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 33088, 33120, 33152, 0, 33184, 33216, 33184, 33184, 33184, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 416, 416, 33152, 0, 416, 33216, 704, 416, 416, 416, 416, 416, 416, 416, 416, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 416, 416, 33152, 0, 416, 33216, 416, 416, 416, 416, 736, 416, 416, 416, 416, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 416, 416, 33152, 0, 416, 33216, 416, 768, 416, 416, 416, 416, 416, 416, 416, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 33088, 33120, 33152, 0, 33184, 33216, 33184, 33184, 33184, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 33088, 33120, 33152, 0, 33184, 33216, 33184, 33184, 33184, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 800, 800, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 33088, 33120, 33152, 0, 33184, 33216, 33184, 33184, 33184, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 416, 416, 33152, 0, 416, 33216, 416, 416, 416, 416, 416, 416, 832, 416, 416, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 416, 416, 33152, 0, 416, 33216, 416, 416, 416, 864, 416, 416, 416, 416, 416, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 416, 416, 33152, 0, 416, 33216, 896, 416, 416, 416, 416, 416, 416, 416, 416, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 1728, 1728, 33152, 0, 33184, 33216, 33184, 33184, 672, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 33088, 33120, 33152, 0, 33184, 33216, 33184, 33184, 33184, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 416, 416, 33152, 0, 416, 33216, 928, 416, 416, 416, 416, 416, 416, 416, 416, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 416, 416, 33152, 0, 416, 33216, 416, 416, 416, 416, 416, 960, 416, 416, 416, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 416, 416, 33152, 0, 416, 33216, 416, 416, 416, 416, 416, 416, 992, 416, 416, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 416, 416, 33152, 0, 416, 33216, 1024, 416, 416, 416, 416, 416, 416, 416, 416, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 33088, 33120, 33152, 0, 33184, 33216, 33184, 33184, 33184, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 33088, 33120, 33152, 0, 33184, 33216, 33184, 33184, 33184, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 1088, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 33088, 33120, 33152, 0, 33184, 33216, 33184, 33184, 33184, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 1120, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 33088, 33120, 33152, 0, 33184, 33216, 33184, 33184, 33184, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 1152, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 33088, 33120, 33152, 0, 33184, 33216, 33184, 33184, 33184, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 1184, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 33088, 33120, 33152, 0, 33184, 33216, 33184, 33184, 33184, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 1216, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 33088, 33120, 33152, 0, 33184, 33216, 33184, 33184, 33184, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 1248, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 33088, 33120, 33152, 0, 33184, 33216, 33184, 33184, 33184, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 17632, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 33088, 33120, 33152, 0, 33184, 33216, 33184, 33184, 33184, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 640, 33056, 1312, 1312, 33152, 0, 33184, 33216, 33184, 33184, 672, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 640, 33056, 1344, 1344, 33152, 0, 33184, 33216, 33184, 33184, 672, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 640, 33056, 1376, 1376, 33152, 0, 33184, 33216, 33184, 33184, 672, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 640, 33056, 1408, 1408, 33152, 0, 33184, 33216, 33184, 33184, 672, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 640, 33056, 1440, 1440, 33152, 0, 33184, 33216, 33184, 33184, 672, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 640, 33056, 1472, 1472, 33152, 0, 33184, 33216, 33184, 33184, 672, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 640, 33056, 17856, 17856, 33152, 0, 33184, 33216, 33184, 33184, 672, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 1536, 1536, 33152, 0, 1536, 33216, 1536, 1536, 1536, 1536, 1536, 1536, 1536, 1536, 1536, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 1568, 1568, 33152, 0, 1568, 33216, 1568, 1568, 1568, 1568, 1568, 1568, 1568, 1568, 1568, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 1600, 1600, 33152, 0, 1600, 33216, 1600, 1600, 1600, 1600, 1600, 1600, 1600, 1600, 1600, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 1632, 1632, 33152, 0, 1632, 33216, 1632, 1632, 1632, 1632, 1632, 1632, 1632, 1632, 1632, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 1664, 1664, 33152, 0, 1664, 33216, 1664, 1664, 1664, 1664, 1664, 1664, 1664, 1664, 1664, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 1696, 1696, 33152, 0, 1696, 33216, 1696, 1696, 1696, 1696, 1696, 1696, 1696, 1696, 1696, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 18080, 18080, 33152, 0, 18080, 33216, 18080, 18080, 18080, 18080, 18080, 18080, 18080, 18080, 18080, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 1760, 1760, 33152, 0, 33184, 33216, 33184, 33184, 672, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 1792, 1792, 33152, 0, 33184, 33216, 33184, 33184, 672, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 1824, 1824, 33152, 0, 33184, 33216, 33184, 33184, 672, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 1856, 1856, 33152, 0, 33184, 33216, 33184, 33184, 672, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 1888, 1888, 33152, 0, 33184, 33216, 33184, 33184, 672, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 1920, 1920, 33152, 0, 33184, 33216, 33184, 33184, 672, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0,
+    0, 32832, 32864, 32896, 32928, 32960, 32992, 33024, 0, 33056, 18304, 18304, 33152, 0, 33184, 33216, 33184, 33184, 672, 33248, 33184, 33184, 33184, 33280, 33312, 0, 0, 0, 0, 0, 0, 0
+};
+
+// 状態が受理するtoken. -1は受理しない
+const signed char accept[state_count] = {
+    -1, -1, 0, 8, 9, 4, 6, 11, 7, 5, 12, 12, 10, 16, 3, 16,
+    16, 16, 1, 2, -1, 12, 16, 16, 16, 12, 14, 16, 16, 16, 16, 15,
+    13, 0, 0, 0, 0, 0, 0, 0, 12, 12, 12, 12, 12, 12, 12, 16,
+    16, 16, 16, 16, 16, 16, 12, 12, 12, 12, 12, 12, 12
+};
+
+// 状態から切り出すtoken. 受理しない状態と読み飛ばす規則は-1
+const signed char emitted[state_count] = {
+    -1, -1, -1, 8, 9, 4, 6, 11, 7, 5, 12, 12, 10, 16, 3, 16,
+    16, 16, 1, 2, -1, 12, 16, 16, 16, 12, 14, 16, 16, 16, 16, 15,
+    13, -1, -1, -1, -1, -1, -1, -1, 12, 12, 12, 12, 12, 12, 12, 16,
+    16, 16, 16, 16, 16, 16, 12, 12, 12, 12, 12, 12, 12
+};
+
+// 状態で読み飛ばせる連なり. 0は読み飛ばさない
+const unsigned char run[state_count] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 2, 0,
+    0, 0, 0, 0, 0, 3, 0, 0, 0, 0, 0, 0, 2
+};
+
+// 連なりを成すbyteの範囲[lo, hi]. 余りは最後の範囲を繰り返して埋める
+const int run_count = 4, run_ranges = 4;
+const unsigned char run_range[run_count][run_ranges][2] = {
+    {{1, 0}, {1, 0}, {1, 0}, {1, 0}},
+    {{32, 32}, {32, 32}, {32, 32}, {32, 32}},
+    {{48, 57}, {48, 57}, {48, 57}, {48, 57}},
+    {{48, 57}, {65, 90}, {95, 95}, {97, 122}}
+};
+
+// tokenにせず読み飛ばす規則
+const bool skip[token_count] = {
+    true, false, false, false, false, false, false, false,
+    false, false, false, false, false, false, false, false,
+    false
+};
+
+} // namespace dfa_table
+} // namespace lexer
+
+#endif // LEXER_DFA_TABLE_HPP_
@@ -0,0 +1,157 @@
+﻿#include "lexer_simd.hpp"
+#include "lexer_dfa_table.hpp"
+#include <atomic>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LEXER_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace lexer{
+    namespace{
+        typedef const char *(*skip_function)(unsigned int, const char*, const char*);
+
+        // run_rangeのloとhi - loを32byteに並べたもの
+        struct range_vector{
+            alignas(32) unsigned char lo[dfa_table::run_ranges][32];
+            alignas(32) unsigned char width[dfa_table::run_ranges][32];
+        };
+
+        struct range_table{
+            range_table(){
+                for(int r = 0; r < dfa_table::run_count; ++r){
+                    for(int i = 0; i < dfa_table::run_ranges; ++i){
+                        for(int k = 0; k < 32; ++k){
+                            v[r].lo[i][k] = dfa_table::run_range[r][i][0];
+                            v[r].width[i][k] = static_cast<unsigned char>(dfa_table::run_range[r][i][1] - dfa_table::run_range[r][i][0]);
+                        }
+                    }
+                }
+            }
+
+            range_vector v[dfa_table::run_count];
+        };
+
+        // 初めて使う時に作る. 他の翻訳単位の静的な初期化から呼ばれても良い
+        const range_table &ranges(){
+            static const range_table table;
+            return table;
+        }
+
+        bool in_run(unsigned int run, unsigned char c){
+            const unsigned char (*range)[2] = dfa_table::run_range[run];
+            for(int i = 0; i < dfa_table::run_ranges; ++i){
+                if(static_cast<unsigned char>(c - range[i][0]) <= static_cast<unsigned char>(range[i][1] - range[i][0])){ return true; }
+            }
+            return false;
+        }
+
+        const char *skip_scalar(unsigned int run, const char *first, const char *last){
+            while(first != last && in_run(run, static_cast<unsigned char>(*first))){ ++first; }
+            return first;
+        }
+
+#if defined(LEXER_SIMD_X86)
+        // 範囲の判定は(c - lo)を符号なしで(hi - lo)と比べる. 16byteずつ調べ, 範囲外の最初のbyteをctzで求める
+        __attribute__((target("sse2")))
+        const char *skip_sse2(unsigned int run, const char *first, const char *last){
+            const range_vector &v = ranges().v[run];
+            __m128i lo[dfa_table::run_ranges], width[dfa_table::run_ranges];
+            for(int i = 0; i < dfa_table::run_ranges; ++i){
+                lo[i] = _mm_load_si128(reinterpret_cast<const __m128i*>(v.lo[i]));
+                width[i] = _mm_load_si128(reinterpret_cast<const __m128i*>(v.width[i]));
+            }
+            while(last - first >= 16){
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first)), hit = _mm_setzero_si128();
+                for(int i = 0; i < dfa_table::run_ranges; ++i){
+                    __m128i d = _mm_sub_epi8(x, lo[i]);
+                    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(_mm_min_epu8(d, width[i]), d));
+                }
+                unsigned int miss = ~static_cast<unsigned int>(_mm_movemask_epi8(hit)) & 0xffff;
+                if(miss){ return first + __builtin_ctz(miss); }
+                first += 16;
+            }
+            return skip_scalar(run, first, last);
+        }
+
+        __attribute__((target("avx2")))
+        const char *skip_avx2(unsigned int run, const char *first, const char *last){
+            const range_vector &v = ranges().v[run];
+            __m256i lo[dfa_table::run_ranges], width[dfa_table::run_ranges];
+            for(int i = 0; i < dfa_table::run_ranges; ++i){
+                lo[i] = _mm256_load_si256(reinterpret_cast<const __m256i*>(v.lo[i]));
+                width[i] = _mm256_load_si256(reinterpret_cast<const __m256i*>(v.width[i]));
+            }
+            while(last - first >= 32){
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first)), hit = _mm256_setzero_si256();
+                for(int i = 0; i < dfa_table::run_ranges; ++i){
+                    __m256i d = _mm256_sub_epi8(x, lo[i]);
+                    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(_mm256_min_epu8(d, width[i]), d));
+                }
+                unsigned int miss = ~static_cast<unsigned int>(_mm256_movemask_epi8(hit));
+                if(miss){ return first + __builtin_ctz(miss); }
+                first += 32;
+            }
+            return skip_sse2(run, first, last);
+        }
+#endif
+
+        simd_level detect(){
+#if defined(LEXER_SIMD_X86)
+            __builtin_cpu_init();
+            if(__builtin_cpu_supports("avx2")){ return simd_avx2; }
+            if(__builtin_cpu_supports("sse2")){ return simd_sse2; }
+#endif
+            return simd_scalar;
+        }
+
+        skip_function select(simd_level level){
+#if defined(LEXER_SIMD_X86)
+            switch(level){
+            case simd_avx2:
+                return skip_avx2;
+            case simd_sse2:
+                return skip_sse2;
+            default:
+                break;
+            }
+#else
+            static_cast<void>(level);
+#endif
+            return skip_scalar;
+        }
+
+        const char *skip_first(unsigned int run, const char *first, const char *last);
+
+        // 静的な初期化の順に依らないよう, 定数で初期化しておき初めて読み飛ばす時にcpuidで選ぶ
+        // levelは選んでいなければ-1
+        std::atomic<skip_function> skip(skip_first);
+        std::atomic<int> level(-1);
+
+        const char *skip_first(unsigned int run, const char *first, const char *last){
+            skip_function expected = skip_first;
+            skip.compare_exchange_strong(expected, select(detected_simd_level()));
+            return skip.load(std::memory_order_relaxed)(run, first, last);
+        }
+    }
+
+    simd_level detected_simd_level(){
+        static const simd_level detected = detect();
+        return detected;
+    }
+
+    void set_simd_level(simd_level l){
+        simd_level detected = detected_simd_level();
+        if(detected < l){ l = detected; }
+        level.store(l);
+        skip.store(select(l));
+    }
+
+    simd_level current_simd_level(){
+        int l = level.load();
+        return l < 0 ? detected_simd_level() : static_cast<simd_level>(l);
+    }
+
+    const char *skip_run(unsigned int run, const char *first, const char *last){
+        return skip.load(std::memory_order_relaxed)(run, first, last);
+    }
+}
@@ -0,0 +1,25 @@
+﻿#ifndef LEXER_SIMD_HPP_
+#define LEXER_SIMD_HPP_
+
+namespace lexer{
+
+// 連なりの読み飛ばしに使う命令
+enum simd_level{
+    simd_scalar,
+    simd_sse2,
+    simd_avx2
+};
+
+// cpuidで選んだ命令
+simd_level detected_simd_level();
+
+// 読み飛ばしに使う命令を変える. CPUが持たない命令は選べない
+void set_simd_level(simd_level level);
+simd_level current_simd_level();
+
+// dfa_table::run_rangeのrun番目の範囲に入るbyteが[first, last)の先頭から続く分を読み飛ばし, その終わりを返す
+const char *skip_run(unsigned int run, const char *first, const char *last);
+
+} // namespace lexer
+
+#endif // LEXER_SIMD_HPP_
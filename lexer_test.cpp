@@ -0,0 +1,126 @@
+﻿// 字句解析器のテスト
+// lexer::tokenizeとdfa_lexer::tokenizeが同じtoken列を返すことを確かめる
+
+#include <string>
+#include <vector>
+#include <iterator>
+#include "lexer.hpp"
+#include "lexer_dfa.hpp"
+#include "lexer_simd.hpp"
+#include "scalc.hpp"
+#include "test.hpp"
+
+namespace{
+    typedef std::vector<std::pair<lexer::token, std::string>> text_sequence;
+
+    // tokenを文字列に写して溜める
+    class text_inserter{
+    public:
+        explicit text_inserter(text_sequence &seq_) : seq(&seq_){}
+
+        text_inserter &operator =(const std::pair<lexer::token, std::pair<const char*, const char*>> &t){
+            seq->push_back(std::make_pair(t.first, std::string(t.second.first, t.second.second)));
+            return *this;
+        }
+
+        text_inserter &operator *(){ return *this; }
+        text_inserter &operator ++(){ return *this; }
+        text_inserter &operator ++(int){ return *this; }
+
+    private:
+        text_sequence *seq;
+    };
+
+    bool tokenize(const std::string &s, text_sequence &seq){
+        seq.clear();
+        return lexer::lexer::tokenize(s.data(), s.data() + s.size(), text_inserter(seq)).first;
+    }
+
+    bool dfa_tokenize(const std::string &s, text_sequence &seq){
+        seq.clear();
+        return lexer::dfa_lexer::tokenize(s.data(), s.data() + s.size(), text_inserter(seq)).first;
+    }
+
+    const char *const statements[] = {
+        "(x + y)^12 - 3*x*y",
+        "a * b / c + d - e where a = 1.5, b = 2, c = 3i, d = x^2",
+        "let velocity = distance / elapsed_time",
+        "unlet velocity",
+        "f x y -> x^2 + y^2",
+        "(((alpha+beta)*(gamma-delta))//epsilon) ^ 0.25",
+        "   sum_of_squares   =   x_1^2 + x_2^2 + x_3^2   ",
+        "1.5e-3 + 2.0i - 0.",
+        "x-->y//z/w",
+        "let x = 1",
+        "where",
+        "letter + lets * wherex - unletx",
+        "whereabouts = let_x where lets = wher",
+        " ",
+        "12345678901234567890 + aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+    };
+
+    // 同じtoken列を返すこと. 連なりの読み飛ばしに使う命令ごとに確かめる
+    void same_tokens(){
+        lexer::simd_level detected = lexer::detected_simd_level();
+        for(int level = lexer::simd_scalar; level <= detected; ++level){
+            lexer::set_simd_level(static_cast<lexer::simd_level>(level));
+            for(std::size_t i = 0; i < sizeof(statements) / sizeof(statements[0]); ++i){
+                text_sequence a, b;
+                CHECK(tokenize(statements[i], a) == dfa_tokenize(statements[i], b));
+                CHECK(a == b);
+            }
+        }
+        lexer::set_simd_level(detected);
+    }
+
+    // どのtokenにも一致しない入力は両者とも失敗する
+    void lexical_error(){
+        text_sequence a, b;
+        CHECK(!tokenize("1 + $", a));
+        CHECK(!dfa_tokenize("1 + $", b));
+        CHECK(!dfa_tokenize("", b));
+    }
+
+    // キーワードで始まる記号は, どちらでもキーワードと記号に分かれる
+    void keyword_prefix(){
+        const char *const symbols[] = { "letter", "lets", "wherex", "unletx" };
+        const lexer::token keywords[] = { lexer::token_keyword_let, lexer::token_keyword_let, lexer::token_keyword_where, lexer::token_keyword_unlet };
+        for(int i = 0; i < 4; ++i){
+            text_sequence a, b;
+            CHECK(tokenize(symbols[i], a));
+            CHECK(a.size() == 2 && a[0].first == keywords[i] && a[1].first == lexer::token_symbol);
+            CHECK(dfa_tokenize(symbols[i], b));
+            CHECK(a == b);
+        }
+    }
+
+    std::string eval(scalc::evaluator &ev, scalc::context &cx, const std::string &s){
+        try{
+            return ev.eval(cx, s.data(), s.data() + s.size());
+        }catch(std::exception &e){
+            return e.what();
+        }
+    }
+
+    // キーワードで始まる記号は, どちらの字句解析でも構文の誤りになる
+    void evaluator_lexer(){
+        scalc::evaluator ev;
+        scalc::context cx;
+        for(int i = 0; i < 2; ++i){
+            cx.set_dfa_lexer(i == 1);
+            CHECK(eval(ev, cx, "letter + 1") == "syntax error.");
+            CHECK(eval(ev, cx, "wherex") == "syntax error.");
+            CHECK(eval(ev, cx, "lets") == "syntax error.");
+            CHECK(eval(ev, cx, "2*x where x = 3") == "6");
+            CHECK(eval(ev, cx, "1 + $") == "lexical error.");
+        }
+    }
+}
+
+int main(){
+    same_tokens();
+    lexical_error();
+    keyword_prefix();
+    evaluator_lexer();
+    return test::result("lexer_test");
+}
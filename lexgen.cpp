@@ -0,0 +1,607 @@
+﻿// lexer.txtから字句解析のDFAの表を生成する
+//     lexgen lexer.txt > lexer_dfa_table.hpp
+// 規則ごとの正規表現からThompson構成でNFAを作り, 部分集合構成でDFAにして最小化する
+// lexer::tokenizeと同じく, 先に書かれた規則に一致すれば後の規則がより長く一致しても先の規則を採る
+// (letterはletと記号terになる). 先の規則が受理した状態から後の規則のNFAの状態を除いて作る
+// 文字は256通りのbyteを, 全ての状態で同じ遷移をするものどうしで文字クラスにまとめる
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <bitset>
+#include <stdexcept>
+#include <algorithm>
+
+namespace{
+    typedef std::bitset<256> char_set;
+
+    struct nfa_state{
+        nfa_state() : edge(), next(-1), epsilon(), accept(-1), rule(-1){}
+
+        // edgeの文字でnextへ遷移する
+        char_set edge;
+        int next;
+
+        std::vector<int> epsilon;
+
+        // 受理する規則の番号. -1は受理しない
+        int accept;
+
+        // 状態を作った規則の番号. 開始状態は-1
+        int rule;
+    };
+
+    struct fragment{
+        int first, last;
+    };
+
+    class nfa{
+    public:
+        nfa() : states(){}
+
+        int new_state(){
+            states.push_back(nfa_state());
+            return static_cast<int>(states.size()) - 1;
+        }
+
+        fragment chars(const char_set &c){
+            fragment f;
+            f.first = new_state(), f.last = new_state();
+            states[f.first].edge = c;
+            states[f.first].next = f.last;
+            return f;
+        }
+
+        fragment empty(){
+            fragment f;
+            f.first = f.last = new_state();
+            return f;
+        }
+
+        fragment concat(fragment a, fragment b){
+            states[a.last].epsilon.push_back(b.first);
+            fragment f;
+            f.first = a.first, f.last = b.last;
+            return f;
+        }
+
+        fragment alternate(fragment a, fragment b){
+            fragment f;
+            f.first = new_state(), f.last = new_state();
+            states[f.first].epsilon.push_back(a.first);
+            states[f.first].epsilon.push_back(b.first);
+            states[a.last].epsilon.push_back(f.last);
+            states[b.last].epsilon.push_back(f.last);
+            return f;
+        }
+
+        // 0回以上(min_one = falseで*, trueで+)
+        fragment repeat(fragment a, bool min_one){
+            fragment f;
+            f.first = new_state(), f.last = new_state();
+            states[f.first].epsilon.push_back(a.first);
+            if(!min_one){ states[f.first].epsilon.push_back(f.last); }
+            states[a.last].epsilon.push_back(a.first);
+            states[a.last].epsilon.push_back(f.last);
+            return f;
+        }
+
+        fragment optional(fragment a){
+            fragment f;
+            f.first = new_state(), f.last = new_state();
+            states[f.first].epsilon.push_back(a.first);
+            states[f.first].epsilon.push_back(f.last);
+            states[a.last].epsilon.push_back(f.last);
+            return f;
+        }
+
+        std::vector<nfa_state> states;
+    };
+
+    // lexer.txtの正規表現
+    //     alt     : concat ('|' concat)*
+    //     concat  : postfix+
+    //     postfix : atom ('*' | '+' | '?')*
+    //     atom    : '"' 文字列 '"' | '[' 文字クラス ']' | '(' alt ')' | 文字
+    class regex_parser{
+    public:
+        regex_parser(nfa &n_, const std::string &str_, const std::string &name_) : n(n_), str(str_), name(name_), pos(0){}
+
+        fragment parse(){
+            fragment f = alt();
+            skip_space();
+            if(pos != str.size()){ fail("unexpected character"); }
+            return f;
+        }
+
+    private:
+        void skip_space(){
+            while(pos < str.size() && (str[pos] == ' ' || str[pos] == '\t')){ ++pos; }
+        }
+
+        bool peek(char c){
+            skip_space();
+            return pos < str.size() && str[pos] == c;
+        }
+
+        void fail(const std::string &message){
+            throw(std::runtime_error(name + ": " + message + " at " + std::to_string(pos) + "."));
+        }
+
+        fragment alt(){
+            fragment f = concat();
+            while(peek('|')){
+                ++pos;
+                f = n.alternate(f, concat());
+            }
+            return f;
+        }
+
+        fragment concat(){
+            fragment f = postfix();
+            for(; ; ){
+                skip_space();
+                if(pos == str.size() || str[pos] == '|' || str[pos] == ')'){ break; }
+                f = n.concat(f, postfix());
+            }
+            return f;
+        }
+
+        fragment postfix(){
+            fragment f = atom();
+            for(; ; ){
+                if(peek('*')){
+                    ++pos;
+                    f = n.repeat(f, false);
+                }else if(peek('+')){
+                    ++pos;
+                    f = n.repeat(f, true);
+                }else if(peek('?')){
+                    ++pos;
+                    f = n.optional(f);
+                }else{
+                    break;
+                }
+            }
+            return f;
+        }
+
+        char escaped(){
+            if(pos == str.size()){ fail("unterminated escape"); }
+            char c = str[pos++];
+            switch(c){
+            case 'n': return '\n';
+            case 't': return '\t';
+            case 'r': return '\r';
+            default: return c;
+            }
+        }
+
+        fragment atom(){
+            skip_space();
+            if(pos == str.size()){ fail("missing expression"); }
+            char c = str[pos++];
+            if(c == '"'){
+                fragment f = n.empty();
+                while(pos < str.size() && str[pos] != '"'){
+                    char d = str[pos++];
+                    if(d == '\\'){ d = escaped(); }
+                    char_set s;
+                    s.set(static_cast<unsigned char>(d));
+                    f = n.concat(f, n.chars(s));
+                }
+                if(pos == str.size()){ fail("unterminated string"); }
+                ++pos;
+                return f;
+            }else if(c == '['){
+                char_set s;
+                bool negate = pos < str.size() && str[pos] == '^';
+                if(negate){ ++pos; }
+                while(pos < str.size() && str[pos] != ']'){
+                    char a = str[pos++];
+                    if(a == '\\'){ a = escaped(); }
+                    char b = a;
+                    if(pos + 1 < str.size() && str[pos] == '-' && str[pos + 1] != ']'){
+                        ++pos;
+                        b = str[pos++];
+                        if(b == '\\'){ b = escaped(); }
+                    }
+                    for(int i = static_cast<unsigned char>(a); i <= static_cast<unsigned char>(b); ++i){ s.set(i); }
+                }
+                if(pos == str.size()){ fail("unterminated class"); }
+                ++pos;
+                if(negate){ s.flip(); }
+                return n.chars(s);
+            }else if(c == '('){
+                fragment f = alt();
+                if(!peek(')')){ fail("missing ')'"); }
+                ++pos;
+                return f;
+            }else if(c == ')' || c == '|' || c == '*' || c == '+' || c == '?' || c == ']'){
+                --pos;
+                fail("unexpected character");
+            }
+            // それ以外の文字はその文字自身に一致する
+            if(c == '\\'){ c = escaped(); }
+            char_set s;
+            s.set(static_cast<unsigned char>(c));
+            return n.chars(s);
+        }
+
+        nfa &n;
+        const std::string &str, &name;
+        std::size_t pos;
+    };
+
+    struct rule{
+        std::string name;
+        std::string regex;
+
+        // != で書かれた規則. 一致した範囲をtokenにしない
+        bool skip;
+    };
+
+    std::vector<rule> read_rules(std::istream &in){
+        std::vector<rule> rules;
+        std::string line;
+        bool header = false;
+        while(std::getline(in, line)){
+            if(line.size() >= 3 && line.compare(0, 3, "\xef\xbb\xbf") == 0){ line.erase(0, 3); }
+            if(!line.empty() && line.back() == '\r'){ line.pop_back(); }
+            std::size_t i = line.find_first_not_of(" \t");
+            if(i == std::string::npos){ continue; }
+            if(!header){
+                if(line.compare(i, std::string::npos, "lexer") != 0){
+                    throw(std::runtime_error("lexer.txt must begin with 'lexer'."));
+                }
+                header = true;
+                continue;
+            }
+            std::size_t j = line.find_first_of(" \t!=", i);
+            std::size_t k = line.find('=', j);
+            if(j == std::string::npos || k == std::string::npos){
+                throw(std::runtime_error("broken rule, " + line + "."));
+            }
+            rule r;
+            r.name = line.substr(i, j - i);
+            r.skip = line.find('!', j) < k;
+            r.regex = line.substr(k + 1);
+            rules.push_back(r);
+        }
+        return rules;
+    }
+
+    struct dfa{
+        // 状態0は行き止まり, 状態1は開始状態
+        std::vector<std::vector<int>> transition;
+        std::vector<int> accept;
+    };
+
+    std::vector<int> closure(const nfa &n, std::vector<int> s){
+        std::vector<bool> seen(n.states.size());
+        std::vector<int> stack(s);
+        for(auto iter = s.begin(); iter != s.end(); ++iter){ seen[*iter] = true; }
+        while(!stack.empty()){
+            int q = stack.back();
+            stack.pop_back();
+            for(auto iter = n.states[q].epsilon.begin(); iter != n.states[q].epsilon.end(); ++iter){
+                if(!seen[*iter]){
+                    seen[*iter] = true;
+                    s.push_back(*iter);
+                    stack.push_back(*iter);
+                }
+            }
+        }
+        std::sort(s.begin(), s.end());
+        return s;
+    }
+
+    // 部分集合構成
+    dfa subset_construction(const nfa &n, int start){
+        dfa d;
+        std::map<std::vector<int>, int> ids;
+        std::vector<std::vector<int>> sets;
+        auto add = [&](std::vector<int> s){
+            int accept = -1;
+            for(auto iter = s.begin(); iter != s.end(); ++iter){
+                int a = n.states[*iter].accept;
+                if(a >= 0 && (accept < 0 || a < accept)){ accept = a; }
+            }
+            // 受理した規則より後の規則は, この先どこまで一致しても採らない
+            if(accept >= 0){
+                s.erase(std::remove_if(s.begin(), s.end(), [&](int q){ return n.states[q].rule > accept; }), s.end());
+            }
+            auto iter = ids.find(s);
+            if(iter != ids.end()){ return iter->second; }
+            int id = static_cast<int>(sets.size());
+            ids.insert(std::make_pair(s, id));
+            sets.push_back(s);
+            d.accept.push_back(accept);
+            d.transition.push_back(std::vector<int>(256, 0));
+            return id;
+        };
+        add(std::vector<int>());
+        add(closure(n, std::vector<int>(1, start)));
+        for(std::size_t i = 1; i < sets.size(); ++i){
+            for(int c = 0; c < 256; ++c){
+                std::vector<int> m;
+                for(auto iter = sets[i].begin(); iter != sets[i].end(); ++iter){
+                    const nfa_state &q(n.states[*iter]);
+                    if(q.next >= 0 && q.edge.test(c)){ m.push_back(q.next); }
+                }
+                int t = m.empty() ? 0 : add(closure(n, m));
+                d.transition[i][c] = t;
+            }
+        }
+        return d;
+    }
+
+    // 受理する規則で分けた分割を, 遷移先の区画が一致するまで細かくする
+    dfa minimize(const dfa &d){
+        std::size_t n = d.transition.size();
+        std::vector<int> block(n);
+        {
+            std::map<int, int> ids;
+            for(std::size_t i = 0; i < n; ++i){
+                // 行き止まりは受理しない状態とも区別する
+                int key = i == 0 ? -2 : d.accept[i];
+                block[i] = ids.insert(std::make_pair(key, static_cast<int>(ids.size()))).first->second;
+            }
+        }
+        for(; ; ){
+            std::map<std::vector<int>, int> ids;
+            std::vector<int> next(n);
+            for(std::size_t i = 0; i < n; ++i){
+                std::vector<int> key(1, block[i]);
+                for(int c = 0; c < 256; ++c){ key.push_back(block[d.transition[i][c]]); }
+                next[i] = ids.insert(std::make_pair(key, static_cast<int>(ids.size()))).first->second;
+            }
+            bool stable = ids.size() == std::set<int>(block.begin(), block.end()).size();
+            block.swap(next);
+            if(stable){ break; }
+        }
+
+        // 行き止まりを0, 開始状態を1とし, 残りは開始状態から辿った順に番号を付ける
+        std::vector<int> number(n, -1), order;
+        std::vector<int> block_number;
+        std::map<int, int> block_ids;
+        auto visit = [&](std::size_t i){
+            if(block_ids.count(block[i])){ return; }
+            block_ids.insert(std::make_pair(block[i], static_cast<int>(order.size())));
+            order.push_back(static_cast<int>(i));
+        };
+        visit(0);
+        visit(1);
+        for(std::size_t k = 1; k < order.size(); ++k){
+            for(int c = 0; c < 256; ++c){ visit(d.transition[order[k]][c]); }
+        }
+        dfa m;
+        for(std::size_t k = 0; k < order.size(); ++k){
+            std::vector<int> t(256);
+            for(int c = 0; c < 256; ++c){ t[c] = block_ids[block[d.transition[order[k]][c]]]; }
+            m.transition.push_back(t);
+            m.accept.push_back(k == 0 ? -1 : d.accept[order[k]]);
+        }
+        return m;
+    }
+
+    // 連なりを1度に読み飛ばすための情報
+    // runは状態ごとの連なりの番号で, 0は読み飛ばさない. rangesは番号ごとのbyteの範囲
+    const std::size_t max_run_ranges = 4;
+    // 読み飛ばしを始める連なりの長さ
+    const int run_threshold = 8;
+    typedef std::vector<std::pair<int, int>> range_list;
+
+    struct run_table{
+        std::vector<int> run;
+        std::vector<range_list> ranges;
+    };
+
+    // 自分へ戻る文字が4つ以下の範囲にまとまる状態は, その範囲の連なりをまとめて読み飛ばせる
+    // 短い連なりで読み飛ばしを呼ぶと遅くなるので, 連なりの状態をthreshold - 1個複製して読んだbyteを数え,
+    // 最後の複製だけが自分へ戻るようにする
+    dfa count_runs(const dfa &d, run_table &r, int threshold){
+        dfa m = d;
+        std::size_t state_count = d.transition.size();
+        std::map<range_list, int> run_ids;
+        r.run.assign(state_count, 0);
+        r.ranges.assign(1, range_list());
+        for(std::size_t i = 1; i < state_count; ++i){
+            range_list ranges;
+            for(int c = 0; c < 256; ++c){
+                if(d.transition[i][c] != static_cast<int>(i)){ continue; }
+                if(!ranges.empty() && ranges.back().second == c - 1){
+                    ranges.back().second = c;
+                }else{
+                    ranges.push_back(std::make_pair(c, c));
+                }
+            }
+            if(ranges.empty() || ranges.size() > max_run_ranges){ continue; }
+            std::map<range_list, int>::iterator iter = run_ids.find(ranges);
+            if(iter == run_ids.end()){
+                iter = run_ids.insert(std::make_pair(ranges, static_cast<int>(r.ranges.size()))).first;
+                r.ranges.push_back(ranges);
+            }
+
+            int prev = static_cast<int>(i);
+            for(int k = 1; k < threshold; ++k){
+                int copy = static_cast<int>(m.transition.size());
+                m.transition.push_back(d.transition[i]);
+                m.accept.push_back(d.accept[i]);
+                r.run.push_back(0);
+                for(int c = 0; c < 256; ++c){
+                    if(d.transition[i][c] == static_cast<int>(i)){
+                        m.transition[prev][c] = copy;
+                        m.transition[copy][c] = copy;
+                    }
+                }
+                prev = copy;
+            }
+            r.run[prev] = iter->second;
+        }
+        return m;
+    }
+
+    void write_table(std::ostream &o, const std::vector<rule> &rules, const dfa &d, const run_table &runs){
+        std::size_t state_count = d.transition.size();
+
+        // 全ての状態で同じ遷移をする文字を1つの文字クラスにまとめる
+        std::vector<int> char_class(256);
+        std::map<std::vector<int>, int> ids;
+        for(int c = 0; c < 256; ++c){
+            std::vector<int> column;
+            for(std::size_t i = 0; i < state_count; ++i){ column.push_back(d.transition[i][c]); }
+            char_class[c] = ids.insert(std::make_pair(column, static_cast<int>(ids.size()))).first->second;
+        }
+        std::vector<int> representative(ids.size());
+        for(int c = 255; c >= 0; --c){ representative[char_class[c]] = c; }
+        // advanceは状態を行の先頭の位置で持ち, 上位2bitを印に使う
+        int class_shift = 0;
+        while((std::size_t(1) << class_shift) < ids.size()){ ++class_shift; }
+        if(state_count > 256 || ids.size() > 256 || (state_count << class_shift) > 0x4000){
+            throw(std::runtime_error("too many states."));
+        }
+
+
+        o << "\xef\xbb\xbf#ifndef LEXER_DFA_TABLE_HPP_\n";
+        o << "#define LEXER_DFA_TABLE_HPP_\n\n";
+        o << "// lexer.txtからlexgenで生成した. 直接編集しないこと\n\n";
+        o << "#include \"lexer.hpp\"\n\n";
+        o << "namespace lexer{\n";
+        o << "namespace dfa_table{\n\n";
+        for(std::size_t i = 0; i < rules.size(); ++i){
+            o << "static_assert(token_" << rules[i].name << " == " << i << ", \"lexer.txt and lexer.hpp disagree.\");\n";
+        }
+        o << "\n";
+        o << "const int token_count = " << rules.size() << ";\n";
+        o << "const int state_count = " << state_count << ";\n";
+        o << "const int class_count = " << ids.size() << ";\n\n";
+        o << "// 行き止まりの状態と開始状態\n";
+        o << "const unsigned char dead_state = 0, start_state = 1;\n\n";
+
+        o << "// byteの文字クラス\n";
+        o << "const unsigned char char_class[256] = {";
+        for(int c = 0; c < 256; ++c){
+            o << (c % 16 == 0 ? "\n    " : " ") << char_class[c] << (c < 255 ? "," : "");
+        }
+        o << "\n};\n\n";
+
+        o << "// 状態と文字クラスから次の状態\n";
+        o << "const unsigned char transition[state_count][class_count] = {\n";
+        for(std::size_t i = 0; i < state_count; ++i){
+            o << "    {";
+            for(std::size_t k = 0; k < ids.size(); ++k){
+                o << (k ? ", " : "") << d.transition[i][representative[k]];
+            }
+            o << "}" << (i + 1 < state_count ? "," : "") << "\n";
+        }
+        o << "};\n\n";
+
+        o << "// 途切れずに読み進める時の表. 状態sの行はadvance[s << class_shift]から始まり, 次の状態の行の先頭を置く\n";
+        o << "// 行き止まりになる文字で, 今の状態が受理していればemit_flagを立て, その文字から次のtokenを始めた状態を置く\n";
+        o << "// 連なりを読み飛ばせる状態で自分へ戻る時はrun_flagを立てる. 1byteで終わる連なりでは読み飛ばさない\n";
+        o << "// 0は受理していない状態での行き止まりで, 最後に受理した位置まで戻って切り出し直す\n";
+        o << "const int class_shift = " << class_shift << ";\n";
+        o << "const unsigned short emit_flag = 0x8000, run_flag = 0x4000, row_mask = 0x3fff;\n";
+        o << "const unsigned short advance[state_count << class_shift] = {\n";
+        for(std::size_t i = 0; i < state_count; ++i){
+            o << "    ";
+            for(std::size_t k = 0; k < (std::size_t(1) << class_shift); ++k){
+                int a = 0;
+                if(k < ids.size()){
+                    int c = representative[k], t = d.transition[i][c], restart = d.transition[1][c];
+                    if(t != 0){
+                        a = (t << class_shift) | (runs.run[t] && t == static_cast<int>(i) ? 0x4000 : 0);
+                    }else if(i != 0 && d.accept[i] >= 0 && restart != 0){
+                        a = 0x8000 | (restart << class_shift);
+                    }
+                }
+                o << (k ? ", " : "") << a;
+            }
+            o << (i + 1 < state_count ? "," : "") << "\n";
+        }
+        o << "};\n\n";
+
+        o << "// 状態が受理するtoken. -1は受理しない\n";
+        o << "const signed char accept[state_count] = {";
+        for(std::size_t i = 0; i < state_count; ++i){
+            o << (i % 16 == 0 ? "\n    " : " ") << d.accept[i] << (i + 1 < state_count ? "," : "");
+        }
+        o << "\n};\n\n";
+
+        o << "// 状態から切り出すtoken. 受理しない状態と読み飛ばす規則は-1\n";
+        o << "const signed char emitted[state_count] = {";
+        for(std::size_t i = 0; i < state_count; ++i){
+            int a = d.accept[i];
+            o << (i % 16 == 0 ? "\n    " : " ") << (a >= 0 && !rules[a].skip ? a : -1) << (i + 1 < state_count ? "," : "");
+        }
+        o << "\n};\n\n";
+
+        o << "// 状態で読み飛ばせる連なり. 0は読み飛ばさない\n";
+        o << "const unsigned char run[state_count] = {";
+        for(std::size_t i = 0; i < state_count; ++i){
+            o << (i % 16 == 0 ? "\n    " : " ") << runs.run[i] << (i + 1 < state_count ? "," : "");
+        }
+        o << "\n};\n\n";
+
+        o << "// 連なりを成すbyteの範囲[lo, hi]. 余りは最後の範囲を繰り返して埋める\n";
+        o << "const int run_count = " << runs.ranges.size() << ", run_ranges = " << max_run_ranges << ";\n";
+        o << "const unsigned char run_range[run_count][run_ranges][2] = {\n";
+        for(std::size_t i = 0; i < runs.ranges.size(); ++i){
+            o << "    {";
+            for(std::size_t k = 0; k < max_run_ranges; ++k){
+                std::pair<int, int> r = runs.ranges[i].empty() ? std::make_pair(1, 0) : runs.ranges[i][k < runs.ranges[i].size() ? k : runs.ranges[i].size() - 1];
+                o << (k ? ", " : "") << "{" << r.first << ", " << r.second << "}";
+            }
+            o << "}" << (i + 1 < runs.ranges.size() ? "," : "") << "\n";
+        }
+        o << "};\n\n";
+
+        o << "// tokenにせず読み飛ばす規則\n";
+        o << "const bool skip[token_count] = {";
+        for(std::size_t i = 0; i < rules.size(); ++i){
+            o << (i % 8 == 0 ? "\n    " : " ") << (rules[i].skip ? "true" : "false") << (i + 1 < rules.size() ? "," : "");
+        }
+        o << "\n};\n\n";
+
+        o << "} // namespace dfa_table\n";
+        o << "} // namespace lexer\n\n";
+        o << "#endif // LEXER_DFA_TABLE_HPP_\n";
+    }
+}
+
+int main(int argc, char *argv[]){
+    if(argc != 2){
+        std::cerr << "usage: lexgen lexer.txt" << std::endl;
+        return 1;
+    }
+    try{
+        std::ifstream in(argv[1]);
+        if(!in){
+            throw(std::runtime_error(std::string("cannot open ") + argv[1] + "."));
+        }
+        std::vector<rule> rules = read_rules(in);
+        nfa n;
+        int start = n.new_state();
+        for(std::size_t i = 0; i < rules.size(); ++i){
+            std::size_t first_state = n.states.size();
+            fragment f = regex_parser(n, rules[i].regex, rules[i].name).parse();
+            for(std::size_t q = first_state; q < n.states.size(); ++q){ n.states[q].rule = static_cast<int>(i); }
+            n.states[start].epsilon.push_back(f.first);
+            n.states[f.last].accept = static_cast<int>(i);
+        }
+        run_table runs;
+        dfa d = count_runs(minimize(subset_construction(n, start)), runs, run_threshold);
+        std::ostringstream o;
+        write_table(o, rules, d, runs);
+        std::cout << o.str();
+    }catch(std::runtime_error &e){
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,71 @@
+﻿#include <string>
+#include <limits>
+#include <cstdlib>
+#include <cstring>
+#include "literal.hpp"
+
+namespace scalc{
+    namespace{
+        // 正確に表せる10の冪
+        const fpoint exact_power10[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+            1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+        bool is_digit(char c){
+            return c >= '0' && c <= '9';
+        }
+
+        // mantissaに1桁を足す. 収まらなければ足さずにfalseを返す
+        bool push_digit(std::uint64_t &mantissa, unsigned int d){
+            if(mantissa > (std::numeric_limits<std::uint64_t>::max() - d) / 10){ return false; }
+            mantissa = mantissa * 10 + d;
+            return true;
+        }
+    }
+
+    const char *parse_literal(const char *first, const char *last, numeric_literal &l){
+        const char *p = first;
+        if(p == last || !is_digit(*p)){ return first; }
+        l.mantissa = 0;
+        l.scale = 0;
+        l.exact = true;
+        for(; p != last && is_digit(*p); ++p){
+            unsigned int d = static_cast<unsigned int>(*p - '0');
+            if(!push_digit(l.mantissa, d)){
+                --l.scale;
+                l.exact = l.exact && d == 0;
+            }
+        }
+        if(p != last && *p == '.' && p + 1 != last && is_digit(*(p + 1))){
+            for(++p; p != last && is_digit(*p); ++p){
+                unsigned int d = static_cast<unsigned int>(*p - '0');
+                if(push_digit(l.mantissa, d)){
+                    ++l.scale;
+                }else{
+                    l.exact = l.exact && d == 0;
+                }
+            }
+        }
+        const char *end = p;
+        l.imaginary = p != last && *p == 'i';
+        if(l.imaginary){ ++p; }
+
+        // 仮数と10の冪がどちらも正確なfpointであれば, 1回の除算で正しく丸まる
+        if(l.exact && l.mantissa <= (std::uint64_t(1) << 53) && l.scale >= 0 && l.scale <= 22){
+            l.v = static_cast<fpoint>(l.mantissa) / exact_power10[l.scale];
+        }else{
+            // strtodは0終端を要るので写す
+            std::size_t n = static_cast<std::size_t>(end - first);
+            char buf[64];
+            if(n < sizeof(buf)){
+                std::memcpy(buf, first, n);
+                buf[n] = '\0';
+                l.v = std::strtod(buf, nullptr);
+            }else{
+                l.v = std::strtod(std::string(first, end).c_str(), nullptr);
+            }
+        }
+        return p;
+    }
+}
@@ -0,0 +1,24 @@
+﻿#ifndef SCALC_LITERAL_HPP
+#define SCALC_LITERAL_HPP
+
+#include <cstdint>
+#include "common.hpp"
+
+namespace scalc{
+    // 数値のtokenを読んだもの
+    // 書かれた10進の値をmantissa * 10^-scaleで持つ
+    // mantissaに収まらない0でない桁があればexactはfalseで, mantissaは収まる上位の桁だけを持つ
+    struct numeric_literal{
+        fpoint v;
+        std::uint64_t mantissa;
+        int scale;
+        bool exact, imaginary;
+    };
+
+    // [first, last)の先頭の数値を読み, 読み終えた位置を返す. 数字で始まらなければfirstを返す
+    // 書式は字句解析のidentifierと同じで, 数字の後に'.'と数字, 'i'が続いてよい
+    // vはstrtodと同じく最も近いfpointに丸める. 入力を複写せず, 長い数値の他はメモリを割り当てない
+    const char *parse_literal(const char *first, const char *last, numeric_literal &l);
+}
+
+#endif // SCALC_LITERAL_HPP
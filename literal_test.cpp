@@ -0,0 +1,114 @@
+﻿// 数値のtokenの読み込みのテスト
+// parse_literalの値がstrtodと1bitも違わないこと, 書かれた10進の値と正確さ, 読み終えた位置を確かめる
+
+#include <string>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include "literal.hpp"
+#include "test.hpp"
+
+namespace{
+    bool same_as_strtod(const std::string &s){
+        scalc::numeric_literal l;
+        const char *first = s.data(), *last = first + s.size();
+        if(scalc::parse_literal(first, last, l) != last){ return false; }
+        double d = std::strtod(s.c_str(), nullptr);
+        if(std::memcmp(&d, &l.v, sizeof(double)) != 0){
+            std::fprintf(stderr, "%s: %.17g %.17g\n", s.c_str(), l.v, d);
+            return false;
+        }
+        return true;
+    }
+
+    void rounding(){
+        const char *const cases[] = {
+            "0", "1", "0.1", "0.3", "123.456", "00012.5000",
+            // 2^53の前後. 中間は偶数に丸める
+            "9007199254740992", "9007199254740993", "9007199254740994", "9007199254740995",
+            "9007199254740993.0000000000000000001",
+            // 10^22を超える10の冪と, 2^64を超える仮数
+            "10000000000000000000000", "100000000000000000000000", "18446744073709551615", "18446744073709551616",
+            "123456789012345678901234567890", "0.12345678901234567890123456789",
+            "0.000000000000000000000000000001",
+            "1.7976931348623157", "179769313486231570000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000.5"
+        };
+        bool all = true;
+        for(std::size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i){
+            if(!same_as_strtod(cases[i])){ all = false; }
+        }
+        CHECK(all);
+
+        // DBL_MAXを超える値と, 64byteを超える長さ
+        CHECK(same_as_strtod("1" + std::string(400, '0')));
+        CHECK(same_as_strtod("0." + std::string(340, '0') + "1"));
+        CHECK(same_as_strtod("3." + std::string(100, '3')));
+    }
+
+    // 桁の数を変えて乱数で作る
+    void random_literals(){
+        std::mt19937 gen(12345);
+        std::uniform_int_distribution<int> digit(0, 9), int_len(1, 25), frac_len(0, 30);
+        bool all = true;
+        for(int n = 0; n < 200000 && all; ++n){
+            std::string s;
+            int k = int_len(gen);
+            for(int i = 0; i < k; ++i){ s += static_cast<char>('0' + digit(gen)); }
+            k = frac_len(gen);
+            if(k > 0){
+                s += '.';
+                for(int i = 0; i < k; ++i){ s += static_cast<char>('0' + digit(gen)); }
+            }
+            if(!same_as_strtod(s)){ all = false; }
+        }
+        CHECK(all);
+    }
+
+    void decimal(){
+        scalc::numeric_literal l;
+        const char *s = "12.50";
+        CHECK(scalc::parse_literal(s, s + 5, l) == s + 5);
+        CHECK(l.mantissa == 1250 && l.scale == 2 && l.exact && !l.imaginary && l.v == 12.5);
+
+        // 収まらない桁が0だけであれば正確
+        s = "100000000000000000000000";
+        CHECK(scalc::parse_literal(s, s + std::strlen(s), l) == s + std::strlen(s));
+        CHECK(l.exact && l.mantissa * std::pow(10.0, -l.scale) == 1e23);
+        s = "0.1000000000000000000000000000";
+        scalc::parse_literal(s, s + std::strlen(s), l);
+        CHECK(l.exact);
+        s = "0.1000000000000000000000000001";
+        scalc::parse_literal(s, s + std::strlen(s), l);
+        CHECK(!l.exact);
+        s = "123456789012345678901";
+        scalc::parse_literal(s, s + std::strlen(s), l);
+        CHECK(!l.exact && l.mantissa == 12345678901234567890ULL && l.scale == -1);
+    }
+
+    void extent(){
+        scalc::numeric_literal l;
+        const char *s = "2.5i+x";
+        CHECK(scalc::parse_literal(s, s + 6, l) == s + 4);
+        CHECK(l.imaginary && l.v == 2.5);
+        // '.'の後に数字が無ければ'.'の前で終わる
+        s = "3.x";
+        CHECK(scalc::parse_literal(s, s + 3, l) == s + 1);
+        CHECK(!l.imaginary && l.v == 3);
+        // 範囲の外は読まない
+        s = "1234";
+        CHECK(scalc::parse_literal(s, s + 2, l) == s + 2 && l.v == 12);
+        s = "x1";
+        CHECK(scalc::parse_literal(s, s + 2, l) == s);
+        CHECK(scalc::parse_literal(s, s, l) == s);
+    }
+}
+
+int main(){
+    rounding();
+    random_literals();
+    decimal();
+    extent();
+    return test::result("literal_test");
+}
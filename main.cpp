@@ -8,627 +8,1106 @@
 #include <string>
 #include <exception>
 #include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <deque>
+#include <atomic>
+#include <cctype>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#if defined(__unix__)
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#if defined(__linux__)
+#include <signal.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#endif
 #include "common.hpp"
+#include "scalc.hpp"
+#include "session.hpp"
+#include "wire.hpp"
+#include "table.hpp"
+#include "lexer_dfa.hpp"
+#include "spsc_queue.hpp"
+#include "algebraic.hpp"
 
-namespace analyzer{
-    struct eval_target;
-    struct symbol;
-
-    struct stack_element{
-        stack_element() : node(nullptr), v(nullptr){}
-        poly::node *node;
-        const eval_target *v;
-    };
-
-    class semantic_data{
+namespace scalc{
+    // 改行区切りの入力から1行ずつrangeを得る
+    // 通常のファイルはmmapし, 行はmapされた領域を直接指す
+    // pipe等mmapできないものは再利用するbufferに読み込む
+    class line_source{
     public:
-        semantic_data() : stack(), local_args(), global_variable_map(){}
-
-        ~semantic_data();
-
-        // スタックに計算結果を積む
-        void push_stack(poly::node *ptr);
-
-        // スタックに評価前の値を積む
-        void push_stack(const eval_target *ptr);
-
-        // スタックから計算結果を取り出す
-        stack_element pop_stack();
-
-        // スタックの中身を逆順に得る
-        stack_element r_access(std::size_t i) const;
-
-        bool empty() const{
-            return stack.empty();
+        explicit line_source(std::FILE *fp_)
+            : fp(fp_), map_first(nullptr), map_last(nullptr), pos(nullptr), released(nullptr), buffer(), buffer_pos(0), buffer_end(0), eof(false)
+        {
+#if defined(__unix__)
+            struct stat st;
+            int fd = ::fileno(fp);
+            if(::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0){
+                void *p = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if(p != MAP_FAILED){
+                    ::madvise(p, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+                    map_first = released = pos = static_cast<const char*>(p);
+                    map_last = map_first + st.st_size;
+                }
+            }
+#endif
         }
 
-        // 記号が変数かどうかを問い合わせる
-        // 変数であれば値を返し, そうでなければ入力記号を返す
-        const stack_element inquiry_symbol(const symbol *s);
-
-        // ローカル引数の領域を新たに生成する
-        std::map<str_wrapper, const stack_element> &push_local_args(){
-            local_args.push_back(std::map<str_wrapper, const stack_element>());
-            return local_args.back();
+        ~line_source(){
+#if defined(__unix__)
+            if(map_first){
+                ::munmap(const_cast<char*>(map_first), map_last - map_first);
+            }
+#endif
         }
 
-        // ローカル引数の最も新しい領域を破棄する
-        void pop_local_args(){
-            local_args.pop_back();
+        // mapされていれば, 得た行はこのオブジェクトが生きている間有効
+        // そうでなければ次にnextを呼ぶまで有効
+        bool mapped() const{
+            return map_first != nullptr;
         }
 
-        // ローカル引数に仮引数を登録する
-        void register_local_arg(const symbol *ptr, const stack_element target);
+        // 次の行を得る. 改行文字は含まない
+        bool next(const char *&first, const char *&last){
+            if(mapped()){
+                if(pos == map_last){ return false; }
+                first = pos;
+                const char *nl = static_cast<const char*>(std::memchr(pos, '\n', map_last - pos));
+                last = nl ? nl : map_last;
+                pos = nl ? nl + 1 : map_last;
+                return true;
+            }
+            for(; ; ){
+                // 初めはbufferが空で, data()はnullptrであり得る. memchrには渡さない
+                const char *p = buffer.data() + buffer_pos, *q = buffer.data() + buffer_end;
+                const char *nl = p != q ? static_cast<const char*>(std::memchr(p, '\n', q - p)) : nullptr;
+                if(nl){
+                    first = p, last = nl;
+                    buffer_pos = nl + 1 - buffer.data();
+                    return true;
+                }
+                if(eof){
+                    if(p == q){ return false; }
+                    first = p, last = q;
+                    buffer_pos = buffer_end;
+                    return true;
+                }
+                fill();
+            }
+        }
 
-        // 定数を登録する
-        void register_let_value(const symbol *ptr, const stack_element target);
+        // 既に読み終えた領域をこれ以上参照しないことを通知する
+        // mapされた領域のうちlastより前のページを手放し, RSSを行の作業領域程度に保つ
+        void release(const char *last){
+#if defined(__unix__)
+            if(!mapped()){ return; }
+            static const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+            std::size_t n = static_cast<std::size_t>(last - map_first) / page * page;
+            const char *p = map_first + n;
+            if(p - released >= static_cast<std::ptrdiff_t>(release_unit)){
+                ::madvise(const_cast<char*>(released), p - released, MADV_DONTNEED);
+                released = p;
+            }
+#else
+            (void)last;
+#endif
+        }
 
     private:
-        // 計算の中途結果が入るstack
-        std::vector<stack_element> stack;
+        line_source(const line_source&);
+        line_source &operator =(const line_source&);
+
+        // 読み終えた部分を詰め, 続きを読み込む
+        void fill(){
+            std::size_t rest = buffer_end - buffer_pos;
+            if(rest > 0 && buffer_pos > 0){
+                std::memmove(&buffer[0], &buffer[buffer_pos], rest);
+            }
+            buffer_pos = 0, buffer_end = rest;
+            if(buffer.size() - buffer_end < read_unit){
+                buffer.resize(buffer_end + read_unit);
+            }
+            std::size_t r = std::fread(&buffer[buffer_end], 1, buffer.size() - buffer_end, fp);
+            if(r == 0){ eof = true; }
+            buffer_end += r;
+        }
 
-        // local args
-        std::vector<std::map<str_wrapper, const stack_element>> local_args;
+        static const std::size_t read_unit = 1 << 16;
+        static const std::size_t release_unit = 1 << 24;
 
-        // global variable
-        std::map<str_wrapper, stack_element> global_variable_map;
+        std::FILE *fp;
+        const char *map_first, *map_last, *pos, *released;
+        std::vector<char> buffer;
+        std::size_t buffer_pos, buffer_end;
+        bool eof;
     };
 
-    void semantic_data::push_stack(poly::node *ptr){
-        stack_element a;
-        a.node = ptr;
-        stack.push_back(a);
+    // 結果の行の末尾にtabで区切って評価のメモリの最大値を書き出す
+    inline void write_peak(output_buffer &o, std::size_t peak){
+        char buf[32];
+        int n = std::snprintf(buf, sizeof(buf), "\t%lu", static_cast<unsigned long>(peak));
+        o.write(buf, static_cast<std::size_t>(n));
     }
 
-    void semantic_data::push_stack(const eval_target *ptr){
-        stack_element a;
-        a.v = ptr;
-        stack.push_back(a);
+    // cacheの当たり外れの数を標準エラー出力に書き出す
+    inline void write_cache_stats(const result_cache &cache){
+        std::fprintf(
+            stderr, "cache: hits=%lu misses=%lu size=%lu\n",
+            static_cast<unsigned long>(cache.hits()), static_cast<unsigned long>(cache.misses()), static_cast<unsigned long>(cache.size())
+        );
     }
 
-    struct eval_target{
-        virtual ~eval_target(){}
-        virtual std::string ast_str() const = 0;
-        virtual void eval(semantic_data&) const{ throw(error("missing eval function.")); }
-    };
+    inline void write_cache_stats(const disk_cache &cache){
+        std::fprintf(
+            stderr, "disk cache: hits=%lu misses=%lu\n",
+            static_cast<unsigned long>(cache.hits()), static_cast<unsigned long>(cache.misses())
+        );
+    }
 
-    semantic_data::~semantic_data(){
-        for(auto iter = global_variable_map.begin(); iter != global_variable_map.end(); ++iter){
-            if(iter->second.node){
-                poly::dispose(iter->second.node);
-            }else{
-                delete iter->second.v;
+    // 入力の1行を評価して出力の1行を書き出す
+    // 空行には空行を, 失敗した文にはエラーメッセージを書き出す
+    // report_peakであれば空行以外の行に評価のメモリの最大値を添える
+    inline void eval_line(evaluator &ev, context &cx, const char *first, const char *last, output_buffer &o, bool report_peak = false){
+        if(last != first && *(last - 1) == '\r'){ --last; }
+        const char *p = first;
+        while(p != last && *p == ' '){ ++p; }
+        if(p != last){
+            try{
+                ev.eval(cx, first, last, o);
+            }catch(std::runtime_error &e){
+                evaluator::write_error(cx, e.what(), o);
             }
+            if(report_peak){ write_peak(o, cx.peak_memory()); }
         }
+        o.put('\n');
     }
 
-    struct value : eval_target{
-        virtual std::string ast_str() const{
-            std::stringstream ss;
-            ss << v;
-            if(!real){ ss << "i"; }
-            return ss.str();
-        }
-
-        virtual void eval(semantic_data &sd) const{
-            poly::node *ptr;
-            if(real){
-                ptr = poly::constant(v, 0);
-            }else{
-                ptr = poly::constant(0, v);
+    // eval_lineと同じく評価し, 結果の行の前に評価前の見積りを節ごとに#で始まる行で書き出す
+    inline void explain_line(evaluator &ev, context &cx, const char *first, const char *last, output_buffer &o, bool report_peak = false){
+        if(last != first && *(last - 1) == '\r'){ --last; }
+        const char *p = first;
+        while(p != last && *p == ' '){ ++p; }
+        if(p != last){
+            try{
+                cx.begin_evaluation();
+                std::unique_ptr<analyzer::eval_target> root(ev.parse(cx, first, last));
+                analyzer::cost_estimator ce(cx.data(), true);
+                ce(*root);
+                ce.write_explanation(o);
+                poly::node *q = evaluator::evaluate(cx, *root);
+                evaluator::write_result(cx, q, o);
+                poly::dispose(cx, q);
+            }catch(std::runtime_error &e){
+                evaluator::write_error(cx, e.what(), o);
             }
-            sd.push_stack(ptr);
-        }
-
-        fpoint v;
-        bool real;
-    };
-
-    struct symbol : eval_target{
-        virtual std::string ast_str() const{
-            return *s.ptr;
+            if(report_peak){ write_peak(o, cx.peak_memory()); }
         }
+        o.put('\n');
+    }
 
-        virtual void eval(semantic_data &sd) const{
-            stack_element se = sd.inquiry_symbol(this);
-            if(se.node){
-                sd.push_stack(poly::copy(se.node));
+    // 改行区切りの文を順に評価し, 1行につき1つの結果を書き出す
+    // 空行には空行を返す
+    // explainであれば各文の見積りを結果の前に添える
+    void run_batch(line_source &in, output_buffer &o, context &cx, bool report_peak = false, bool explain = false){
+        evaluator ev;
+        const char *first, *last;
+        while(in.next(first, last)){
+            if(explain){
+                explain_line(ev, cx, first, last, o, report_peak);
             }else{
-                sd.push_stack(poly::variable(*s.ptr));
+                eval_line(ev, cx, first, last, o, report_peak);
             }
+            in.release(last);
         }
-
-        str_wrapper s;
-    };
-
-    void semantic_data::register_local_arg(const symbol *ptr, const stack_element target){
-        local_args.back().insert(std::make_pair(ptr->s, target));
-    }
-
-    void semantic_data::register_let_value(const symbol *ptr, const stack_element target){
-        global_variable_map.insert(std::make_pair(ptr->s, target));
+        o.flush();
     }
 
-    stack_element semantic_data::pop_stack(){
-        if(stack.empty()){
-            throw(error("stack is empty."));
+    // run_batchを字句解析と構文解析, 評価, 書き出しの3段に分けて並行に行う
+    // 文k+1の構文解析と文k-1の書き出しを文kの評価と重ねる
+    // 段の間は容量の決まったspsc_queueでつなぎ, 文はbatch_sizeずつまとめて渡す
+    // 評価は1つのスレッドで入力の順に行うので, let, unletの意味はrun_batchと変わらない
+    class pipeline_batch{
+    public:
+        explicit pipeline_batch(context &cx_, bool report_peak_ = false)
+            : cx(cx_), report_peak(report_peak_), parsed(queue_size), evaluated(queue_size), recycled(queue_size * 2 + 4)
+        {}
+
+        void run(line_source &in, output_buffer &o){
+            // いずれかの段が失敗しても, 前後の段が待ち続けないよう残りを流してから終える
+            std::exception_ptr parse_error, eval_error, print_error;
+            std::thread parse_thread([&]{
+                try{ parse_stage(in); }catch(...){ parse_error = std::current_exception(); }
+                parsed.close();
+            });
+            std::thread print_thread([&]{
+                std::unique_ptr<batch> b;
+                try{ print_stage(o); }catch(...){ print_error = std::current_exception(); }
+                while(evaluated.pop(b)){ recycled.push(std::move(b)); }
+            });
+            std::unique_ptr<batch> b;
+            try{ eval_stage(); }catch(...){ eval_error = std::current_exception(); }
+            while(parsed.pop(b)){ b.reset(); }
+            evaluated.close();
+            parse_thread.join();
+            print_thread.join();
+
+            // 書き出し済みの結果を割り当て器に返す
+            while(recycled.try_pop(b)){ b->dispose(cx); }
+            if(parse_error){ std::rethrow_exception(parse_error); }
+            if(eval_error){ std::rethrow_exception(eval_error); }
+            if(print_error){ std::rethrow_exception(print_error); }
+            o.flush();
         }
-        stack_element a = stack.back();
-        stack.pop_back();
-        return a;
-    }
 
-    stack_element semantic_data::r_access(std::size_t i) const{
-        return stack[stack.size() - i - 1];
-    }
+    private:
+        static const std::size_t batch_size = 64;
+        static const std::size_t queue_size = 8;
 
-    const stack_element semantic_data::inquiry_symbol(const symbol *s){
-        for(auto iter = local_args.rbegin(); iter != local_args.rend(); ++iter){
-            auto jter = iter->find(s->s);
-            if(jter != iter->end()){ return jter->second; }
-        }
-        auto iter = global_variable_map.find(s->s);
-        if(iter != global_variable_map.end()){ return iter->second; }
-        stack_element se;
-        se.v = s;
-        return se;
-    }
+        struct item{
+            item() : root(), result(nullptr), message(), blank(false), peak(0){}
 
-    struct binary_operator : eval_target{
-        binary_operator() : lhs(nullptr), rhs(nullptr){}
+            std::unique_ptr<analyzer::eval_target> root;
+            poly::node *result;
+            std::string message;
+            bool blank;
+            std::size_t peak;
+        };
 
-        virtual void eval(semantic_data &sd) const{
-            lhs->eval(sd);
-            rhs->eval(sd);
-            stack_element er = sd.pop_stack(), el = sd.pop_stack();
-            if(!er.node || !el.node){
-                throw(error("stack element is value, in binary operator."));
-            }
-            poly::node *l = el.node, *r = er.node;
-        }
+        struct batch{
+            std::vector<item> items;
 
-        std::unique_ptr<eval_target> lhs, rhs;
-    };
-
-    struct binary_operator_add : binary_operator{
-        virtual std::string ast_str() const{
-            std::string str;
-            str += "(";
-            str += "+ " + lhs->ast_str() + " " + rhs->ast_str();
-            str += ")";
-            return str;
-        }
+            void dispose(context &cx){
+                for(auto iter = items.begin(); iter != items.end(); ++iter){
+                    if(iter->result){ poly::dispose(cx, iter->result); }
+                }
+            }
+        };
 
-        virtual void eval(semantic_data &sd) const{
-            lhs->eval(sd);
-            rhs->eval(sd);
-            stack_element er = sd.pop_stack(), el = sd.pop_stack();
-            if(!er.node || !el.node){
-                throw(error("stack element is value, in add operator."));
+        // 行を読み, 構文木にして渡す
+        void parse_stage(line_source &in){
+            evaluator ev;
+            std::unique_ptr<batch> b(new batch);
+            const char *first, *last;
+            while(in.next(first, last)){
+                b->items.push_back(item());
+                item &i(b->items.back());
+                if(last != first && *(last - 1) == '\r'){ --last; }
+                const char *p = first;
+                while(p != last && *p == ' '){ ++p; }
+                if(p == last){
+                    i.blank = true;
+                }else{
+                    try{
+                        i.root = ev.parse(cx, first, last);
+                    }catch(std::runtime_error &e){
+                        i.message = e.what();
+                    }
+                }
+                // 構文木は入力を参照しない
+                in.release(last);
+                if(b->items.size() >= batch_size){
+                    parsed.push(std::move(b));
+                    b.reset(new batch);
+                }
             }
-            poly::node *l = el.node, *r = er.node;
-            poly::add(l, r);
-            sd.push_stack(l);
+            if(!b->items.empty()){ parsed.push(std::move(b)); }
         }
-    };
 
-    struct binary_operator_sub : binary_operator{
-        virtual std::string ast_str() const{
-            std::string str;
-            str += "(";
-            str += "- " + lhs->ast_str() + " " + rhs->ast_str();
-            str += ")";
-            return str;
+        // 構文木を入力の順に評価する
+        // 構文木はここで破棄し, 書き出しを終えた結果もここで割り当て器に返す
+        void eval_stage(){
+            std::unique_ptr<batch> b, r;
+            while(parsed.pop(b)){
+                while(recycled.try_pop(r)){ r->dispose(cx); }
+                for(auto iter = b->items.begin(); iter != b->items.end(); ++iter){
+                    if(!iter->root){ continue; }
+                    try{
+                        iter->result = evaluator::evaluate(cx, *iter->root);
+                    }catch(std::runtime_error &e){
+                        iter->message = e.what();
+                    }
+                    iter->peak = cx.peak_memory();
+                    iter->root.reset();
+                }
+                evaluated.push(std::move(b));
+            }
         }
 
-        virtual void eval(semantic_data &sd) const{
-            lhs->eval(sd);
-            rhs->eval(sd);
-            stack_element er = sd.pop_stack(), el = sd.pop_stack();
-            if(!er.node || !el.node){
-                throw(error("stack element is value, in sub operator."));
+        // 結果を書き出し, 評価の段へ返す
+        // recycledは流れているbatchの数より大きいので, 返す時に待つことはない
+        void print_stage(output_buffer &o){
+            std::unique_ptr<batch> b;
+            while(evaluated.pop(b)){
+                for(auto iter = b->items.begin(); iter != b->items.end(); ++iter){
+                    if(iter->result){
+                        evaluator::write_result(cx, iter->result, o);
+                    }else if(!iter->blank){
+                        evaluator::write_error(cx, iter->message.c_str(), o);
+                    }
+                    if(report_peak && !iter->blank){ write_peak(o, iter->peak); }
+                    o.put('\n');
+                }
+                recycled.push(std::move(b));
             }
-            poly::node *l = el.node, *r = er.node;
-            poly::sub(l, r);
-            sd.push_stack(l);
         }
+
+        context &cx;
+        bool report_peak;
+        spsc_queue<std::unique_ptr<batch>> parsed, evaluated, recycled;
     };
 
-    struct binary_operator_mul : binary_operator{
-        virtual std::string ast_str() const{
-            std::string str;
-            str += "(";
-            str += "* " + lhs->ast_str() + " " + rhs->ast_str();
-            str += ")";
-            return str;
-        }
+    // 行がletかunletで始まるかどうか
+    inline bool is_definition_line(const char *first, const char *last){
+        while(first != last && *first == ' '){ ++first; }
+        auto keyword = [&](const char *k) -> bool{
+            std::size_t n = std::strlen(k);
+            if(static_cast<std::size_t>(last - first) < n || std::memcmp(first, k, n) != 0){ return false; }
+            if(first + n == last){ return true; }
+            char c = first[n];
+            return !(std::isalnum(static_cast<unsigned char>(c)) || c == '_');
+        };
+        return keyword("let") || keyword("unlet");
+    }
 
-        virtual void eval(semantic_data &sd) const{
-            lhs->eval(sd);
-            rhs->eval(sd);
-            stack_element er = sd.pop_stack(), el = sd.pop_stack();
-            if(!er.node || !el.node){
-                throw(error("stack element is value, in multiply operator."));
+    // run_batchを複数のスレッドで行う
+    // 行をchunkに分けてworkerに配り, 結果は入力の順に書き出す
+    // 各workerは自身のparserとコンテキストを持つ
+    // let, unletは先行する全ての行の評価を待ってから全てのコンテキストに適用する
+    class parallel_batch{
+    public:
+        parallel_batch(std::size_t jobs, std::size_t max_let_values, bool report_peak_ = false)
+            : report_peak(report_peak_), workers(), contexts(), mutex(), job_cond(), done_cond(), jobs_(), done(), stop(false)
+        {
+            if(jobs == 0){ jobs = 1; }
+            for(std::size_t i = 0; i < jobs; ++i){
+                contexts.push_back(std::unique_ptr<context>(new context(max_let_values)));
+            }
+            for(std::size_t i = 0; i < jobs; ++i){
+                workers.push_back(std::thread(&parallel_batch::worker_loop, this, std::ref(*contexts[i])));
             }
-            poly::node *l = el.node, *r = er.node;
-            sd.push_stack(poly::multiply(r, l));
-            poly::dispose(l);
-            poly::dispose(r);
         }
-    };
 
-    struct binary_operator_div : binary_operator{
-        virtual std::string ast_str() const{
-            std::string str;
-            str += "(";
-            str += "/ " + lhs->ast_str() + " " + rhs->ast_str();
-            str += ")";
-            return str;
+        ~parallel_batch(){
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+            }
+            job_cond.notify_all();
+            for(auto iter = workers.begin(); iter != workers.end(); ++iter){
+                iter->join();
+            }
         }
 
-        virtual void eval(semantic_data &sd) const{
-            lhs->eval(sd);
-            rhs->eval(sd);
-            stack_element er = sd.pop_stack(), el = sd.pop_stack();
-            if(!er.node || !el.node){
-                throw(error("stack element is value, in divide operator."));
+        // 全てのコンテキストに束縛を読み込む. runの前に呼ぶ
+        void load(const session_image &image){
+            for(auto iter = contexts.begin(); iter != contexts.end(); ++iter){
+                image.load(**iter);
             }
-            poly::node *l = el.node, *r = er.node;
-            sd.push_stack(poly::divide(l, r, nullptr));
-            poly::dispose(l);
-            poly::dispose(r);
         }
-    };
 
-    struct binary_operator_pow : binary_operator{
-        virtual std::string ast_str() const{
-            std::string str;
-            str += "(";
-            str += "^ " + lhs->ast_str() + " " + rhs->ast_str();
-            str += ")";
-            return str;
+        void set_time_limit(std::chrono::milliseconds limit){
+            for(auto iter = contexts.begin(); iter != contexts.end(); ++iter){
+                (*iter)->set_time_limit(limit);
+            }
         }
 
-        virtual void eval(semantic_data &sd) const{
-            lhs->eval(sd);
-            rhs->eval(sd);
-            stack_element er = sd.pop_stack(), el = sd.pop_stack();
-            if(!er.node || !el.node){
-                throw(error("stack element is value, in power operator."));
+        void set_memory_limit(std::size_t bytes){
+            for(auto iter = contexts.begin(); iter != contexts.end(); ++iter){
+                (*iter)->set_memory_limit(bytes);
             }
-            poly::node *l = el.node, *r = er.node;
-            sd.push_stack(poly::power(l, r));
-            poly::dispose(l);
-            poly::dispose(r);
         }
-    };
-
-    struct negate_expr : eval_target{
-        negate_expr() : operand(nullptr){}
 
-        virtual std::string ast_str() const{
-            return "-" + operand->ast_str();
+        void set_cost_limit(double work){
+            for(auto iter = contexts.begin(); iter != contexts.end(); ++iter){
+                (*iter)->set_cost_limit(work);
+            }
         }
 
-        virtual void eval(semantic_data &sd) const{
-            operand->eval(sd);
-            stack_element a = sd.pop_stack();
-            if(!a.node){
-                throw(error("operand is lambda expression, in neg operator."));
+        // 全てのコンテキストで1つのcacheを共有する
+        void set_result_cache(result_cache *cache){
+            for(auto iter = contexts.begin(); iter != contexts.end(); ++iter){
+                (*iter)->set_result_cache(cache);
             }
-            poly::change_sign(a.node);
-            sd.push_stack(a.node);
         }
 
-        std::unique_ptr<eval_target> operand;
-    };
-
-    struct lambda;
-
-    struct sequence : eval_target{
-        sequence() : e(nullptr), next(nullptr), head(nullptr){}
-
-        virtual std::string ast_str() const{
-            std::string str;
-            str += "(seq";
-            for(const sequence *ptr = head; ptr; ptr = ptr->next.get()){
-                str += " " + ptr->e->ast_str();
+        void set_disk_cache(disk_cache *cache){
+            for(auto iter = contexts.begin(); iter != contexts.end(); ++iter){
+                (*iter)->set_disk_cache(cache);
             }
-            str += ")";
-            return str;
         }
 
-        virtual void eval(semantic_data &sd) const{
-            if(head == this){
-                e->eval(sd);
-                return;
-            }
-            for(const sequence *ptr = head->next.get(); ptr; ptr = ptr->next.get()){
-                ptr->e->eval(sd);
+        void set_template_limit(std::size_t n){
+            for(auto iter = contexts.begin(); iter != contexts.end(); ++iter){
+                (*iter)->set_template_limit(n);
             }
-            sd.push_stack(head->e.get());
         }
 
-        // 評価対象の式
-        std::unique_ptr<eval_target> e;
-
-        // リンクリスト 次の評価対象の式
-        std::unique_ptr<sequence> next;
-
-        // 先頭
-        sequence *head;
-    };
-
-    struct lambda : sequence{
-        lambda() : args(nullptr), name(to_string(lambda_counter()) + "_lambda"){}
-
-        virtual std::string ast_str() const{
-            std::string str;
-            str += *name.ptr;
-            for(const sequence *ptr = args->head; ptr; ptr = ptr->next.get()){
-                str += " " + ptr->e->ast_str();
+        void set_output_format(output_format f){
+            for(auto iter = contexts.begin(); iter != contexts.end(); ++iter){
+                (*iter)->set_output_format(f);
             }
-            str += " -> " + e->ast_str();
-            return str;
         }
 
-        virtual void eval(semantic_data &sd) const{
-            sd.push_stack(this);
+        void set_let_tracking(bool b){
+            for(auto iter = contexts.begin(); iter != contexts.end(); ++iter){
+                (*iter)->set_let_tracking(b);
+            }
         }
 
-        // lambda式の引数
-        std::unique_ptr<sequence> args;
-
-        // lambda式の名前
-        str_wrapper name;
-
-    private:
-        static std::size_t lambda_counter(){
-            static std::size_t i = 0;
-            return i++;
+        void set_dfa_lexer(bool b){
+            for(auto iter = contexts.begin(); iter != contexts.end(); ++iter){
+                (*iter)->set_dfa_lexer(b);
+            }
         }
-    };
-
-    struct equality : eval_target{
-        equality() : s(nullptr), e(nullptr){}
 
-        virtual std::string ast_str() const{
-            std::string str;
-            str += s->ast_str();
-            str += " = ";
-            str += e->ast_str();
-            return str;
+        // 束縛は全てのコンテキストで等しいので, 先頭のものを代表とする
+        context &primary(){
+            return *contexts.front();
         }
 
-        virtual void eval(semantic_data &sd) const{
-            e->eval(sd);
-            stack_element se = sd.pop_stack();
-            sd.register_let_value(s.get(), se);
+        void run(line_source &in, output_buffer &o){
+            evaluator ev;
+            const std::size_t max_in_flight = workers.size() * 4;
+            std::size_t next_seq = 0, written_seq = 0;
+            chunk c;
+            c.seq = next_seq;
+            const char *first, *last, *consumed = nullptr;
+
+            // 各chunkの末尾. 結果を書き出したchunkの領域は再び参照されない
+            std::deque<const char*> chunk_ends;
+            std::size_t released_seq = 0;
+            auto release = [&](){
+                while(released_seq < written_seq){
+                    in.release(chunk_ends.front());
+                    chunk_ends.pop_front();
+                    ++released_seq;
+                }
+            };
+            auto submit = [&](){
+                if(c.lines.empty()){ return; }
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    done_cond.wait(lock, [&]{ return next_seq - written_seq < max_in_flight || done.count(written_seq) > 0; });
+                    write_ready(lock, o, written_seq);
+                    jobs_.push_back(std::move(c));
+                    ++next_seq;
+                }
+                job_cond.notify_one();
+                chunk_ends.push_back(consumed);
+                release();
+                c = chunk();
+                c.seq = next_seq;
+            };
+            auto drain = [&](){
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    while(written_seq < next_seq){
+                        done_cond.wait(lock, [&]{ return done.count(written_seq) > 0; });
+                        write_ready(lock, o, written_seq);
+                    }
+                }
+                release();
+            };
+            while(in.next(first, last)){
+                if(is_definition_line(first, last)){
+                    submit();
+                    drain();
+                    output_buffer discard;
+                    for(auto iter = contexts.begin(); iter != contexts.end(); ++iter){
+                        eval_line(ev, **iter, first, last, iter == contexts.begin() ? o : discard, report_peak);
+                        discard.clear();
+                    }
+                    continue;
+                }
+                // mapされていない入力は次のnextで行が無効になるのでchunkに複写する
+                if(in.mapped()){
+                    c.lines.push_back(std::make_pair(first, last));
+                }else{
+                    std::size_t offset = c.storage.size();
+                    c.storage.append(first, last);
+                    c.offsets.push_back(std::make_pair(offset, c.storage.size()));
+                    c.lines.push_back(std::make_pair(nullptr, nullptr));
+                }
+                consumed = last;
+                if(c.lines.size() >= chunk_size){ submit(); }
+            }
+            submit();
+            drain();
+            o.flush();
         }
 
-        // 左辺 記号
-        std::unique_ptr<symbol> s;
+    private:
+        static const std::size_t chunk_size = 256;
 
-        // 右辺 式
-        std::unique_ptr<eval_target> e;
-    };
+        struct chunk{
+            std::size_t seq;
+            std::vector<std::pair<const char*, const char*>> lines;
 
-    struct equality_sequence : eval_target{
-        equality_sequence() : e(nullptr), next(nullptr), head(nullptr){}
+            // mapされていない入力の行の複写
+            std::string storage;
+            std::vector<std::pair<std::size_t, std::size_t>> offsets;
+        };
 
-        virtual std::string ast_str() const{
-            return "";
+        // 順番が来た結果を書き出す
+        void write_ready(std::unique_lock<std::mutex> &lock, output_buffer &o, std::size_t &written_seq){
+            for(auto iter = done.find(written_seq); iter != done.end(); iter = done.find(written_seq)){
+                std::unique_ptr<output_buffer> results(std::move(iter->second));
+                done.erase(iter);
+                ++written_seq;
+                lock.unlock();
+                o.write(results->data(), results->size());
+                lock.lock();
+            }
         }
 
-        virtual void eval(semantic_data &sd) const{
-            for(const equality_sequence *ptr = head; ptr; ptr = ptr->next.get()){
-                ptr->e->eval(sd);
+        void worker_loop(context &cx){
+            evaluator ev;
+            for(; ; ){
+                chunk c;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    job_cond.wait(lock, [this]{ return stop || !jobs_.empty(); });
+                    if(jobs_.empty()){ return; }
+                    c = std::move(jobs_.front());
+                    jobs_.pop_front();
+                }
+                std::unique_ptr<output_buffer> results(new output_buffer);
+                for(std::size_t i = 0; i < c.lines.size(); ++i){
+                    if(c.lines[i].first){
+                        eval_line(ev, cx, c.lines[i].first, c.lines[i].second, *results, report_peak);
+                    }else{
+                        const char *base = c.storage.data();
+                        eval_line(ev, cx, base + c.offsets[i].first, base + c.offsets[i].second, *results, report_peak);
+                    }
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    done[c.seq] = std::move(results);
+                }
+                done_cond.notify_one();
             }
         }
 
-        // 等式
-        std::unique_ptr<equality> e;
+        bool report_peak;
+        std::vector<std::thread> workers;
+        std::vector<std::unique_ptr<context>> contexts;
+        std::mutex mutex;
+        std::condition_variable job_cond, done_cond;
+        std::deque<chunk> jobs_;
 
-        // リンクリスト 次の等式
-        std::unique_ptr<equality_sequence> next;
+        // 評価を終えたchunkの結果. seqの順に書き出すまで保持する
+        std::map<std::size_t, std::unique_ptr<output_buffer>> done;
 
-        // 先頭
-        equality_sequence *head;
+        bool stop;
     };
 
-    struct statement : eval_target{
-        statement() : e(nullptr), w(nullptr){}
-
-        virtual std::string ast_str() const{
-            std::string str;
-            str += e->ast_str();
-            if(w){
-                str += " where";
-                for(const equality_sequence *ptr = w.get()->head; ptr; ptr = ptr->next.get()){
-                    str += (ptr != w.get()->head ? ", " : " ") + ptr->e->ast_str();
-                }
+#if defined(__linux__)
+    // Unix domain socketで文を受け付けるサーバ
+    // 要求, 応答ともに4byte little endianの長さを前置したframe
+    // 応答のframeは先頭1byteが状態(0: 成功, 1: 失敗)で, 続いて結果の文字列
+    // 要求が二進の要求(wire.hpp)であれば, 応答も二進の応答になる
+    // 接続はいずれか1つのworkerに固定され, 接続ごとにコンテキストを持つ
+    // DFAで字句解析する設定では, 文の要求は届いた端からstream_lexerで字句解析し, workerにはtoken列を渡す
+    class server{
+    public:
+        // image: 各接続のコンテキストに予め読み込む束縛. nullptrであれば空の状態から始める
+        // time_limit_: 1つの要求の評価に掛けてよい時間. 0は無制限
+        // memory_limit_: 1つの要求の評価で新たに使ってよいメモリ. 0は無制限
+        // cost_limit_: 評価の前に見積もった費用の上限. 超える要求は評価せずに失敗を返す. 0は無制限
+        // cache_: 全ての接続で共有する結果のcache. nullptrであれば使わない
+        // disk_: 全ての接続で共有する, ファイルに残す結果のcache. nullptrであれば使わない
+        // template_limit_: workerごとに保持する構文木の雛形の数. 0は使わない
+        // format_: 文の要求に返す結果の書式
+        // let_tracking_: letの依存関係を記録し, 束縛し直した記号に依存する束縛を再計算する
+        // dfa_lexer_: 字句解析にlexer.txtから生成したDFAを使い, 文の要求を届いた端から字句解析する
+        server(
+            const std::string &path_,
+            std::size_t worker_num,
+            const session_image *image_ = nullptr,
+            std::chrono::milliseconds time_limit_ = std::chrono::milliseconds(0),
+            std::size_t memory_limit_ = 0,
+            double cost_limit_ = 0,
+            result_cache *cache_ = nullptr,
+            disk_cache *disk_ = nullptr,
+            std::size_t template_limit_ = 0,
+            output_format format_ = output_text,
+            bool let_tracking_ = false,
+            bool dfa_lexer_ = false
+        ) : path(path_), image(image_), time_limit(time_limit_), memory_limit(memory_limit_), cost_limit(cost_limit_), cache(cache_), disk(disk_), template_limit(template_limit_), format(format_), let_tracking(let_tracking_), dfa_lexer(dfa_lexer_), listen_fd(-1), epoll_fd(-1), event_fd(-1), signal_fd(-1), next_id(0), workers(worker_num > 0 ? worker_num : 1)
+        {}
+
+        ~server(){
+            if(listen_fd >= 0){
+                ::close(listen_fd);
+                ::unlink(path.c_str());
+            }
+            if(epoll_fd >= 0){ ::close(epoll_fd); }
+            if(event_fd >= 0){ ::close(event_fd); }
+            if(signal_fd >= 0){ ::close(signal_fd); }
+            for(auto iter = connections.begin(); iter != connections.end(); ++iter){
+                ::close(iter->second.fd);
             }
-            return str;
         }
 
-        virtual void eval(semantic_data &sd) const{
-            if(w){ w->eval(sd); }
-            e->eval(sd);
+        // SIGINTかSIGTERMを受けるまで要求を処理する
+        void run(){
+            open();
+            for(std::size_t i = 0; i < workers.size(); ++i){
+                workers[i].th = std::thread(&server::worker_loop, this, std::ref(workers[i]));
+            }
+            try{
+                event_loop();
+            }catch(...){
+                stop_workers();
+                throw;
+            }
+            stop_workers();
         }
 
-        // 評価対象の式
-        std::unique_ptr<eval_target> e;
-
-        // where部
-        std::unique_ptr<equality_sequence> w;
-    };
+    private:
+        // 1MBを超えるframeは受け付けない
+        static const std::uint32_t max_frame_size = 1 << 20;
+
+        // 書き出せていない応答がmax_pending_outputを超えるか, 評価を待つ要求がmax_in_flightに達した接続は,
+        // 読むのもworkerに渡すのも止め, 応答を書いて下回ってから再開する
+        static const std::size_t max_pending_output = 4 << 20;
+        static const std::size_t max_in_flight = 64;
+
+        // 字句解析したtokenの, 文字を並べた列の中の範囲
+        struct lexed_token{
+            lexer::token kind;
+            std::uint32_t first, last;
+        };
 
-    struct defined_symbol : eval_target{
-        defined_symbol() : e(nullptr), s(nullptr){}
+        // lexedであれば, statementはtokenの文字を並べたもので, tokensがその範囲を持つ
+        // lexical_errorはどのtokenにも一致しない入力があったこと
+        struct job{
+            std::uint64_t conn_id;
+            bool close_session;
+            std::string statement;
+            std::shared_ptr<cancel_token> token;
+            bool lexed, lexical_error;
+            std::vector<lexed_token> tokens;
+
+            job() : conn_id(0), close_session(false), statement(), token(), lexed(false), lexical_error(false), tokens(){}
+        };
 
-        virtual std::string ast_str() const{
-            std::string str;
-            str += s->ast_str();
-            str += " = ";
-            str += e->ast_str();
-            return str;
-        }
+        // 読み終えたtokenをjobに写す. stream_lexerのtokenは次のfeedまでしか有効でない
+        class token_collector{
+        public:
+            explicit token_collector(job &j_) : j(&j_){}
+
+            token_collector &operator =(const std::pair<lexer::token, std::pair<const char*, const char*>> &t){
+                lexed_token l;
+                l.kind = t.first;
+                l.first = static_cast<std::uint32_t>(j->statement.size());
+                j->statement.append(t.second.first, t.second.second);
+                l.last = static_cast<std::uint32_t>(j->statement.size());
+                j->tokens.push_back(l);
+                return *this;
+            }
 
-        // 束縛対象の式
-        std::unique_ptr<eval_target> e;
+            token_collector &operator *(){ return *this; }
+            token_collector &operator ++(){ return *this; }
+            token_collector &operator ++(int){ return *this; }
 
-        // 束縛対象に結び付けられる名前
-        std::unique_ptr<symbol> s;
-    };
+        private:
+            job *j;
+        };
 
+        struct response{
+            std::uint64_t conn_id;
+            std::string frame;
+        };
 
-    // ---- semantic action
-    class semantic_action{
-    public:
-        void syntax_error(){
-            throw(error("syntax error."));
-        }
+        struct worker{
+            std::thread th;
+            std::mutex mutex;
+            std::condition_variable cond;
+            std::deque<job> queue;
+            bool stop;
 
-        void stack_overflow(){
-            throw(error("stack overflow."));
-        }
+            worker() : th(), mutex(), cond(), queue(), stop(false){}
+        };
 
-        template<class T>
-        static void downcast(T *&x, eval_target *y){
-            x = static_cast<T*>(y);
-        }
+        // 接続が閉じられると, その接続の評価中や待ちの要求はtokenで打ち切る
+        // in_flightはworkerに渡して応答がまだ届いていない要求の数
+        // pausedは応答が溜まり過ぎて, 読むのとworkerに渡すのを止めている間true
+        // lexは先頭のframeの文を字句解析しており, lexedはその本体のうち字句解析器に渡したbyte数, partialは読み終えたtoken
+        struct connection{
+            int fd;
+            std::size_t worker_idx;
+            std::shared_ptr<cancel_token> token;
+            std::vector<char> in;
+            std::string out;
+            std::size_t in_flight;
+            bool want_write, paused;
+            lexer::stream_lexer lex;
+            std::size_t lexed;
+            job partial;
+        };
 
-        template<class U>
-        static void upcast(eval_target *&x, U *y){
-            x = y;
+        void open(){
+            listen_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if(listen_fd < 0){ throw(error("socket failed.")); }
+            sockaddr_un addr;
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            if(path.size() >= sizeof(addr.sun_path)){ throw(error("socket path is too long.")); }
+            std::memcpy(addr.sun_path, path.c_str(), path.size());
+            ::unlink(path.c_str());
+            if(::bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0){ throw(error("bind failed.")); }
+            if(::listen(listen_fd, SOMAXCONN) < 0){ throw(error("listen failed.")); }
+
+            epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+            event_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            sigset_t mask;
+            sigemptyset(&mask);
+            sigaddset(&mask, SIGINT);
+            sigaddset(&mask, SIGTERM);
+            ::pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+            signal_fd = ::signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+            if(epoll_fd < 0 || event_fd < 0 || signal_fd < 0){ throw(error("epoll setup failed.")); }
+            ::signal(SIGPIPE, SIG_IGN);
+            watch(listen_fd, EPOLLIN);
+            watch(event_fd, EPOLLIN);
+            watch(signal_fd, EPOLLIN);
         }
 
-        eval_target *make_statement(eval_target *e, equality_sequence *es){
-            statement *s = new statement;
-            s->e.reset(e);
-            s->w.reset(es);
-            return s;
+        void watch(int fd, std::uint32_t events){
+            epoll_event ev;
+            ev.events = events;
+            ev.data.fd = fd;
+            ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
         }
 
-        eval_target *define_symbol(symbol *s, eval_target *e){
-            defined_symbol *d = new defined_symbol;
-            d->e.reset(e);
-            d->s.reset(s);
-            return d;
+        void event_loop(){
+            std::vector<epoll_event> events(64);
+            for(; ; ){
+                int n = ::epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), -1);
+                if(n < 0){
+                    if(errno == EINTR){ continue; }
+                    throw(error("epoll_wait failed."));
+                }
+                for(int i = 0; i < n; ++i){
+                    int fd = events[i].data.fd;
+                    if(fd == signal_fd){
+                        return;
+                    }else if(fd == listen_fd){
+                        accept_all();
+                    }else if(fd == event_fd){
+                        std::uint64_t c;
+                        while(::read(event_fd, &c, sizeof(c)) > 0);
+                        deliver_responses();
+                    }else{
+                        auto iter = fd_to_id.find(fd);
+                        if(iter == fd_to_id.end()){ continue; }
+                        std::uint64_t id = iter->second;
+                        if(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)){
+                            if(!read_frames(id)){
+                                close_connection(id);
+                                continue;
+                            }
+                        }
+                        if(events[i].events & EPOLLOUT){
+                            if(!flush(id)){ close_connection(id); }
+                        }
+                    }
+                }
+            }
         }
 
-        equality_sequence *make_equality_sequence(equality *e){
-            equality_sequence *es = new equality_sequence;
-            es->e.reset(e);
-            es->head = es;
-            return es;
+        void accept_all(){
+            for(; ; ){
+                int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if(fd < 0){ return; }
+                std::uint64_t id = next_id++;
+                connection &c(connections[id]);
+                c.fd = fd;
+                c.worker_idx = static_cast<std::size_t>(id % workers.size());
+                c.token = std::make_shared<cancel_token>();
+                c.in_flight = 0;
+                c.want_write = false;
+                c.paused = false;
+                c.lexed = 0;
+                fd_to_id[fd] = id;
+                watch(fd, EPOLLIN);
+            }
         }
 
-        equality_sequence *make_equality_sequence(equality_sequence *es, equality *e){
-            equality_sequence *ptr = new equality_sequence;
-            ptr->e.reset(e);
-            if(es){
-                ptr->head = es->head;
-                es->next.reset(ptr);
-            }else{ ptr->head = ptr; }
-            return ptr;
+        // 読めるだけ読み, 揃ったframeをworkerに渡す
+        // 接続を閉じるべきならfalseを返す
+        bool read_frames(std::uint64_t id){
+            connection &c(connections[id]);
+            char buf[65536];
+            for(; ; ){
+                ssize_t r = ::read(c.fd, buf, sizeof(buf));
+                if(r == 0){ return false; }
+                if(r < 0){
+                    if(errno == EAGAIN || errno == EWOULDBLOCK){ break; }
+                    if(errno == EINTR){ continue; }
+                    return false;
+                }
+                c.in.insert(c.in.end(), buf, buf + r);
+                // 一度に溜めるのは1つのframeの上限まで. 残りは次のeventで読む
+                if(c.in.size() > max_frame_size){ break; }
+            }
+            return update(id);
         }
 
-        equality *make_equality(symbol *s, eval_target *e){
-            equality *ptr = new equality;
-            ptr->s.reset(s);
-            ptr->e.reset(e);
-            return ptr;
+        static bool blocked(const connection &c){
+            return c.out.size() >= max_pending_output || c.in_flight >= max_in_flight;
         }
 
-        eval_target *make_add(eval_target *lhs, eval_target *rhs){
-            binary_operator_add *e = new binary_operator_add;
-            e->lhs.reset(lhs);
-            e->rhs.reset(rhs);
-            return e;
+        // 揃ったframeを接続が止まるまでworkerに渡し, 止まっているかどうかで待つeventを変える
+        // 接続を閉じるべきならfalseを返す
+        bool update(std::uint64_t id){
+            connection &c(connections[id]);
+            std::size_t pos = 0;
+            while(c.in.size() - pos >= 4 && !blocked(c)){
+                std::uint32_t len = read_u32(&c.in[pos]);
+                if(len > max_frame_size){ return false; }
+                const char *body = c.in.data() + pos + 4;
+                std::size_t arrived = std::min<std::size_t>(c.in.size() - pos - 4, len);
+                // 文の要求は揃うのを待たずに, 届いた分を字句解析する
+                bool streamed = dfa_lexer && arrived > 0 && !is_wire_request(body, body + arrived);
+                if(streamed){
+                    c.lex.feed(body + c.lexed, arrived - c.lexed, token_collector(c.partial));
+                    c.lexed = arrived;
+                }
+                if(arrived < len){ break; }
+                job j;
+                if(streamed){
+                    j.lexical_error = !c.lex.finish(token_collector(c.partial));
+                    j.lexed = true;
+                    j.statement.swap(c.partial.statement);
+                    j.tokens.swap(c.partial.tokens);
+                    c.lexed = 0;
+                }else{
+                    j.statement.assign(body, body + len);
+                }
+                j.conn_id = id;
+                j.token = c.token;
+                post(c.worker_idx, std::move(j));
+                ++c.in_flight;
+                pos += 4 + len;
+            }
+            c.in.erase(c.in.begin(), c.in.begin() + pos);
+            bool want_write = !c.out.empty(), paused = blocked(c);
+            if(want_write != c.want_write || paused != c.paused){
+                epoll_event ev;
+                ev.events = (paused ? 0u : static_cast<std::uint32_t>(EPOLLIN)) | (want_write ? static_cast<std::uint32_t>(EPOLLOUT) : 0u);
+                ev.data.fd = c.fd;
+                ::epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c.fd, &ev);
+                c.want_write = want_write, c.paused = paused;
+            }
+            return true;
         }
 
-        eval_target *make_sub(eval_target *lhs, eval_target *rhs){
-            binary_operator_sub *e = new binary_operator_sub;
-            e->lhs.reset(lhs);
-            e->rhs.reset(rhs);
-            return e;
+        // 書けるだけ書く. 接続を閉じるべきならfalseを返す
+        bool flush(std::uint64_t id){
+            connection &c(connections[id]);
+            std::size_t pos = 0;
+            while(pos < c.out.size()){
+                ssize_t r = ::send(c.fd, c.out.data() + pos, c.out.size() - pos, MSG_NOSIGNAL);
+                if(r < 0){
+                    if(errno == EAGAIN || errno == EWOULDBLOCK){ break; }
+                    if(errno == EINTR){ continue; }
+                    return false;
+                }
+                pos += r;
+            }
+            c.out.erase(0, pos);
+            // 止めている間に読んであったframeがあれば渡す
+            return update(id);
         }
 
-        eval_target *make_mul(eval_target *lhs, eval_target *rhs){
-            binary_operator_mul *e = new binary_operator_mul;
-            e->lhs.reset(lhs);
-            e->rhs.reset(rhs);
-            return e;
+        void close_connection(std::uint64_t id){
+            auto iter = connections.find(id);
+            if(iter == connections.end()){ return; }
+            ::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, iter->second.fd, nullptr);
+            ::close(iter->second.fd);
+            fd_to_id.erase(iter->second.fd);
+            iter->second.token->cancel();
+            job j;
+            j.conn_id = id;
+            j.close_session = true;
+            post(iter->second.worker_idx, std::move(j));
+            connections.erase(iter);
         }
 
-        eval_target *make_div(eval_target *lhs, eval_target *rhs){
-            binary_operator_div *e = new binary_operator_div;
-            e->lhs.reset(lhs);
-            e->rhs.reset(rhs);
-            return e;
+        void deliver_responses(){
+            std::deque<response> rs;
+            {
+                std::lock_guard<std::mutex> lock(response_mutex);
+                rs.swap(responses);
+            }
+            std::set<std::uint64_t> touched;
+            for(auto iter = rs.begin(); iter != rs.end(); ++iter){
+                auto jter = connections.find(iter->conn_id);
+                if(jter == connections.end()){ continue; }
+                jter->second.out += iter->frame;
+                --jter->second.in_flight;
+                touched.insert(iter->conn_id);
+            }
+            for(auto iter = touched.begin(); iter != touched.end(); ++iter){
+                if(!flush(*iter)){ close_connection(*iter); }
+            }
         }
 
-        eval_target *make_pow(eval_target *lhs, eval_target *rhs){
-            binary_operator_pow *e = new binary_operator_pow;
-            e->lhs.reset(lhs);
-            e->rhs.reset(rhs);
-            return e;
+        void post(std::size_t worker_idx, job &&j){
+            worker &w(workers[worker_idx]);
+            {
+                std::lock_guard<std::mutex> lock(w.mutex);
+                w.queue.push_back(std::move(j));
+            }
+            w.cond.notify_one();
         }
 
-        negate_expr *make_negate_expr(eval_target *e){
-            negate_expr *n = new negate_expr;
-            n->operand.reset(e);
-            return n;
+        void stop_workers(){
+            for(auto iter = workers.begin(); iter != workers.end(); ++iter){
+                {
+                    std::lock_guard<std::mutex> lock(iter->mutex);
+                    iter->stop = true;
+                }
+                iter->cond.notify_one();
+            }
+            for(auto iter = workers.begin(); iter != workers.end(); ++iter){
+                if(iter->th.joinable()){ iter->th.join(); }
+            }
         }
 
-        sequence *make_seq(sequence *s, eval_target *e){
-            sequence *ptr = new sequence;
-            ptr->e.reset(e);
-            if(s){
-                ptr->head = s->head;
-                s->next.reset(ptr);
-            }else{ ptr->head = ptr; }
-            return ptr;
+        // workerは自身のparserと, 接続ごとのコンテキストを持つ
+        void worker_loop(worker &w){
+            evaluator ev;
+            output_buffer o;
+            lex_data::token_sequence tokens;
+            std::map<std::uint64_t, std::unique_ptr<context>> contexts;
+            for(; ; ){
+                job j;
+                {
+                    std::unique_lock<std::mutex> lock(w.mutex);
+                    w.cond.wait(lock, [&w]{ return w.stop || !w.queue.empty(); });
+                    if(w.queue.empty()){ return; }
+                    j = std::move(w.queue.front());
+                    w.queue.pop_front();
+                }
+                if(j.close_session){
+                    contexts.erase(j.conn_id);
+                    continue;
+                }
+                if(j.token->cancelled()){ continue; }
+                std::unique_ptr<context> &cx(contexts[j.conn_id]);
+                if(!cx){
+                    cx.reset(new context);
+                    cx->set_time_limit(time_limit);
+                    cx->set_memory_limit(memory_limit);
+                    cx->set_cost_limit(cost_limit);
+                    cx->set_result_cache(cache);
+                    cx->set_disk_cache(disk);
+                    cx->set_template_limit(template_limit);
+                    cx->set_output_format(format);
+                    cx->set_let_tracking(let_tracking);
+                    cx->set_dfa_lexer(dfa_lexer);
+                    if(image){ image->load(*cx); }
+                }
+                cx->set_cancel_token(j.token.get());
+                response r;
+                r.conn_id = j.conn_id;
+                // 長さと状態の5byteを空けて結果を直接書き込む
+                const char *first = j.statement.data(), *last = first + j.statement.size();
+                if(!j.lexed && is_wire_request(first, last)){
+                    // 状態は応答に含まれる
+                    o.clear();
+                    o.write("\0\0\0\0", 4);
+                    eval_wire_request(ev, *cx, first, last, o);
+                    r.frame.assign(o.data(), o.size());
+                    write_u32(&r.frame[0], static_cast<std::uint32_t>(o.size() - 4));
+                }else{
+                    char status = 0;
+                    o.clear();
+                    o.write("\0\0\0\0\0", 5);
+                    try{
+                        if(!j.lexed){
+                            ev.eval(*cx, first, last, o);
+                        }else{
+                            if(j.lexical_error){ throw(error("lexical error.")); }
+                            tokens.clear();
+                            for(auto iter = j.tokens.begin(); iter != j.tokens.end(); ++iter){
+                                tokens.push_back(std::make_pair(iter->kind, std::make_pair(first + iter->first, first + iter->last)));
+                            }
+                            ev.eval(*cx, tokens, o);
+                        }
+                    }catch(std::exception &e){
+                        status = 1;
+                        o.clear();
+                        o.write("\0\0\0\0\0", 5);
+                        evaluator::write_error(*cx, e.what(), o);
+                    }
+                    r.frame.assign(o.data(), o.size());
+                    write_u32(&r.frame[0], static_cast<std::uint32_t>(o.size() - 4));
+                    r.frame[4] = status;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(response_mutex);
+                    responses.push_back(std::move(r));
+                }
+                std::uint64_t one = 1;
+                ssize_t unused = ::write(event_fd, &one, sizeof(one));
+                (void)unused;
+            }
         }
 
-        sequence *make_seq(eval_target *e){
-            sequence *ptr = new sequence;
-            ptr->e.reset(e);
-            ptr->head = ptr;
-            return ptr;
+        static std::uint32_t read_u32(const char *p){
+            const unsigned char *q = reinterpret_cast<const unsigned char*>(p);
+            return
+                static_cast<std::uint32_t>(q[0]) |
+                static_cast<std::uint32_t>(q[1]) << 8 |
+                static_cast<std::uint32_t>(q[2]) << 16 |
+                static_cast<std::uint32_t>(q[3]) << 24;
         }
 
-        sequence *make_lambda(sequence *s, eval_target *e){
-            lambda *l = new lambda;
-            l->args.reset(s);
-            l->e.reset(e);
-            l->head = l;
-            return make_seq(nullptr, l);
+        static void write_u32(char *p, std::uint32_t n){
+            p[0] = static_cast<char>(n & 0xFF);
+            p[1] = static_cast<char>((n >> 8) & 0xFF);
+            p[2] = static_cast<char>((n >> 16) & 0xFF);
+            p[3] = static_cast<char>((n >> 24) & 0xFF);
         }
 
-        template<class T>
-        T *identity(T *subtree){
-            return subtree;
-        }
+        std::string path;
+        const session_image *image;
+        std::chrono::milliseconds time_limit;
+        std::size_t memory_limit;
+        double cost_limit;
+        result_cache *cache;
+        disk_cache *disk;
+        std::size_t template_limit;
+        output_format format;
+        bool let_tracking;
+        bool dfa_lexer;
+        int listen_fd, epoll_fd, event_fd, signal_fd;
+        std::uint64_t next_id;
+        std::map<std::uint64_t, connection> connections;
+        std::map<int, std::uint64_t> fd_to_id;
+        std::vector<worker> workers;
+        std::mutex response_mutex;
+        std::deque<response> responses;
     };
+#endif
 }
 
-#include "parser.hpp"
-
-namespace lex_data{
-    // 字句解析結果のrange
-    typedef std::pair<statement_str::const_iterator, statement_str::const_iterator> token_range;
-
-    // 字句解析結果のtoken種別と範囲
-    typedef std::pair<lexer::token, token_range> lex_result;
-
-    // 字句解析結果
-    typedef std::vector<lex_result> token_sequence;
-}
-
-#include "algebraic.hpp"
-
 int main(
 #ifndef _DEBUG
     int argc, char *argv[]
@@ -660,79 +1139,205 @@ int main(
             "(4 * a)^(-3i)"
         };
 #else
-        if(argc != 2){ return 0; }
-#endif
-        statement_str target_str;
-        lex_data::token_sequence token_sequence;
-        std::size_t n = std::strlen(argv[1]);
-        target_str.resize(n);
-        for(std::size_t i = 0; i < n; ++i){
-            target_str[i] = argv[1][i];
-        }
-
-        auto lex_result = lexer::lexer::tokenize(
-            target_str.begin(),
-            target_str.end(),
-            std::insert_iterator<lex_data::token_sequence>(
-                token_sequence,
-                token_sequence.begin()
-            )
-        );
-        if(!lex_result.first){
-            std::cout << "lexical error.";
+        // scalc --batch [--max-let n] [--jobs n | --pipeline] [--timeout ms] [--memory-limit bytes] [--report-peak]
+        //              [--max-cost work] [--explain-cost] [--cache-size bytes] [--disk-cache file]
+        //              [--ast-cache n] [--output=text|json] [--track-let] [--dfa-lexer] [--load-session file] [--save-session file] [file]
+        // --explain-costは逐次に評価する. --pipelineでは結果のcacheを使わない
+        // cacheを使った場合は終わりに当たり外れの数を標準エラー出力に書き出す
+        if(argc >= 2 && std::strcmp(argv[1], "--batch") == 0){
+            std::size_t max_let_values = 0, jobs = 1, memory_limit = 0, cache_size = 0, template_limit = 0;
+            std::chrono::milliseconds time_limit(0);
+            double cost_limit = 0;
+            bool pipeline = false, report_peak = false, explain = false, let_tracking = false, dfa_lexer = false;
+            scalc::output_format format = scalc::output_text;
+            const char *path = nullptr, *load_path = nullptr, *save_path = nullptr, *disk_path = nullptr;
+            for(int i = 2; i < argc; ++i){
+                if(std::strcmp(argv[i], "--max-let") == 0 && i + 1 < argc){
+                    max_let_values = std::strtoul(argv[++i], nullptr, 10);
+                }else if(std::strcmp(argv[i], "--jobs") == 0 && i + 1 < argc){
+                    jobs = std::strtoul(argv[++i], nullptr, 10);
+                }else if(std::strcmp(argv[i], "--timeout") == 0 && i + 1 < argc){
+                    time_limit = std::chrono::milliseconds(std::strtoul(argv[++i], nullptr, 10));
+                }else if(std::strcmp(argv[i], "--memory-limit") == 0 && i + 1 < argc){
+                    memory_limit = std::strtoul(argv[++i], nullptr, 10);
+                }else if(std::strcmp(argv[i], "--report-peak") == 0){
+                    report_peak = true;
+                }else if(std::strcmp(argv[i], "--max-cost") == 0 && i + 1 < argc){
+                    cost_limit = std::strtod(argv[++i], nullptr);
+                }else if(std::strcmp(argv[i], "--explain-cost") == 0){
+                    explain = true;
+                }else if(std::strcmp(argv[i], "--cache-size") == 0 && i + 1 < argc){
+                    cache_size = std::strtoul(argv[++i], nullptr, 10);
+                }else if(std::strcmp(argv[i], "--disk-cache") == 0 && i + 1 < argc){
+                    disk_path = argv[++i];
+                }else if(std::strcmp(argv[i], "--ast-cache") == 0 && i + 1 < argc){
+                    template_limit = std::strtoul(argv[++i], nullptr, 10);
+                }else if(std::strcmp(argv[i], "--output=json") == 0){
+                    format = scalc::output_json;
+                }else if(std::strcmp(argv[i], "--output=text") == 0){
+                    format = scalc::output_text;
+                }else if(std::strcmp(argv[i], "--track-let") == 0){
+                    let_tracking = true;
+                }else if(std::strcmp(argv[i], "--dfa-lexer") == 0){
+                    dfa_lexer = true;
+                }else if(std::strcmp(argv[i], "--pipeline") == 0){
+                    pipeline = true;
+                }else if(std::strcmp(argv[i], "--load-session") == 0 && i + 1 < argc){
+                    load_path = argv[++i];
+                }else if(std::strcmp(argv[i], "--save-session") == 0 && i + 1 < argc){
+                    save_path = argv[++i];
+                }else{
+                    path = argv[i];
+                }
+            }
+            std::FILE *fp = stdin;
+            if(path){
+                fp = std::fopen(path, "rb");
+                if(!fp){
+                    std::cout << "cannot open " << path << "." << std::endl;
+                    return 1;
+                }
+            }
+            std::unique_ptr<std::FILE, int(*)(std::FILE*)> fp_guard(path ? fp : nullptr, std::fclose);
+            scalc::line_source in(fp);
+            output_buffer o(1, 1 << 20);
+            std::unique_ptr<scalc::result_cache> cache(cache_size > 0 ? new scalc::result_cache(cache_size) : nullptr);
+            std::unique_ptr<scalc::disk_cache> disk(disk_path ? new scalc::disk_cache(disk_path) : nullptr);
+            if(jobs > 1 && !explain){
+                scalc::parallel_batch pb(jobs, max_let_values, report_peak);
+                pb.set_time_limit(time_limit);
+                pb.set_memory_limit(memory_limit);
+                pb.set_cost_limit(cost_limit);
+                pb.set_result_cache(cache.get());
+                pb.set_disk_cache(disk.get());
+                pb.set_template_limit(template_limit);
+                pb.set_output_format(format);
+                pb.set_let_tracking(let_tracking);
+                pb.set_dfa_lexer(dfa_lexer);
+                if(load_path){ pb.load(scalc::session_image(load_path)); }
+                pb.run(in, o);
+                if(save_path){ scalc::save_session(pb.primary(), save_path); }
+            }else{
+                scalc::context cx(max_let_values);
+                cx.set_time_limit(time_limit);
+                cx.set_memory_limit(memory_limit);
+                cx.set_cost_limit(cost_limit);
+                cx.set_result_cache(cache.get());
+                cx.set_disk_cache(disk.get());
+                cx.set_template_limit(template_limit);
+                cx.set_output_format(format);
+                cx.set_let_tracking(let_tracking);
+                cx.set_dfa_lexer(dfa_lexer);
+                if(load_path){ scalc::load_session(cx, load_path); }
+                if(pipeline && !explain){
+                    scalc::pipeline_batch pb(cx, report_peak);
+                    pb.run(in, o);
+                }else{
+                    scalc::run_batch(in, o, cx, report_peak, explain);
+                }
+                if(save_path){ scalc::save_session(cx, save_path); }
+            }
+            if(cache){ write_cache_stats(*cache); }
+            if(disk){ write_cache_stats(*disk); }
             return 0;
         }
-
-        using namespace analyzer;
-
-        semantic_action sa;
-        eval_target *target_ptr;
-        parser::parser<eval_target*, semantic_action> p(sa);
-        for(auto iter = token_sequence.begin(); iter != token_sequence.end(); ++iter){
-            parser::token t = static_cast<parser::token>(iter->first);
-            switch(t){
-            case parser::token_identifier:
-                {
-                    value *v = new value;
-                    std::stringstream ss;
-                    std::string str(iter->second.first, iter->second.second);
-                    ss << std::string(str);
-                    ss >> v->v;
-                    v->real = str.back() != 'i';
-                    target_ptr = v;
+        // scalc --eval-table statement (--csv file | --raw file --columns a,b,...) [--raw-output] [--load-session file]
+        // 文を1度だけ数値の命令列に翻訳し, 表の各行で評価した結果を1行に1つずつ書き出す
+        // --rawは列ごとに並べたlittle endianのf64, --raw-outputは結果を同じ形で書き出す
+        if(argc >= 3 && std::strcmp(argv[1], "--eval-table") == 0){
+            const char *csv_path = nullptr, *raw_path = nullptr, *load_path = nullptr;
+            std::vector<std::string> columns;
+            bool raw_output = false;
+            for(int i = 3; i < argc; ++i){
+                if(std::strcmp(argv[i], "--raw-output") == 0){
+                    raw_output = true;
+                    continue;
                 }
-                break;
-
-            case parser::token_symbol:
-                {
-                    symbol *s = new symbol;
-                    s->s = std::string(iter->second.first, iter->second.second);
-                    target_ptr = s;
+                if(i + 1 >= argc){ break; }
+                if(std::strcmp(argv[i], "--csv") == 0){
+                    csv_path = argv[++i];
+                }else if(std::strcmp(argv[i], "--raw") == 0){
+                    raw_path = argv[++i];
+                }else if(std::strcmp(argv[i], "--columns") == 0){
+                    std::stringstream ss(argv[++i]);
+                    for(std::string name; std::getline(ss, name, ','); ){ columns.push_back(name); }
+                }else if(std::strcmp(argv[i], "--load-session") == 0){
+                    load_path = argv[++i];
                 }
-                break;
-
-            default:
-                target_ptr = nullptr;
             }
-            if(p.post(t, target_ptr)){ break; }
-        }
-        if(p.error()){
+            std::unique_ptr<scalc::table_source> table;
+            if(csv_path){
+                table.reset(new scalc::csv_table(csv_path));
+            }else if(raw_path){
+                table.reset(new scalc::raw_table(raw_path, columns));
+            }else{
+                std::cout << "no table." << std::endl;
+                return 1;
+            }
+            scalc::context cx;
+            if(load_path){ scalc::load_session(cx, load_path); }
+            output_buffer o(1, 1 << 20);
+            scalc::eval_table(cx, argv[2], argv[2] + std::strlen(argv[2]), *table, o, raw_output);
             return 0;
-        }else{
-            p.post(parser::token_0, target_ptr);
         }
-
-        eval_target *root_ = nullptr;
-        if(!p.accept(root_)){
-            std::cout << "parsing error.";
+#if defined(__linux__)
+        // scalc --serve path [--workers n] [--timeout ms] [--memory-limit bytes] [--max-cost work] [--cache-size bytes]
+        //              [--disk-cache file] [--ast-cache n] [--output=text|json] [--track-let] [--dfa-lexer] [--load-session file]
+        if(argc >= 3 && std::strcmp(argv[1], "--serve") == 0){
+            std::size_t worker_num = std::thread::hardware_concurrency(), memory_limit = 0;
+            std::chrono::milliseconds time_limit(0);
+            double cost_limit = 0;
+            std::size_t cache_size = 0, template_limit = 0;
+            scalc::output_format format = scalc::output_text;
+            bool let_tracking = false, dfa_lexer = false;
+            std::unique_ptr<scalc::session_image> image;
+            std::unique_ptr<scalc::disk_cache> disk;
+            for(int i = 3; i < argc; ++i){
+                if(std::strcmp(argv[i], "--output=json") == 0){
+                    format = scalc::output_json;
+                    continue;
+                }else if(std::strcmp(argv[i], "--output=text") == 0){
+                    format = scalc::output_text;
+                    continue;
+                }else if(std::strcmp(argv[i], "--track-let") == 0){
+                    let_tracking = true;
+                    continue;
+                }else if(std::strcmp(argv[i], "--dfa-lexer") == 0){
+                    dfa_lexer = true;
+                    continue;
+                }
+                if(i + 1 >= argc){ break; }
+                if(std::strcmp(argv[i], "--workers") == 0){
+                    worker_num = std::strtoul(argv[++i], nullptr, 10);
+                }else if(std::strcmp(argv[i], "--timeout") == 0){
+                    time_limit = std::chrono::milliseconds(std::strtoul(argv[++i], nullptr, 10));
+                }else if(std::strcmp(argv[i], "--memory-limit") == 0){
+                    memory_limit = std::strtoul(argv[++i], nullptr, 10);
+                }else if(std::strcmp(argv[i], "--max-cost") == 0){
+                    cost_limit = std::strtod(argv[++i], nullptr);
+                }else if(std::strcmp(argv[i], "--cache-size") == 0){
+                    cache_size = std::strtoul(argv[++i], nullptr, 10);
+                }else if(std::strcmp(argv[i], "--disk-cache") == 0){
+                    disk.reset(new scalc::disk_cache(argv[++i]));
+                }else if(std::strcmp(argv[i], "--ast-cache") == 0){
+                    template_limit = std::strtoul(argv[++i], nullptr, 10);
+                }else if(std::strcmp(argv[i], "--load-session") == 0){
+                    image.reset(new scalc::session_image(argv[++i]));
+                }
+            }
+            std::unique_ptr<scalc::result_cache> cache(cache_size > 0 ? new scalc::result_cache(cache_size) : nullptr);
+            scalc::server srv(argv[2], worker_num, image.get(), time_limit, memory_limit, cost_limit, cache.get(), disk.get(), template_limit, format, let_tracking, dfa_lexer);
+            srv.run();
+            if(cache){ write_cache_stats(*cache); }
+            if(disk){ write_cache_stats(*disk); }
             return 0;
         }
-        std::unique_ptr<eval_target> root(root_);
-        semantic_data sd;
-        root->eval(sd);
-        poly::node *q = sd.pop_stack().node;
-        std::cout << poly::poly_to_string(q) << std::endl;
-        poly::dispose(q);
+#endif
+        if(argc != 2){ return 0; }
+#endif
+        scalc::context cx;
+        scalc::evaluator ev;
+        std::cout << ev.eval(cx, argv[1], argv[1] + std::strlen(argv[1])) << std::endl;
     }catch(std::runtime_error &e){
         std::cout << e.what() << std::endl;
     }
@@ -0,0 +1,158 @@
+﻿#ifndef SCALC_OUTPUT_HPP
+#define SCALC_OUTPUT_HPP
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#if defined(__unix__)
+#include <unistd.h>
+#include <errno.h>
+#include <sys/uio.h>
+#endif
+
+// 出力バッファ
+// 再利用する領域に直接書き込み, 領域が埋まった時とflushを呼んだ時にだけfdへ書き出す
+// fdが負であればメモリ上に溜めるだけで, 内容はdata(), size()で得る
+class output_buffer{
+public:
+    explicit output_buffer(int fd_ = -1, std::size_t capacity = 1 << 16) : fd(fd_), buffer(), pos(0){
+        buffer.resize(capacity > 0 ? capacity : 1);
+    }
+
+    ~output_buffer(){
+        flush();
+    }
+
+    void put(char c){
+        if(pos == buffer.size()){ overflow(1); }
+        buffer[pos++] = c;
+    }
+
+    void write(const char *p, std::size_t n){
+        if(buffer.size() - pos < n){
+            if(fd >= 0 && n >= buffer.size() / 2){
+                // 大きな塊はバッファの中身と合わせて1度に書き出す
+                write_through(p, n);
+                return;
+            }
+            overflow(n);
+        }
+        std::memcpy(&buffer[pos], p, n);
+        pos += n;
+    }
+
+    void write(const std::string &str){
+        write(str.data(), str.size());
+    }
+
+    void write(const char *str){
+        write(str, std::strlen(str));
+    }
+
+    // 数値をstd::ostreamの既定の書式と同じく書き出す
+    void put_number(double v){
+        char buf[32];
+        int n = std::snprintf(buf, sizeof(buf), "%g", v);
+        write(buf, static_cast<std::size_t>(n));
+    }
+
+    // 有限の数値を読み戻せる精度で書き出す
+    // 2^53未満の整数は桁を直接書き, それ以外は%.17gで書く
+    void put_exact_number(double v){
+        char buf[32];
+        if((v < 0 ? -v : v) < 9007199254740992.0 && v == static_cast<double>(static_cast<long long>(v))){
+            char *q = buf + sizeof(buf);
+            bool neg = v < 0;
+            unsigned long long n = static_cast<unsigned long long>(neg ? -v : v);
+            do{
+                *--q = static_cast<char>('0' + n % 10);
+                n /= 10;
+            }while(n > 0);
+            if(neg){ *--q = '-'; }
+            write(q, static_cast<std::size_t>(buf + sizeof(buf) - q));
+            return;
+        }
+        int n = std::snprintf(buf, sizeof(buf), "%.17g", v);
+        write(buf, static_cast<std::size_t>(n));
+    }
+
+    // 溜まっている内容を書き出す. メモリ上に溜める場合は何もしない
+    void flush(){
+        if(fd < 0 || pos == 0){ return; }
+        write_all(buffer.data(), pos, nullptr, 0);
+        pos = 0;
+    }
+
+    const char *data() const{
+        return buffer.data();
+    }
+
+    std::size_t size() const{
+        return pos;
+    }
+
+    // メモリ上に溜めた内容を捨てる
+    void clear(){
+        pos = 0;
+    }
+
+    std::string str() const{
+        return std::string(buffer.data(), pos);
+    }
+
+private:
+    output_buffer(const output_buffer&);
+    output_buffer &operator =(const output_buffer&);
+
+    // n byteの空きを作る
+    void overflow(std::size_t n){
+        if(fd >= 0){
+            flush();
+            if(buffer.size() >= n){ return; }
+        }
+        std::size_t m = buffer.size() * 2;
+        while(m - pos < n){ m *= 2; }
+        buffer.resize(m);
+    }
+
+    void write_through(const char *p, std::size_t n){
+        write_all(buffer.data(), pos, p, n);
+        pos = 0;
+    }
+
+    // 2つの領域を順に書き出す
+    void write_all(const char *p, std::size_t n, const char *q, std::size_t m){
+#if defined(__unix__)
+        while(n + m > 0){
+            iovec iov[2];
+            int c = 0;
+            if(n > 0){ iov[c].iov_base = const_cast<char*>(p), iov[c].iov_len = n, ++c; }
+            if(m > 0){ iov[c].iov_base = const_cast<char*>(q), iov[c].iov_len = m, ++c; }
+            ssize_t r = ::writev(fd, iov, c);
+            if(r < 0){
+                if(errno == EINTR){ continue; }
+                return;
+            }
+            std::size_t w = static_cast<std::size_t>(r);
+            if(w >= n){
+                w -= n, n = 0;
+                q += w, m -= w;
+            }else{
+                p += w, n -= w;
+            }
+        }
+#else
+        std::FILE *fp = fd == 2 ? stderr : stdout;
+        std::fwrite(p, 1, n, fp);
+        if(m > 0){ std::fwrite(q, 1, m, fp); }
+        std::fflush(fp);
+#endif
+    }
+
+    int fd;
+    std::vector<char> buffer;
+    std::size_t pos;
+};
+
+#endif // SCALC_OUTPUT_HPP
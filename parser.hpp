@@ -26,6 +26,7 @@ enum token{
     token_symbol = lexer::token_symbol,
     token_keyword_where = lexer::token_keyword_where,
     token_keyword_let = lexer::token_keyword_let,
+    token_keyword_unlet = lexer::token_keyword_unlet,
     token_0 = -1
 };
 
@@ -342,6 +343,16 @@ private:
         return (this->*(stack_top()->gotof))(nonterminal_index, v);
     }
 
+    bool call_0_undefine_symbol(int nonterminal_index, int base, int arg_index0)
+    {
+        analyzer::symbol* arg0; sa_.downcast(arg0, get_arg(base, arg_index0));
+        analyzer::eval_target* r = sa_.undefine_symbol(arg0);
+        value_type v = value_type();
+        sa_.upcast(v, r);
+        pop_stack(base);
+        return (this->*(stack_top()->gotof))(nonterminal_index, v);
+    }
+
     bool call_2_identity(int nonterminal_index, int base, int arg_index0)
     {
         analyzer::value* arg0; sa_.downcast(arg0, get_arg(base, arg_index0));
@@ -409,6 +420,10 @@ private:
             // shift
             push_stack(&parser::state_33, &parser::gotof_33, value);
             return false;
+        case token_keyword_unlet:
+            // shift
+            push_stack(&parser::state_37, &parser::gotof_37, value);
+            return false;
         default:
             sa_.syntax_error();
             error_ = true;
@@ -1558,6 +1573,44 @@ private:
         }
     }
 
+    bool gotof_37(int nonterminal_index, const value_type& v)
+    {
+        assert(0);
+        return true;
+    }
+
+    bool state_37(token_type token, const value_type& value)
+    {
+        switch(token){
+        case token_symbol:
+            // shift
+            push_stack(&parser::state_38, &parser::gotof_38, value);
+            return false;
+        default:
+            sa_.syntax_error();
+            error_ = true;
+            return false;
+        }
+    }
+
+    bool gotof_38(int nonterminal_index, const value_type& v)
+    {
+        assert(0);
+        return true;
+    }
+
+    bool state_38(token_type token, const value_type& value)
+    {
+        switch(token){
+        case token_0:
+            return call_0_undefine_symbol(0, 2, 1);
+        default:
+            sa_.syntax_error();
+            error_ = true;
+            return false;
+        }
+    }
+
 };
 
 } // namespace parser
@@ -8,14 +8,12 @@
 #include <cctype>
 #include <cmath>
 #include "common.hpp"
+#include "context.hpp"
 
 namespace poly{
 node::node() : e(), real(0), imag(0), next(nullptr){}
-node::~node(){
-    for(auto iter = e.begin(); iter != e.end(); ++iter){
-        dispose(iter->second);
-    }
-}
+
+node::node(scalc::memory_meter *meter) : e(str_wrapper_less(), scalc::exponent_allocator<std::pair<const str_wrapper, node*>>(meter)), real(0), imag(0), next(nullptr){}
 
 void node::negate(){
     real = -real, imag = -imag;
@@ -126,30 +124,51 @@ int lexicographic_compare(const node *l, const node *r){
     return result;
 }
 
+// 加算, 乗算が項を並べる順で, lの項がrの項より前に来れば正, 後に来れば負, 指数部が等しければ0
+// 記号の小さいもの, 同じ記号では指数の大きいもの, 記号の多いものが前に来る
+int term_compare(const node *l, const node *r){
+    auto l_iter = l->e.begin(), r_iter = r->e.begin();
+    for(; ; ++l_iter, ++r_iter){
+        bool l_phi = l_iter == l->e.end(), r_phi = r_iter == r->e.end();
+        if(l_phi || r_phi){ return l_phi && r_phi ? 0 : l_phi ? -1 : 1; }
+        if(l_iter->first == r_iter->first){
+            int result = lexicographic_compare(l_iter->second, r_iter->second);
+            if(result != 0){ return result; }
+        }else{
+            return primitive_lexicographic_compare(l_iter->first, r_iter->first) ? 1 : -1;
+        }
+    }
+}
+
 // 項を生成
-node *new_node(){
-    return new node;
+node *new_node(scalc::context &cx){
+    return cx.nodes.allocate();
 }
 
 // 項を破棄
-void dispose_node(node *p){
-    delete p;
+void dispose_node(scalc::context &cx, node *p){
+    if(!p){ return; }
+    for(auto iter = p->e.begin(); iter != p->e.end(); ++iter){
+        dispose(cx, iter->second);
+    }
+    p->e.clear();
+    cx.nodes.deallocate(p);
 }
 
 // 多項式を破棄
-void dispose(node *p){
+void dispose(scalc::context &cx, node *p){
     while(p){
         node *q = p->next;
-        dispose_node(p);
+        dispose_node(cx, p);
         p = q;
     }
 }
 
 // 定数を生成
-node *constant(fpoint re, fpoint im){
-    node *p = new_node();
+node *constant(scalc::context &cx, fpoint re, fpoint im){
+    node *p = new_node(cx);
     if(re != 0 || im != 0){
-        node *q = new_node();
+        node *q = new_node(cx);
         q->real = re;
         q->imag = im;
         p->next = q;
@@ -158,52 +177,52 @@ node *constant(fpoint re, fpoint im){
 }
 
 // 変数を生成
-node *variable(const std::string &str){
-    node *p = constant(1, 0);
-    p->next->e[str] = constant(1, 0);
+node *variable(scalc::context &cx, const str_wrapper &str){
+    node *p = constant(cx, 1, 0);
+    p->next->e[str] = constant(cx, 1, 0);
     return p;
 }
 
 // 変数のべき乗を生成
-node *variable(const std::string &str, fpoint re, fpoint im){
-    node *p = constant(1, 0);
-    p->next->e[str] = constant(re, im);
+node *variable(scalc::context &cx, const str_wrapper &str, fpoint re, fpoint im){
+    node *p = constant(cx, 1, 0);
+    p->next->e[str] = constant(cx, re, im);
     return p;
 }
 
 // 変数の任意のべき乗を生成
 // ptrは破棄
-node *variable(const std::string &str, node *ptr){
-    node *p = constant(1, 0);
+node *variable(scalc::context &cx, const str_wrapper &str, node *ptr){
+    node *p = constant(cx, 1, 0);
     p->next->e[str] = ptr;
     return p;
 }
 
 // 先頭の1項だけ多項式としてコピー
-node *copy_node(const node *p){
-    node *q = new_node(), *r;
+node *copy_node(scalc::context &cx, const node *p){
+    node *q = new_node(cx), *r;
     r = q;
-    q->next = new_node();
+    q->next = new_node(cx);
     p = p->next;
     q = q->next;
     q->real = p->real;
     q->imag = p->imag;
     for(auto iter = p->e.begin(); iter != p->e.end(); ++iter){
-        q->e.insert(std::make_pair(iter->first, copy(iter->second)));
+        q->e.insert(std::make_pair(iter->first, copy(cx, iter->second)));
     }
     return r; 
 }
 
 // 多項式をコピー
-node *copy(const node *p){
+node *copy(scalc::context &cx, const node *p){
     node *q, *r;
-    q = r = new_node();
+    q = r = new_node(cx);
     while(p = p->next){
-        r = r->next = new_node();
+        r = r->next = new_node(cx);
         r->real = p->real;
         r->imag = p->imag;
         for(auto iter = p->e.begin(); iter != p->e.end(); ++iter){
-            r->e.insert(std::make_pair(iter->first, copy(iter->second)));
+            r->e.insert(std::make_pair(iter->first, copy(cx, iter->second)));
         }
     }
     return q;
@@ -225,49 +244,24 @@ void complex_conjugate(node *p){
 
 // 加算
 // qは破棄
-void add(node *p, node *q){
-    node *p1 = p, *q1 = q;
-    node *ep = nullptr, *eq = nullptr;
+// 打ち切られた場合はpに途中までの和を残し, qの残りを破棄する
+void add(scalc::context &cx, node *p, node *q){
+    node *head = p, *p1 = p, *q1 = q;
     p = p->next;
     q = q->next;
-    dispose_node(q1);
+    dispose_node(cx, q1);
     while(q){
-        while(p){
-            int compare_result;
-            auto l_iter = p->e.begin(), r_iter = q->e.begin();
-            bool l_phi, r_phi;
-            for(; ; ++l_iter, ++r_iter){
-                l_phi = l_iter == p->e.end();
-                r_phi = r_iter == q->e.end();
-                if(l_phi || r_phi){
-                    compare_result = l_phi && r_phi ? 0 : l_phi ? -1 : 1;
-                    if(!l_phi){ ep = l_iter->second; }
-                    if(!r_phi){ eq = r_iter->second; }
-                    break;
-                }
-                if(l_iter->first == r_iter->first){
-                    compare_result = lexicographic_compare(l_iter->second, r_iter->second);
-                    if(compare_result != 0){
-                        ep = l_iter->second;
-                        eq = r_iter->second;
-                        break;
-                    }
-                }else{
-                    compare_result = primitive_lexicographic_compare(l_iter->first, r_iter->first);
-                    if(compare_result < 0){
-                        ep = nullptr;
-                        eq = r_iter->second;
-                    }else{
-                        ep = l_iter->second;
-                        eq = nullptr;
-                    }
-                    break;
-                }
-            }
-            if(compare_result <= 0){ break; }
-            p1 = p, p = p->next;
+        try{
+            cx.check_interrupt();
+        }catch(...){
+            dispose(cx, q);
+            throw;
         }
-        if(!p || lexicographic_compare(ep, eq) < 0){
+        // qの項が前の項より前に来るなら先頭から探し直す
+        if(p1 != head && term_compare(p1, q) <= 0){ p1 = head, p = head->next; }
+        int compare_result = 1;
+        while(p && (compare_result = term_compare(p, q)) > 0){ p1 = p, p = p->next; }
+        if(!p || compare_result < 0){
             p1->next = q, p1 = q, q = q->next;
             p1->next = p;
         }else{
@@ -278,106 +272,84 @@ void add(node *p, node *q){
                 p = p->next;
             }else{
                 p = p->next;
-                dispose_node(p1->next);
+                dispose_node(cx, p1->next);
                 p1->next = p;
             }
-            q1 = q, q = q->next, dispose_node(q1);
+            q1 = q, q = q->next, dispose_node(cx, q1);
         }
     }
 }
 
 // 減算
 // qは破棄
-void sub(node *p, node *q){
+void sub(scalc::context &cx, node *p, node *q){
     change_sign(q);
-    add(p, q);
+    add(cx, p, q);
 }
 
 // 乗算
 // 新たな多項式を返す
-node *multiply(const node *x, const node *y){
-    node *ep = nullptr, *eq = nullptr;
+// 打ち切られた場合は途中までの積を破棄する
+node *multiply(scalc::context &cx, const node *x, const node *y){
     const node *z;
     node *p, *p1, *q, *r;
-    r = new_node(), q = nullptr;
-    while(y = y->next){
-        p1 = r, p = p1->next, z = x;
-        while(z = z->next){
-            dispose_node(q);
-            q = new_node();
-            q->real = y->real * z->real - y->imag * z->imag;
-            q->imag = y->real * z->imag + y->imag * z->real;
-            auto add_exponent = [q](const node *ptr){
-                for(auto iter = ptr->e.begin(); iter != ptr->e.end(); ++iter){
-                    auto jter = q->e.find(iter->first);
-                    if(jter == q->e.end()){
-                        q->e.insert(std::make_pair(iter->first, copy(iter->second)));
-                    }else{
-                        add(jter->second, copy(iter->second));
-                        if(!jter->second->next){ q->e.erase(jter); }
-                    }
-                }
-            };
-            add_exponent(y);
-            add_exponent(z);
-            int compare_result;
-            while(p){
-                for(auto l_iter = p->e.begin(), r_iter = q->e.begin(); ; ++l_iter, ++r_iter){
-                    bool l_phi = l_iter == p->e.end(), r_phi = r_iter == q->e.end();
-                    if(l_phi || r_phi){
-                        compare_result = l_phi && r_phi ? 0 : l_phi ? -1 : 1;
-                        if(!l_phi){ ep = l_iter->second; }else{ ep = nullptr; }
-                        if(!r_phi){ eq = r_iter->second; }else{ eq = nullptr; }
-                        break;
-                    }
-                    if(l_iter->first == r_iter->first){
-                        compare_result = lexicographic_compare(l_iter->second, r_iter->second);
-                        if(compare_result != 0){
-                            ep = l_iter->second;
-                            eq = r_iter->second;
-                            break;
-                        }else{
-                            ep = nullptr;
-                            eq = nullptr;
-                        }
-                    }else{
-                        compare_result = primitive_lexicographic_compare(l_iter->first, r_iter->first);
-                        if(compare_result < 0){
-                            ep = nullptr;
-                            eq = r_iter->second;
+    r = new_node(cx), q = nullptr;
+    try{
+        while(y = y->next){
+            p1 = r, p = p1->next, z = x;
+            while(z = z->next){
+                cx.check_interrupt();
+                dispose_node(cx, q);
+                q = new_node(cx);
+                q->real = y->real * z->real - y->imag * z->imag;
+                q->imag = y->real * z->imag + y->imag * z->real;
+                auto add_exponent = [q, &cx](const node *ptr){
+                    for(auto iter = ptr->e.begin(); iter != ptr->e.end(); ++iter){
+                        auto jter = q->e.find(iter->first);
+                        if(jter == q->e.end()){
+                            q->e.insert(std::make_pair(iter->first, copy(cx, iter->second)));
                         }else{
-                            ep = l_iter->second;
-                            eq = nullptr;
+                            add(cx, jter->second, copy(cx, iter->second));
+                            if(!jter->second->next){
+                                dispose(cx, jter->second);
+                                q->e.erase(jter);
+                            }
                         }
-                        break;
                     }
-                }
-                if(compare_result <= 0){ break; }
-                p1 = p, p = p->next;
-            }
-            if(!p || compare_result < 0){
-                p1->next = q, p1 = q, p1->next = p;
-                q = nullptr;
-            }else{
-                p->real += q->real;
-                p->imag += q->imag;
-                if(p->real != 0 || p->imag != 0){
-                    p1 = p, p = p->next;
+                };
+                add_exponent(y);
+                add_exponent(z);
+                if(p1 != r && term_compare(p1, q) <= 0){ p1 = r, p = r->next; }
+                int compare_result = 1;
+                while(p && (compare_result = term_compare(p, q)) > 0){ p1 = p, p = p->next; }
+                if(!p || compare_result < 0){
+                    p1->next = q, p1 = q, p1->next = p;
+                    q = nullptr;
                 }else{
-                    p = p->next;
-                    dispose_node(p1->next);
-                    p1->next = p;
+                    p->real += q->real;
+                    p->imag += q->imag;
+                    if(p->real != 0 || p->imag != 0){
+                        p1 = p, p = p->next;
+                    }else{
+                        p = p->next;
+                        dispose_node(cx, p1->next);
+                        p1->next = p;
+                    }
                 }
             }
         }
+    }catch(...){
+        dispose_node(cx, q);
+        dispose(cx, r);
+        throw;
     }
-    if(q){ dispose_node(q); }
+    if(q){ dispose_node(cx, q); }
     return r;
 }
 
 // 除算
 // 新たな多項式を返す
-node *divide(const node *f_, const node *g, node *rem){
+node *divide(scalc::context &cx, const node *f_, const node *g, node *rem){
     auto check_exponent = [](const node *z, const node *y) -> bool{
         for(auto iter = y->e.begin(); iter != y->e.end(); ++iter){
             if(z->e.find(iter->first) == z->e.end()){
@@ -405,16 +377,16 @@ node *divide(const node *f_, const node *g, node *rem){
         }
     };
 
-    auto exponent_divide = [](node *q, const node *z, const node *y) -> void{
+    auto exponent_divide = [&cx](node *q, const node *z, const node *y) -> void{
         for(auto iter = z->e.begin(); iter != z->e.end(); ++iter){
             auto jter = y->e.find(iter->first);
-            node *exponent = copy(iter->second);
+            node *exponent = copy(cx, iter->second);
             if(jter != y->e.end()){
-                sub(exponent, copy(jter->second));
+                sub(cx, exponent, copy(cx, jter->second));
                 if(exponent->next){
                     q->e.insert(std::make_pair(iter->first, exponent));
                 }else{
-                    dispose(exponent);
+                    dispose(cx, exponent);
                 }
             }else{
                 q->e.insert(std::make_pair(iter->first, exponent));
@@ -422,52 +394,65 @@ node *divide(const node *f_, const node *g, node *rem){
         }
     };
 
-    node *q = new_node();
+    if(!g->next){ throw(error("division by zero.")); }
+    node *q = new_node(cx);
     if(!f_->next){ return q; }
-    node *f = copy(f_);
-    while(f->next){
-        if(!check_exponent(f->next, g->next)){
-            node *head = f->next;
-            f->next = f->next->next;
-            if(rem){
-                node *dummy_head = new_node();
-                dummy_head->next = head;
-                head->next = nullptr;
-                add(rem, dummy_head);
-            }else{ dispose_node(head); }
-            continue;
-        }
-        node *p = new_node();
-        p->next = new_node();
-        primitive_divide(p->next, f->next, g->next);
-        exponent_divide(p->next, f->next, g->next);
-        add(q, copy(p));
-        node *head = f->next ? copy_node(f) : nullptr;
-        sub(f, multiply(g, p));
-        dispose(p);
-        if(!head || !f->next){ dispose_node(head); }else{
-            node *new_head = copy_node(f);
-            head->real = 0, head->imag = 0;
-            new_head->real = 0, new_head->imag = 0;
-            if(lexicographic_compare(head, new_head) == 0){
-                node *f_head = f->next;
+    node *f = copy(cx, f_), *p = nullptr, *head = nullptr;
+    try{
+        while(f->next){
+            cx.check_interrupt();
+            if(!check_exponent(f->next, g->next)){
+                node *head = f->next;
                 f->next = f->next->next;
-                dispose_node(f_head);
+                if(rem){
+                    node *dummy_head = new_node(cx);
+                    dummy_head->next = head;
+                    head->next = nullptr;
+                    add(cx, rem, dummy_head);
+                }else{ dispose_node(cx, head); }
+                continue;
+            }
+            p = new_node(cx);
+            p->next = new_node(cx);
+            primitive_divide(p->next, f->next, g->next);
+            exponent_divide(p->next, f->next, g->next);
+            add(cx, q, copy(cx, p));
+            head = f->next ? copy_node(cx, f) : nullptr;
+            sub(cx, f, multiply(cx, g, p));
+            dispose(cx, p), p = nullptr;
+            if(!head || !f->next){ dispose(cx, head); }else{
+                node *new_head = copy_node(cx, f);
+                head->real = 0, head->imag = 0;
+                new_head->real = 0, new_head->imag = 0;
+                if(lexicographic_compare(head, new_head) == 0){
+                    node *f_head = f->next;
+                    f->next = f->next->next;
+                    dispose_node(cx, f_head);
+                }
+                dispose(cx, head), dispose(cx, new_head);
             }
-            dispose(head), dispose(new_head);
+            head = nullptr;
         }
+    }catch(...){
+        dispose(cx, head);
+        dispose(cx, p);
+        dispose(cx, f);
+        dispose(cx, q);
+        throw;
     }
-    dispose(f);
+    dispose(cx, f);
     return q;
 }
 
 // x^n
-node *power(node *x, node *y){
+node *power(scalc::context &cx, node *x, node *y){
     // symbol     = 0
     // constant   = 1
     // expression = 2
+    // 項の無い0は定数とする
     auto kind = [](const node *p) -> int{
         p = p->next;
+        if(!p){ return 1; }
         if(!p->next){
             if(p->real != 0 || p->imag != 0){
                 if(!p->e.empty()){
@@ -480,7 +465,7 @@ node *power(node *x, node *y){
         return 2;
     };
 
-    std::function<node*(node*, node*)> common_b = [](node *p, node *q) -> node*{
+    std::function<node*(node*, node*)> common_b = [&cx](node *p, node *q) -> node*{
         auto c_mul = [](fpoint x_re, fpoint x_im, fpoint y_re, fpoint y_im) -> std::pair<fpoint, fpoint>{
             std::pair<fpoint, fpoint> z;
             z.first = x_re * y_re - x_im * y_im;
@@ -507,18 +492,23 @@ node *power(node *x, node *y){
         auto mul_result = c_mul(q->real, q->imag, log_result.first, log_result.second);
         auto exp_result = c_exp(mul_result.first, mul_result.second);
 
-        return constant(exp_result.first, exp_result.second);
+        return constant(cx, exp_result.first, exp_result.second);
     };
 
-    std::function<node*(node*, node*)> common_a = [common_b](node *p, node *q) -> node*{
-        node *r = constant(1), *s = r;
+    std::function<node*(node*, node*)> common_a = [common_b, &cx](node *p, node *q) -> node*{
+        node *r = constant(cx, 1), *s = r;
         node *t = common_b(p, q);
         s->next->real = t->next->real, s->next->imag = t->next->imag;
-        dispose(t);
+        dispose(cx, t);
         p = p->next;
         r = r->next;
-        for(auto iter = p->e.begin(); iter != p->e.end(); ++iter){
-            r->e.insert(std::make_pair(iter->first, multiply(iter->second, q)));
+        try{
+            for(auto iter = p->e.begin(); iter != p->e.end(); ++iter){
+                r->e.insert(std::make_pair(iter->first, multiply(cx, iter->second, q)));
+            }
+        }catch(...){
+            dispose(cx, s);
+            throw;
         }
         return s;
     };
@@ -555,7 +545,7 @@ node *power(node *x, node *y){
                 return nullptr;
             },
 
-            [](node *x_, node *n_) -> node*{
+            [&cx](node *x_, node *n_) -> node*{
                 node *a = n_;
                 a = a->next;
                 if(a->real < 0){ throw(error("reject, polynomial^negative.")); }
@@ -563,28 +553,36 @@ node *power(node *x, node *y){
                 fpoint integer = 0, frac = std::modf(a->real, &integer);
                 if(frac != 0){ throw(error("reject, polynomial^" + to_string(frac))); }
                 unsigned int n = static_cast<unsigned int>(integer);
-                node *x = copy(x_), *p, *q;
+                node *x = copy(cx, x_), *p = nullptr, *q;
                 if(n == 1){ return x; }
-                if(n == 0){ p = constant(1); }else{
-                    auto odd = [](unsigned int n) -> bool{ return (n & 1) == 1; };
-                    p = multiply(x, x);  n -= 2;
-                    if (n > 0) {
-                        q = p;
-                        if (odd(n)) p = multiply(q, x);
-                        else        p = copy(q);
-                        dispose(x);  x = q;  n /= 2;
-                        if (odd(n)) {
-                            q = multiply(p, x);  dispose(p);  p = q;
-                        }
-                        while ((n /= 2) != 0) {
-                            q = multiply(x, x);  dispose(x);  x = q;
+                // 打ち切られた場合はx, pを破棄する. 途中でx, pが同じ多項式を指すことはない
+                try{
+                    if(n == 0){ p = constant(cx, 1); }else{
+                        auto odd = [](unsigned int n) -> bool{ return (n & 1) == 1; };
+                        p = multiply(cx, x, x);  n -= 2;
+                        if (n > 0) {
+                            q = p;
+                            if (odd(n)) p = multiply(cx, q, x);
+                            else        p = copy(cx, q);
+                            dispose(cx, x);  x = q;  n /= 2;
                             if (odd(n)) {
-                                q = multiply(p, x);  dispose(p);  p = q;
+                                q = multiply(cx, p, x);  dispose(cx, p);  p = q;
+                            }
+                            while ((n /= 2) != 0) {
+                                cx.check_interrupt();
+                                q = multiply(cx, x, x);  dispose(cx, x);  x = q;
+                                if (odd(n)) {
+                                    q = multiply(cx, p, x);  dispose(cx, p);  p = q;
+                                }
                             }
                         }
                     }
+                }catch(...){
+                    dispose(cx, x);
+                    dispose(cx, p);
+                    throw;
                 }
-                dispose(x);
+                dispose(cx, x);
                 return p;
             },
 
@@ -595,106 +593,203 @@ node *power(node *x, node *y){
         }
     };
 
+    // 表の演算は底と指数に項があるものとする
+    // x^0は1, 0^正の実数は0, 0^負の実数は0による除算
+    if(!y->next){ return constant(cx, 1); }
+    if(!x->next && kind(y) == 1){
+        if(y->next->imag != 0){ throw(error("reject, 0^complex.")); }
+        if(y->next->real < 0){ throw(error("division by zero.")); }
+        return new_node(cx);
+    }
     return function_table[kind(x)][kind(y)](x, y);
 }
 
-// 式を文字列として得る. 実装
-std::pair<std::string, bool> poly_to_string_impl(const node *p, bool ext_paren = false){
-    bool first = true, one, paren = false;
+// 指数が1かどうか
+inline bool is_one(const node *p){
+    p = p->next;
+    return p && !p->next && p->real == 1 && p->imag == 0 && p->e.empty();
+}
+
+// 指数として書き出す時に括弧が必要かどうか
+bool exponent_needs_paren(const node *p){
+    bool first = true, one;
+    while(p = p->next){
+        one = false;
+        if(p->imag == 0){
+            if(!first || p->real < 0){ return true; }
+            one = p->real == 1;
+        }else if(p->real == 0){
+            if(!first || p->imag < 0){ return true; }
+        }else{
+            return true;
+        }
+        first = false;
+        for(auto iter = p->e.begin(); iter != p->e.end(); ++iter){
+            if(iter->second){
+                if(!one){ return true; }
+                one = false;
+            }
+        }
+    }
+    return false;
+}
+
+// 式の文字列表現を出力バッファに書き出す
+void poly_to_string(const node *p, output_buffer &o){
+    bool first = true, one;
     fpoint re, im;
-    node *e = nullptr, *c = constant(1);
-    std::string r;
+    const node *e;
     while(p = p->next){
         one = false;
         re = p->real;
         im = p->imag;
         if(im == 0){
             if(re >= 0){
-                if(!first){
-                    r += "+";
-                    paren = true;
-                }
+                if(!first){ o.put('+'); }
             }else{
                 re = -re;
-                r += "-";
-                paren = true;
+                o.put('-');
             }
-            if(re == 1){ one = true; }else{ r += to_string(re); }
+            if(re == 1){ one = true; }else{ o.put_number(re); }
         }else if(re == 0){
             if(im >= 0){
-                if(!first){
-                    r += "+";
-                    paren = true;
-                }
+                if(!first){ o.put('+'); }
             }else{
                 im = -im;
-                r += "-";
-                paren = true;
+                o.put('-');
             }
-            r += (std::abs(im) == 1 ? std::string("") : to_string(im)) + "i";
+            if(std::abs(im) != 1){ o.put_number(im); }
+            o.put('i');
         }else{
             if(first && !p->e.empty()){
-                r += "(";
-                r += to_string(re);
+                o.put('(');
+                o.put_number(re);
                 if(im > 0){
-                    r += "+" + to_string(im == 1 ? "i" : to_string(im) + "i");
+                    o.put('+');
+                    if(im != 1){ o.put_number(im); }
+                    o.put('i');
                 }else if(im < 0){
                     im = -im;
-                    r += "-" + to_string(im == 1 ? "i" : to_string(im) + "i");
+                    o.put('-');
+                    if(im != 1){ o.put_number(im); }
+                    o.put('i');
                 }
-                r += ")";
+                o.put(')');
             }else{
                 bool sign_re = re > 0, sign_im = im > 0;
-                std::string s;
                 if(!p->e.empty()){
-                    s += "(";
+                    o.put('(');
                     if(!sign_re && !sign_im){
-                        s += to_string(-re) + "+" + to_string(im == -1 ? std::string("-i") : to_string(-im) + "i");
+                        o.put_number(-re);
+                        o.put('+');
+                        if(im == -1){ o.put('-'); }else{ o.put_number(-im); }
                     }else if(!sign_re && sign_im){
-                        s += to_string(-re) + "-" + to_string(im == 1 ? std::string("i") : to_string(im) + "i");
+                        o.put_number(-re);
+                        o.put('-');
+                        if(im != 1){ o.put_number(im); }
                     }else if(sign_re && !sign_im){
-                        s += to_string(re) + to_string(im == -1 ? std::string("-i") : to_string(im) + "i");
+                        o.put_number(re);
+                        if(im == -1){ o.put('-'); }else{ o.put_number(im); }
                     }else{
-                        s += to_string(re) + "+" + to_string(im == 1 ? std::string("i") : to_string(im) + "i");
+                        o.put_number(re);
+                        o.put('+');
+                        if(im != 1){ o.put_number(im); }
                     }
-                    s += ")";
+                    o.write("i)", 2);
                 }else{
-                    s += to_string(re);
-                    if(im > 0){ s += "+"; }else{
+                    o.put_number(re);
+                    if(im > 0){ o.put('+'); }else{
                         im = -im;
-                        s += "-";
+                        o.put('-');
                     }
-                    s += to_string(im == 1 ? std::string("i") : to_string(im) + "i");
+                    if(im != 1){ o.put_number(im); }
+                    o.put('i');
                 }
-                r += s;
             }
-            paren = true;
         }
         first = false;
         for(auto iter = p->e.begin(); iter != p->e.end(); ++iter){
             if(e = iter->second){
-                if(!one){
-                    r += "*";
-                    if(ext_paren){ paren = true; }
-                }
+                if(!one){ o.put('*'); }
                 one = false;
-                r += *iter->first.ptr;
-                if(lexicographic_compare(e, c) != 0){
-                    std::pair<std::string, bool> s = poly_to_string_impl(e, true);
-                    r += "^" + std::string(s.second ? "(" : "") + s.first + std::string(s.second ? ")" : "");
+                o.write(*iter->first.ptr);
+                if(!is_one(e)){
+                    bool paren = exponent_needs_paren(e);
+                    o.put('^');
+                    if(paren){ o.put('('); }
+                    poly_to_string(e, o);
+                    if(paren){ o.put(')'); }
                 }
             }
         }
-        if(one){ r += "1"; }
+        if(one){ o.put('1'); }
     }
-    if(first){ r += "0"; }
-    dispose(c);
-    return std::make_pair(r, paren);
+    if(first){ o.put('0'); }
 }
 
 // 式を文字列として得る
 std::string poly_to_string(const node *p){
-    return poly_to_string_impl(p).first;
+    output_buffer o;
+    poly_to_string(p, o);
+    return o.str();
+}
+
+namespace{
+    // JSONの数値を書き出す. 有限でなければnull
+    void put_json_number(fpoint v, output_buffer &o){
+        if(std::isfinite(v)){
+            o.put_exact_number(v);
+        }else{
+            o.write("null", 4);
+        }
+    }
+
+    void put_json_string(const std::string &str, output_buffer &o){
+        o.put('"');
+        for(auto iter = str.begin(); iter != str.end(); ++iter){
+            unsigned char c = static_cast<unsigned char>(*iter);
+            if(c == '"' || c == '\\'){
+                o.put('\\');
+                o.put(static_cast<char>(c));
+            }else if(c < 0x20){
+                char buf[8];
+                int n = std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                o.write(buf, static_cast<std::size_t>(n));
+            }else{
+                o.put(static_cast<char>(c));
+            }
+        }
+        o.put('"');
+    }
+}
+
+// 式を項の配列のJSONとして出力バッファに書き出す
+// 項は{"re":実部,"im":虚部,"factors":[{"sym":記号,"exp":指数の項の配列}...]}
+void poly_to_json(const node *p, output_buffer &o){
+    o.put('[');
+    for(p = p->next; p; p = p->next){
+        o.write("{\"re\":", 6);
+        put_json_number(p->real, o);
+        o.write(",\"im\":", 6);
+        put_json_number(p->imag, o);
+        o.write(",\"factors\":[", 12);
+        for(auto iter = p->e.begin(); iter != p->e.end(); ++iter){
+            if(iter != p->e.begin()){ o.put(','); }
+            o.write("{\"sym\":", 7);
+            put_json_string(*iter->first.ptr, o);
+            o.write(",\"exp\":", 7);
+            poly_to_json(iter->second, o);
+            o.put('}');
+        }
+        o.write("]}", 2);
+        if(p->next){ o.put(','); }
+    }
+    o.put(']');
+}
+
+// 文字列をJSONの文字列として書き出す
+void string_to_json(const std::string &str, output_buffer &o){
+    put_json_string(str, o);
 }
 
 }
@@ -0,0 +1,104 @@
+﻿// 多項式の演算のテスト
+// 加算と乗算が項の並びに依らず同じ標準形の多項式を作ることを確かめる
+
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include "scalc.hpp"
+#include "test.hpp"
+
+namespace{
+    std::string eval(const std::string &statement){
+        scalc::context cx;
+        scalc::evaluator ev;
+        try{
+            return ev.eval(cx, statement.data(), statement.data() + statement.size());
+        }catch(std::exception &e){
+            return e.what();
+        }
+    }
+
+    // 項が標準の順に並んでいること
+    bool canonical(const std::string &statement){
+        scalc::context cx;
+        scalc::evaluator ev;
+        poly::node *p = ev.evaluate(cx, statement.data(), statement.data() + statement.size());
+        bool ok = true;
+        for(const poly::node *q = p->next; q && q->next; q = q->next){
+            if(poly::term_compare(q, q->next) <= 0){ ok = false; }
+        }
+        poly::dispose(cx, p);
+        return ok;
+    }
+
+    void sums(){
+        // 並べ替えただけの和は同じ多項式になる
+        CHECK(eval("x+1+y") == "x+y+1");
+        CHECK(eval("1+y+x") == "x+y+1");
+        CHECK(eval("y+x+1") == "x+y+1");
+        CHECK(eval("x + 2*ab") == "2*ab+x");
+        CHECK(eval("2*ab + x") == "2*ab+x");
+        CHECK(eval("b + a^2*b + a") == "a^2*b+a+b");
+        CHECK(eval("c^2+3*c+2+2") == "c^2+3*c+4");
+        CHECK(eval("x^y + x^2 + x") == "x^y+x^2+x");
+        CHECK(eval("x^2*y + y*x^2 + x*y^2") == "2*x^2*y+x*y^2");
+    }
+
+    void products(){
+        CHECK(eval("(x+1)*(y+1)") == "x*y+x+y+1");
+        CHECK(eval("(y+1)*(x+1)") == "x*y+x+y+1");
+        CHECK(eval("(a+b+c)^2") == "a^2+2*a*b+2*a*c+b^2+2*b*c+c^2");
+        CHECK(eval("(c+b+a)^2 - (a+b+c)^2") == "0");
+        CHECK(eval("(x-y)*(x+y) - (x^2 - y^2)") == "0");
+    }
+
+    // 項の無い0を除数, 底, 指数にする
+    void zeros(){
+        CHECK(eval("1/0") == "division by zero.");
+        CHECK(eval("x/0") == "division by zero.");
+        CHECK(eval("0/0") == "division by zero.");
+        CHECK(eval("(x+1)/(y-y)") == "division by zero.");
+        CHECK(eval("0/x") == "0");
+        CHECK(eval("0^2") == "0");
+        CHECK(eval("0^0.5") == "0");
+        CHECK(eval("0^(-1)") == "division by zero.");
+        CHECK(eval("0^x") == "reject, constant^symbol.");
+        CHECK(eval("(x-x)^(y+1)") == "reject, constant^polynomial.");
+        CHECK(eval("0^0") == "1");
+        CHECK(eval("x^0") == "1");
+        CHECK(eval("(x+1)^(y-y)") == "1");
+        CHECK(eval("2^(x-x)") == "1");
+    }
+
+    // 乱数で選んだ単項式の和を, 順を入れ替えて比べる
+    void shuffled(){
+        const char *const monomials[] = {
+            "1", "2", "x", "y", "ab", "x^2", "x*y", "y^2", "x^2*y", "3*x*ab", "y^x", "x^(y+1)", "2i*y", "ab^3", "c"
+        };
+        const std::size_t count = sizeof(monomials) / sizeof(monomials[0]);
+        std::mt19937 gen(2024);
+        bool same = true, ordered = true;
+        for(int n = 0; n < 2000; ++n){
+            std::vector<std::string> terms;
+            std::size_t k = 2 + gen() % 6;
+            for(std::size_t i = 0; i < k; ++i){ terms.push_back(monomials[gen() % count]); }
+            std::string a, b;
+            for(std::size_t i = 0; i < k; ++i){ a += (i ? " + " : "") + terms[i]; }
+            std::shuffle(terms.begin(), terms.end(), gen);
+            for(std::size_t i = 0; i < k; ++i){ b += (i ? " + " : "") + terms[i]; }
+            if(eval(a) != eval(b)){ same = false; }
+            if(!canonical(a) || !canonical("(" + a + ")*(" + b + ")")){ ordered = false; }
+        }
+        CHECK(same);
+        CHECK(ordered);
+    }
+}
+
+int main(){
+    sums();
+    products();
+    zeros();
+    shuffled();
+    return test::result("poly_test");
+}
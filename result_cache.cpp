@@ -0,0 +1,66 @@
+﻿#include "result_cache.hpp"
+
+namespace scalc{
+    result_cache::result_cache(std::size_t capacity_) : limit(capacity_), mutex(), list(), map(), size_(0), hits_(0), misses_(0){}
+
+    bool result_cache::find(const std::string &key, std::string &value){
+        std::lock_guard<std::mutex> lock(mutex);
+        auto iter = map.find(key);
+        if(iter == map.end()){
+            ++misses_;
+            return false;
+        }
+        ++hits_;
+        list.splice(list.begin(), list, iter->second);
+        value = iter->second->second;
+        return true;
+    }
+
+    void result_cache::insert(const std::string &key, const std::string &value){
+        std::size_t n = entry_size(key, value);
+        if(n > limit){ return; }
+        std::lock_guard<std::mutex> lock(mutex);
+        auto iter = map.find(key);
+        if(iter != map.end()){
+            // 他のスレッドが先に登録した
+            list.splice(list.begin(), list, iter->second);
+            return;
+        }
+        list.push_front(std::make_pair(key, value));
+        map.insert(std::make_pair(key, list.begin()));
+        size_ += n;
+        evict();
+    }
+
+    void result_cache::clear(){
+        std::lock_guard<std::mutex> lock(mutex);
+        map.clear();
+        list.clear();
+        size_ = 0;
+    }
+
+    std::size_t result_cache::size() const{
+        std::lock_guard<std::mutex> lock(mutex);
+        return size_;
+    }
+
+    std::size_t result_cache::hits() const{
+        std::lock_guard<std::mutex> lock(mutex);
+        return hits_;
+    }
+
+    std::size_t result_cache::misses() const{
+        std::lock_guard<std::mutex> lock(mutex);
+        return misses_;
+    }
+
+    void result_cache::evict(){
+        while(size_ > limit){
+            list_type::iterator last = list.end();
+            --last;
+            size_ -= entry_size(last->first, last->second);
+            map.erase(last->first);
+            list.erase(last);
+        }
+    }
+}
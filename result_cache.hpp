@@ -0,0 +1,60 @@
+﻿#ifndef SCALC_RESULT_CACHE_HPP
+#define SCALC_RESULT_CACHE_HPP
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <utility>
+
+namespace scalc{
+    // 文の結果の文字列のLRU cache
+    // 鍵は正規化したtoken列で, 空白と数値の表記の違いを区別しない
+    // 鍵と値の大きさの合計をcapacity byte以下に保ち, 超えた分は古く使われたものから捨てる
+    // 複数のスレッド, コンテキストから共有できる
+    class result_cache{
+    public:
+        explicit result_cache(std::size_t capacity_);
+
+        // 鍵の結果があればvalueに得てtrueを返す
+        bool find(const std::string &key, std::string &value);
+
+        // 結果を登録する. 1つでcapacityを超えるものは登録しない
+        void insert(const std::string &key, const std::string &value);
+
+        void clear();
+
+        std::size_t capacity() const{
+            return limit;
+        }
+
+        // 使っている大きさ
+        std::size_t size() const;
+
+        std::size_t hits() const;
+        std::size_t misses() const;
+
+    private:
+        result_cache(const result_cache&);
+        result_cache &operator =(const result_cache&);
+
+        typedef std::list<std::pair<std::string, std::string>> list_type;
+
+        // 1つの結果が占める大きさ
+        static std::size_t entry_size(const std::string &key, const std::string &value){
+            return key.size() + value.size() + sizeof(list_type::value_type) * 2;
+        }
+
+        void evict();
+
+        const std::size_t limit;
+        mutable std::mutex mutex;
+
+        // 先頭ほど最近使われた結果
+        list_type list;
+        std::unordered_map<std::string, list_type::iterator> map;
+        std::size_t size_, hits_, misses_;
+    };
+}
+
+#endif // SCALC_RESULT_CACHE_HPP
@@ -0,0 +1,380 @@
+﻿#include <memory>
+#include <iterator>
+#include <string>
+#include <cstdio>
+#include "scalc.hpp"
+#include "lexer_dfa.hpp"
+#include "literal.hpp"
+
+namespace scalc{
+    // 字句解析したtokenをその場で構文解析器に渡す
+    // 構文解析が受理か失敗で終わった後のtokenは渡さず, 字句解析だけを続ける
+    class evaluator::parse_inserter{
+    public:
+        parse_inserter(evaluator &ev_, context &cx_, analyzer::eval_target *&target_ptr_, bool &done_) : ev(&ev_), cx(&cx_), target_ptr(&target_ptr_), done(&done_){}
+
+        parse_inserter &operator =(const lex_data::lex_result &t){
+            if(!*done){ *done = ev->post_token(*cx, t, *target_ptr); }
+            return *this;
+        }
+
+        parse_inserter &operator *(){ return *this; }
+        parse_inserter &operator ++(){ return *this; }
+        parse_inserter &operator ++(int){ return *this; }
+
+    private:
+        evaluator *ev;
+        context *cx;
+        analyzer::eval_target **target_ptr;
+        bool *done;
+    };
+
+    std::unique_ptr<analyzer::eval_target> evaluator::parse(context &cx, const char *first, const char *last){
+        analyzer::eval_target *target_ptr = nullptr;
+        bool done = false;
+        begin_parse(cx);
+        try{
+            parse_inserter inserter(*this, cx, target_ptr, done);
+            auto lex_result = cx.dfa_lexer() ? lexer::dfa_lexer::tokenize(first, last, inserter) : lexer::lexer::tokenize(first, last, inserter);
+            if(!lex_result.first){
+                throw(error("lexical error."));
+            }
+            return end_parse(target_ptr);
+        }catch(...){
+            sa.dispose();
+            throw;
+        }
+    }
+
+    void evaluator::tokenize(context &cx, const char *first, const char *last){
+        token_sequence.clear();
+        auto lex_result = cx.dfa_lexer() ? lexer::dfa_lexer::tokenize(first, last, std::back_inserter(token_sequence)) : lexer::lexer::tokenize(first, last, std::back_inserter(token_sequence));
+        if(!lex_result.first){
+            throw(error("lexical error."));
+        }
+    }
+
+    namespace{
+        void read_value(analyzer::value &v, const lex_data::token_range &r){
+            numeric_literal l;
+            parse_literal(r.first, r.second, l);
+            v.v = l.v;
+            v.real = !l.imaginary;
+            v.mantissa = l.mantissa;
+            v.scale = l.scale;
+            v.exact = l.exact;
+        }
+    }
+
+    void evaluator::begin_parse(context &cx){
+        sa.cx = &cx;
+        sa.release();
+        p.reset();
+        leaves.clear();
+    }
+
+    bool evaluator::post_token(context &cx, const lex_data::lex_result &r, analyzer::eval_target *&target_ptr){
+        using namespace analyzer;
+        parser::token t = static_cast<parser::token>(r.first);
+        switch(t){
+        case parser::token_identifier:
+            {
+                value *v = new value;
+                sa.hold(v);
+                read_value(*v, r.second);
+                target_ptr = v;
+                leaves.push_back(v);
+            }
+            break;
+
+        case parser::token_symbol:
+            {
+                symbol *s = new symbol;
+                sa.hold(s);
+                s->s = cx.symbols.intern(r.second.first, r.second.second);
+                target_ptr = s;
+                leaves.push_back(s);
+            }
+            break;
+
+        default:
+            target_ptr = nullptr;
+        }
+        return p.post(t, target_ptr);
+    }
+
+    std::unique_ptr<analyzer::eval_target> evaluator::end_parse(analyzer::eval_target *target_ptr){
+        using namespace analyzer;
+        if(p.error()){
+            throw(error("parsing error."));
+        }else{
+            p.post(parser::token_0, target_ptr);
+        }
+
+        eval_target *root_ = nullptr;
+        if(!p.accept(root_)){
+            throw(error("parsing error."));
+        }
+        sa.release();
+        return std::unique_ptr<eval_target>(root_);
+    }
+
+    std::unique_ptr<analyzer::eval_target> evaluator::parse_tokens(context &cx){
+        analyzer::eval_target *target_ptr = nullptr;
+        begin_parse(cx);
+        try{
+            for(auto iter = token_sequence.begin(); iter != token_sequence.end(); ++iter){
+                if(post_token(cx, *iter, target_ptr)){ break; }
+            }
+            return end_parse(target_ptr);
+        }catch(...){
+            sa.dispose();
+            throw;
+        }
+    }
+
+    namespace{
+        void dispose_bindings(context &cx, binding_list &bindings){
+            for(auto iter = bindings.begin(); iter != bindings.end(); ++iter){
+                poly::dispose(cx, iter->second);
+            }
+            bindings.clear();
+        }
+    }
+
+    poly::node *evaluator::evaluate(context &cx, const analyzer::eval_target &root, binding_list *bindings){
+        using namespace analyzer;
+        semantic_data &sd(cx.data());
+        sd.clear();
+        cx.begin_evaluation();
+        // 見積りが上限を超える文は評価せずに拒否する
+        if(cx.cost_limit() > 0){
+            cost_estimator ce(sd);
+            if(ce(root).work > cx.cost_limit()){
+                if(bindings){ dispose_bindings(cx, *bindings); }
+                throw(error("estimated cost exceeds limit."));
+            }
+        }
+        try{
+            if(bindings && !bindings->empty()){
+                // 局所的な束縛はsd.clearで破棄される
+                auto &m(sd.push_local_args());
+                for(auto iter = bindings->begin(); iter != bindings->end(); ++iter){
+                    stack_element se;
+                    se.node = iter->second;
+                    if(!m.insert(std::make_pair(iter->first, se)).second){ poly::dispose(cx, iter->second); }
+                }
+                bindings->clear();
+            }
+            root.eval(sd);
+            stack_element se = sd.pop_stack();
+            if(!se.node){
+                throw(error("result is lambda expression."));
+            }
+            // 演算の外で上限を超えた場合も失敗とする
+            if(cx.memory_exceeded()){
+                poly::dispose(cx, se.node);
+                throw(error("memory limit exceeded."));
+            }
+            return se.node;
+        }catch(...){
+            sd.clear();
+            throw;
+        }
+    }
+
+    poly::node *evaluator::evaluate(context &cx, const char *first, const char *last){
+        // 構文解析に失敗した文の計測が前の文のものにならないよう, ここでも始めておく
+        cx.begin_evaluation();
+        // 雛形もdisk_cacheも使わなければtoken列は要らない
+        if(cx.template_limit() == 0 && !cx.disk_cache_ptr()){
+            std::unique_ptr<analyzer::eval_target> root(parse(cx, first, last));
+            return evaluate(cx, *root);
+        }
+        tokenize(cx, first, last);
+        std::string key;
+        bool cacheable = cx.disk_cache_ptr() && cache_key(cx, key);
+        return evaluate_tokens(cx, cacheable ? &key : nullptr);
+    }
+
+    poly::node *evaluator::evaluate(context &cx, const char *first, const char *last, binding_list &bindings){
+        try{
+            cx.begin_evaluation();
+            if(cx.template_limit() == 0){
+                std::unique_ptr<analyzer::eval_target> root(parse(cx, first, last));
+                return evaluate(cx, *root, &bindings);
+            }
+            tokenize(cx, first, last);
+            return evaluate_tokens(cx, nullptr, &bindings);
+        }catch(...){
+            dispose_bindings(cx, bindings);
+            throw;
+        }
+    }
+
+    poly::node *evaluator::evaluate_tokens(context &cx, const std::string *key, binding_list *bindings){
+        disk_cache *disk = key ? cx.disk_cache_ptr() : nullptr;
+        if(disk){
+            poly::node *q = disk->find(cx, *key);
+            if(q){ return q; }
+        }
+        poly::node *q;
+        if(const analyzer::eval_target *t = instantiate(cx)){
+            q = evaluate(cx, *t, bindings);
+        }else{
+            std::unique_ptr<analyzer::eval_target> root(parse_tokens(cx));
+            q = evaluate(cx, *root, bindings);
+        }
+        if(disk){ disk->insert(*key, q); }
+        return q;
+    }
+
+    const analyzer::eval_target *evaluator::instantiate(context &cx){
+        std::size_t limit = cx.template_limit();
+        if(limit == 0){ return nullptr; }
+        std::string key;
+        key.reserve(token_sequence.size());
+        for(auto iter = token_sequence.begin(); iter != token_sequence.end(); ++iter){
+            // letの右辺は束縛と共有されるので雛形にしない
+            if(iter->first == lexer::token_right_arrow || iter->first == lexer::token_keyword_let){ return nullptr; }
+            key += static_cast<char>(iter->first);
+        }
+
+        auto iter = templates.find(key);
+        if(iter == templates.end()){
+            std::unique_ptr<ast_template> t(new ast_template);
+            t->root = parse_tokens(cx);
+            t->leaves.swap(leaves);
+            // 一杯になったら最も古く使われたものから捨てる
+            while(templates.size() >= limit){
+                templates.erase(template_list.back().first);
+                template_list.pop_back();
+            }
+            template_list.push_front(std::make_pair(key, std::move(t)));
+            templates.insert(std::make_pair(key, template_list.begin()));
+            return template_list.front().second->root.get();
+        }
+
+        template_list.splice(template_list.begin(), template_list, iter->second);
+
+        // 葉はtoken列と同じ順に並ぶ
+        ast_template &t(*iter->second->second);
+        std::size_t i = 0;
+        for(auto jter = token_sequence.begin(); jter != token_sequence.end(); ++jter){
+            if(jter->first == lexer::token_identifier){
+                read_value(*static_cast<analyzer::value*>(t.leaves[i++]), jter->second);
+            }else if(jter->first == lexer::token_symbol){
+                static_cast<analyzer::symbol*>(t.leaves[i++])->s = cx.symbols.intern(jter->second.first, jter->second.second);
+            }
+        }
+        return t.root.get();
+    }
+
+    bool evaluator::cache_key(context &cx, std::string &key) const{
+        const auto &let_values(cx.data().let_values());
+        key.clear();
+        for(auto iter = token_sequence.begin(); iter != token_sequence.end(); ++iter){
+            key += static_cast<char>(iter->first);
+            switch(iter->first){
+            case lexer::token_keyword_let:
+            case lexer::token_keyword_unlet:
+                return false;
+
+            case lexer::token_identifier:
+                {
+                    // 評価と同じく読んだ値で表す
+                    numeric_literal l;
+                    parse_literal(iter->second.first, iter->second.second, l);
+                    char buf[32];
+                    int n = std::snprintf(buf, sizeof(buf), "%.17g", static_cast<double>(l.v));
+                    key.append(buf, static_cast<std::size_t>(n));
+                    if(l.imaginary){ key += 'i'; }
+                    key += '\0';
+                }
+                break;
+
+            case lexer::token_symbol:
+                {
+                    // 表に無い名前は束縛されていない
+                    if(const std::string *name = cx.symbols.find(iter->second.first, iter->second.second)){
+                        auto jter = let_values.find(str_wrapper(name));
+                        if(jter != let_values.end() && !jter->second.empty()){ return false; }
+                    }
+                    key.append(iter->second.first, iter->second.second);
+                    key += '\0';
+                }
+                break;
+
+            default:
+                break;
+            }
+        }
+        return true;
+    }
+
+    void evaluator::write_result(const context &cx, const poly::node *q, output_buffer &o){
+        if(cx.format() == output_json){
+            poly::poly_to_json(q, o);
+        }else{
+            poly::poly_to_string(q, o);
+        }
+    }
+
+    void evaluator::write_error(const context &cx, const char *message, output_buffer &o){
+        if(cx.format() == output_json){
+            o.write("{\"error\":", 9);
+            poly::string_to_json(message, o);
+            o.put('}');
+        }else{
+            o.write(message);
+        }
+    }
+
+    void evaluator::eval(context &cx, const char *first, const char *last, output_buffer &o){
+        if(!cx.result_cache_ptr() && !cx.disk_cache_ptr()){
+            poly::node *q = evaluate(cx, first, last);
+            write_result(cx, q, o);
+            poly::dispose(cx, q);
+            return;
+        }
+        cx.begin_evaluation();
+        tokenize(cx, first, last);
+        eval_tokens(cx, o);
+    }
+
+    void evaluator::eval(context &cx, const lex_data::token_sequence &tokens, output_buffer &o){
+        cx.begin_evaluation();
+        token_sequence.assign(tokens.begin(), tokens.end());
+        eval_tokens(cx, o);
+    }
+
+    void evaluator::eval_tokens(context &cx, output_buffer &o){
+        result_cache *cache = cx.result_cache_ptr();
+        std::string key, value;
+        bool cacheable = (cache || cx.disk_cache_ptr()) && cache_key(cx, key);
+        // 書き出した結果は書式ごとに分ける
+        std::string text_key = static_cast<char>(cx.format()) + key;
+        if(cacheable && cache && cache->find(text_key, value)){
+            o.write(value);
+            return;
+        }
+        poly::node *q = evaluate_tokens(cx, cacheable ? &key : nullptr);
+        if(!cacheable || !cache){
+            write_result(cx, q, o);
+            poly::dispose(cx, q);
+            return;
+        }
+        output_buffer r;
+        write_result(cx, q, r);
+        poly::dispose(cx, q);
+        value = r.str();
+        cache->insert(text_key, value);
+        o.write(value);
+    }
+
+    std::string evaluator::eval(context &cx, const char *first, const char *last){
+        output_buffer o;
+        eval(cx, first, last, o);
+        return o.str();
+    }
+}
@@ -0,0 +1,145 @@
+﻿#ifndef SCALC_H
+#define SCALC_H
+
+/* libscalc C API
+ * 文を評価し, 結果の多項式を文字列化せずに項, 係数, 記号, 指数として参照する
+ * 1つのscalc_ctxを同時に複数のスレッドから使ってはならない
+ * 異なるscalc_ctxは別々のスレッドから使える
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 評価のコンテキスト. letによる束縛を保持する */
+typedef struct scalc_ctx scalc_ctx;
+
+/* 評価結果 */
+typedef struct scalc_result scalc_result;
+
+/* 多項式 */
+typedef struct scalc_poly scalc_poly;
+
+/* 多項式の項 */
+typedef struct scalc_term scalc_term;
+
+/* 項の因子 symbol^exponent
+ * symbolは0終端で, コンテキストが破棄されるまで有効
+ * exponentは因子を得た結果が破棄されるまで有効
+ */
+typedef struct scalc_factor{
+    const char *symbol;
+    size_t symbol_len;
+    const scalc_poly *exponent;
+} scalc_factor;
+
+/* コンテキストを生成する. 失敗するとNULLを返す */
+scalc_ctx *scalc_ctx_new(void);
+
+/* コンテキストと, それが保持する全ての束縛を破棄する
+ * そのコンテキストで得た結果は先に破棄しておくこと
+ */
+void scalc_ctx_free(scalc_ctx *ctx);
+
+/* 1文の評価に掛けてよい時間をミリ秒で設定する. 0は無制限
+ * 超えた評価は打ち切られ, 結果のエラーメッセージは"timeout."になる
+ */
+void scalc_ctx_set_timeout(scalc_ctx *ctx, unsigned long ms);
+
+/* 1文の評価で新たに使ってよいメモリをbyteで設定する. 0は無制限
+ * 項と指数部の要素の大きさを数え, 超えた評価は打ち切られる
+ * 結果のエラーメッセージは"memory limit exceeded."になる
+ */
+void scalc_ctx_set_memory_limit(scalc_ctx *ctx, size_t bytes);
+
+/* 評価の前に見積もる費用の上限を設定する. 0は無制限
+ * 見積りが上限を超える文は評価されず, エラーメッセージは"estimated cost exceeds limit."になる
+ */
+void scalc_ctx_set_max_cost(scalc_ctx *ctx, double work);
+
+/* 構文木の雛形を最大n個まで保持する. 0は使わない
+ * 数値と記号だけが異なる文は構文解析を省いて評価する
+ */
+void scalc_ctx_set_ast_cache(scalc_ctx *ctx, size_t n);
+
+/* letの依存関係を記録するかを設定する. 0は記録しない(既定)
+ * 記録すると, 記号をletで束縛し直した時やunletした時に, その記号を使って定義された束縛が
+ * 推移的に古くなり, 次に参照された時に定義式から再計算される
+ */
+void scalc_ctx_set_let_tracking(scalc_ctx *ctx, int enable);
+
+/* 字句解析にlexer.txtから生成したDFAを使うかを設定する. 0は使わない(既定)
+ * 結果は変わらない. 長い空白, 数字, 記号が続く文で速い
+ */
+void scalc_ctx_set_dfa_lexer(scalc_ctx *ctx, int enable);
+
+/* 文の結果の多項式をファイルに残すcacheを開く. ファイルが無ければ作る
+ * 同じファイルを複数のプロセス, コンテキストから同時に開ける
+ * let, unletを含む文と, letで束縛された記号を使う文はcacheしない
+ * pathがNULLであればcacheを閉じる. 成功すると0を, 失敗すると-1を返す
+ */
+int scalc_ctx_open_disk_cache(scalc_ctx *ctx, const char *path);
+
+/* 評価中の文を打ち切る. 他のスレッドから呼べる
+ * 打ち切られた結果のエラーメッセージは"cancelled."になる
+ * 取り消しは次にscalc_evalを始めた時に解除される
+ */
+void scalc_ctx_cancel(scalc_ctx *ctx);
+
+/* 1文を評価する
+ * 失敗した場合もエラーを保持する結果を返す. NULLはメモリ不足の時のみ
+ */
+scalc_result *scalc_eval(scalc_ctx *ctx, const char *str, size_t len);
+
+/* 結果を破棄する. 評価したコンテキストより先に破棄すること */
+void scalc_result_free(scalc_result *r);
+
+/* 失敗していればエラーメッセージを, 成功していればNULLを返す */
+const char *scalc_result_error(const scalc_result *r);
+
+/* 評価が新たに使ったメモリの最大値をbyteで返す. 失敗した評価でも得られる */
+size_t scalc_result_peak_memory(const scalc_result *r);
+
+/* 二進の要求を評価する. 要求と応答の形式はwire.hppの通り
+ *     要求 : 種別(1byte, 1) 文の長さ(u32) 文 束縛の数(u32) (記号の長さ(u32) 記号 値の長さ(u32) 値)...
+ *     応答 : 状態(1byte) 成功 : メモリの最大値(u64) 結果 / 失敗 : エラーメッセージ
+ *     多項式 : 記号の数(u32) (長さ(u32) 記号)... 項の数(u32) (実部(f64) 虚部(f64) 因子の数(u32) (記号の番号(u32) 指数の多項式)...)...
+ * 数値は全てlittle endian. 束縛した値はその文の中でだけ有効で, where部で隠せる
+ * 失敗した場合もエラーを保持する結果を返す. NULLはメモリ不足の時のみ
+ */
+scalc_result *scalc_eval_request(scalc_ctx *ctx, const void *request, size_t len);
+
+/* 結果を二進の応答に書き出し, 長さをlenに得る
+ * 領域は結果が破棄されるまで有効. NULLはメモリ不足の時のみ
+ */
+const void *scalc_result_encode(scalc_result *r, size_t *len);
+
+/* 結果の多項式. 失敗していればNULLを返す */
+const scalc_poly *scalc_result_poly(const scalc_result *r);
+
+/* 項の数 */
+size_t scalc_poly_term_count(const scalc_poly *p);
+
+/* 先頭の項. 項が無ければ(0であれば)NULLを返す */
+const scalc_term *scalc_poly_first_term(const scalc_poly *p);
+
+/* 次の項. 最後の項であればNULLを返す */
+const scalc_term *scalc_term_next(const scalc_term *t);
+
+/* 係数の実部と虚部 */
+double scalc_term_real(const scalc_term *t);
+double scalc_term_imag(const scalc_term *t);
+
+/* 因子の数 */
+size_t scalc_term_factor_count(const scalc_term *t);
+
+/* 因子を記号の順にoutへ最大n個書き出し, 書き出した数を返す */
+size_t scalc_term_factors(const scalc_term *t, scalc_factor *out, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SCALC_H */
@@ -0,0 +1,138 @@
+﻿#ifndef SCALC_SCALC_HPP
+#define SCALC_SCALC_HPP
+
+#include <vector>
+#include <list>
+#include <string>
+#include <utility>
+#include <memory>
+#include <unordered_map>
+#include "common.hpp"
+#include "analyzer.hpp"
+#include "parser.hpp"
+#include "context.hpp"
+#include "result_cache.hpp"
+#include "disk_cache.hpp"
+
+namespace lex_data{
+    // 字句解析結果のrange
+    // 入力は複写せず, 元の領域を直接指す
+    typedef std::pair<const char*, const char*> token_range;
+
+    // 字句解析結果のtoken種別と範囲
+    typedef std::pair<lexer::token, token_range> lex_result;
+
+    // 字句解析結果
+    typedef std::vector<lex_result> token_sequence;
+}
+
+namespace scalc{
+    // 文の評価の前に記号へ束縛する値
+    typedef std::vector<std::pair<str_wrapper, poly::node*>> binding_list;
+
+    // 文の評価器
+    // parser, token列を文の間で使い回す
+    class evaluator{
+    public:
+        evaluator() : sa(), p(sa), token_sequence(), leaves(), template_list(), templates(){}
+
+        // 1文を字句解析, 構文解析して構文木を返す
+        // tokenは字句解析した端から構文解析器に渡し, token列には溜めない
+        // コンテキストのうち記号表と計数器だけを使う
+        // 失敗はerrorを投げる
+        std::unique_ptr<analyzer::eval_target> parse(context &cx, const char *first, const char *last);
+
+        // 構文木をコンテキストの中で評価して結果の多項式を返す
+        // コンテキストのうち項の割り当て器と束縛だけを使う
+        // 結果は呼び出し側がpoly::disposeする
+        // 失敗はerrorを投げる
+        // bindingsがあれば, 文のwhere部より外側の局所的な束縛として評価する
+        // bindingsの多項式は成否に関わらず評価器が破棄し, bindingsは空になる
+        static poly::node *evaluate(context &cx, const analyzer::eval_target &root, binding_list *bindings = nullptr);
+
+        // 1文をコンテキストの中で評価して結果の多項式を返す
+        // コンテキストにdisk_cacheがあれば, evalのcacheと同じ条件で結果を引き, 登録する
+        // 結果は呼び出し側がpoly::disposeする
+        // 字句解析, 構文解析, 評価の失敗はerrorを投げる
+        poly::node *evaluate(context &cx, const char *first, const char *last);
+
+        // 記号に値を束縛して1文を評価する. 結果はcacheしない
+        // bindingsの多項式は成否に関わらず評価器が破棄し, bindingsは空になる
+        poly::node *evaluate(context &cx, const char *first, const char *last, binding_list &bindings);
+
+        // 結果をコンテキストの書式で書き出す
+        static void write_result(const context &cx, const poly::node *q, output_buffer &o);
+
+        // 失敗のメッセージをコンテキストの書式で書き出す
+        static void write_error(const context &cx, const char *message, output_buffer &o);
+
+        // 1文をコンテキストの中で評価して結果をコンテキストの書式で出力バッファに書き出す
+        // コンテキストにcacheがあれば, let, unletを含まず束縛された記号も使わない文の結果をcacheする
+        // 失敗した場合は何も書き出さずにerrorを投げる
+        void eval(context &cx, const char *first, const char *last, output_buffer &o);
+
+        // 字句解析を済ませた1文を評価する. tokenの範囲は評価を終えるまで有効であること
+        // 他はevalと同じ
+        void eval(context &cx, const lex_data::token_sequence &tokens, output_buffer &o);
+
+        // 1文をコンテキストの中で評価して結果を文字列で返す
+        std::string eval(context &cx, const char *first, const char *last);
+
+    private:
+        evaluator(const evaluator&);
+        evaluator &operator =(const evaluator&);
+
+        class parse_inserter;
+
+        // コンテキストの設定する字句解析器で字句解析してtoken_sequenceに得る
+        void tokenize(context &cx, const char *first, const char *last);
+
+        // 構文解析を始め, tokenを1つずつ渡し, 終えて構文木を得る
+        // 数値と記号のtokenは渡す時に葉にしてleavesに並べる. post_tokenは構文解析が受理か失敗で終わればtrueを返す
+        // 失敗した時は, 構文解析器に渡した葉と作りかけの部分木をsa.disposeで解放する
+        void begin_parse(context &cx);
+        bool post_token(context &cx, const lex_data::lex_result &r, analyzer::eval_target *&target_ptr);
+        std::unique_ptr<analyzer::eval_target> end_parse(analyzer::eval_target *target_ptr);
+
+        // token_sequenceを構文解析する
+        std::unique_ptr<analyzer::eval_target> parse_tokens(context &cx);
+
+        // token_sequenceを評価する. keyがあればdisk_cacheを使う
+        poly::node *evaluate_tokens(context &cx, const std::string *key, binding_list *bindings = nullptr);
+
+        // token_sequenceの構文木を雛形から得る
+        // コンテキストのtemplate_limitまで, token種別の列が同じ文の構文木を保持して数値と記号を入れ替えて使う
+        // 雛形を使わない設定, または雛形にできないlambda式を含む文であればnullptrを返す
+        const analyzer::eval_target *instantiate(context &cx);
+
+        // token_sequenceを評価し, evalと同じくcacheを使って書き出す
+        void eval_tokens(context &cx, output_buffer &o);
+
+        // token_sequenceからcacheの鍵を作る
+        // 結果が束縛の状態に依る文であればfalseを返す
+        bool cache_key(context &cx, std::string &key) const;
+
+        analyzer::semantic_action sa;
+        parser::parser<analyzer::eval_target*, analyzer::semantic_action> p;
+        lex_data::token_sequence token_sequence;
+
+        // 構文木の雛形
+        // leavesは数値と記号の葉をtoken列の順に指す
+        struct ast_template{
+            std::unique_ptr<analyzer::eval_target> root;
+            std::vector<analyzer::eval_target*> leaves;
+        };
+
+        // 最後に構文解析した文の数値と記号の葉
+        std::vector<analyzer::eval_target*> leaves;
+
+        typedef std::list<std::pair<std::string, std::unique_ptr<ast_template>>> template_list_type;
+
+        // 雛形のLRU. 先頭ほど最近使われた雛形
+        // templatesはtoken種別の列からtemplate_listの要素へのmap
+        template_list_type template_list;
+        std::unordered_map<std::string, template_list_type::iterator> templates;
+    };
+}
+
+#endif // SCALC_SCALC_HPP
@@ -0,0 +1,312 @@
+﻿#include <map>
+#include <memory>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#if defined(__unix__)
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "session.hpp"
+#include "analyzer.hpp"
+
+namespace scalc{
+    namespace{
+        const char magic[8] = { 'S', 'C', 'A', 'L', 'C', 'S', 'S', 1 };
+        const std::size_t header_size = 16;
+
+        // 指数の入れ子の深さの上限
+        const std::size_t max_depth = 1024;
+
+        void put_u32(output_buffer &o, std::uint32_t n){
+            char b[4];
+            for(int i = 0; i < 4; ++i){ b[i] = static_cast<char>(n >> (i * 8)); }
+            o.write(b, 4);
+        }
+
+        void put_f64(output_buffer &o, fpoint v){
+            double d = v;
+            std::uint64_t n;
+            std::memcpy(&n, &d, 8);
+            char b[8];
+            for(int i = 0; i < 8; ++i){ b[i] = static_cast<char>(n >> (i * 8)); }
+            o.write(b, 8);
+        }
+
+        class writer{
+        public:
+            explicit writer(output_buffer &o_) : o(o_), symbols(), symbol_order(){}
+
+            std::uint32_t symbol_index(const str_wrapper &s){
+                auto iter = symbols.find(s.ptr);
+                if(iter != symbols.end()){ return iter->second; }
+                std::uint32_t n = static_cast<std::uint32_t>(symbol_order.size());
+                symbols.insert(std::make_pair(s.ptr, n));
+                symbol_order.push_back(s.ptr);
+                return n;
+            }
+
+            void write_poly(const poly::node *p){
+                std::uint32_t n = 0;
+                for(const poly::node *q = p->next; q; q = q->next){ ++n; }
+                put_u32(o, n);
+                for(const poly::node *q = p->next; q; q = q->next){
+                    put_f64(o, q->real);
+                    put_f64(o, q->imag);
+                    put_u32(o, static_cast<std::uint32_t>(q->e.size()));
+                    for(auto iter = q->e.begin(); iter != q->e.end(); ++iter){
+                        put_u32(o, symbol_index(iter->first));
+                        write_poly(iter->second);
+                    }
+                }
+            }
+
+            const std::vector<const std::string*> &symbol_list() const{
+                return symbol_order;
+            }
+
+        private:
+            output_buffer &o;
+            std::map<const std::string*, std::uint32_t> symbols;
+            std::vector<const std::string*> symbol_order;
+        };
+
+        class reader{
+        public:
+            reader(context &cx_, const char *first, const char *last_, const char *message_ = "broken session file.")
+                : cx(cx_), pos(first), last(last_), symbols(), message(message_){}
+
+            std::uint32_t get_u32(){
+                need(4);
+                const unsigned char *p = reinterpret_cast<const unsigned char*>(pos);
+                std::uint32_t n = 0;
+                for(int i = 0; i < 4; ++i){ n |= static_cast<std::uint32_t>(p[i]) << (i * 8); }
+                pos += 4;
+                return n;
+            }
+
+            fpoint get_f64(){
+                need(8);
+                const unsigned char *p = reinterpret_cast<const unsigned char*>(pos);
+                std::uint64_t n = 0;
+                for(int i = 0; i < 8; ++i){ n |= static_cast<std::uint64_t>(p[i]) << (i * 8); }
+                pos += 8;
+                double d;
+                std::memcpy(&d, &n, 8);
+                return d;
+            }
+
+            void read_symbols(std::uint32_t n){
+                // 記号は長さだけで4byteを使う. 残りに収まらない数は確保する前に拒む
+                if(n > static_cast<std::size_t>(last - pos) / 4){ broken(); }
+                symbols.reserve(n);
+                for(std::uint32_t i = 0; i < n; ++i){
+                    std::uint32_t len = get_u32();
+                    need(len);
+                    symbols.push_back(cx.symbols.intern(pos, pos + len));
+                    pos += len;
+                }
+            }
+
+            const str_wrapper &get_symbol(){
+                std::uint32_t i = get_u32();
+                if(i >= symbols.size()){ broken(); }
+                return symbols[i];
+            }
+
+            // 多項式を読む. 失敗した場合は途中まで作った項を破棄してerrorを投げる
+            // 演算が作る形の多項式だけを受け付ける. 項はpoly::term_compareの順に並び, 同じ指数部の項, 係数が0の項,
+            // 0の指数(項の無い指数部の多項式)を含まない
+            poly::node *read_poly(std::size_t depth){
+                if(depth > max_depth){ broken(); }
+                std::uint32_t n = get_u32();
+                poly::node *head = poly::new_node(cx), *tail = head;
+                try{
+                    for(std::uint32_t i = 0; i < n; ++i){
+                        poly::node *q = poly::new_node(cx), *prev = tail;
+                        tail->next = q, tail = q;
+                        q->real = get_f64();
+                        q->imag = get_f64();
+                        if(q->real == 0 && q->imag == 0){ broken(); }
+                        std::uint32_t m = get_u32();
+                        for(std::uint32_t j = 0; j < m; ++j){
+                            const str_wrapper &s(get_symbol());
+                            poly::node *e = read_poly(depth + 1);
+                            if(!e->next || !q->e.insert(std::make_pair(s, e)).second){
+                                poly::dispose(cx, e);
+                                broken();
+                            }
+                        }
+                        if(prev != head && poly::term_compare(prev, q) <= 0){ broken(); }
+                    }
+                }catch(...){
+                    poly::dispose(cx, head);
+                    throw;
+                }
+                return head;
+            }
+
+            bool at_end() const{
+                return pos == last;
+            }
+
+        private:
+            void need(std::size_t n) const{
+                if(static_cast<std::size_t>(last - pos) < n){ broken(); }
+            }
+
+            void broken() const{
+                throw(error(message));
+            }
+
+            context &cx;
+            const char *pos, *last;
+            std::vector<str_wrapper> symbols;
+            const char *message;
+        };
+    }
+
+    void save_session(context &cx, const std::string &path){
+        // 束縛は値だけを書き出す. 隠された束縛は古くなっていても再計算しない
+        cx.data().refresh_let_values();
+        const auto &let_values(cx.data().let_values());
+        output_buffer body;
+        writer w(body);
+        std::uint32_t binding_count = 0;
+        for(auto iter = let_values.begin(); iter != let_values.end(); ++iter){
+            for(auto jter = iter->second.begin(); jter != iter->second.end(); ++jter){
+                if(!jter->node){ continue; }
+                put_u32(body, w.symbol_index(iter->first));
+                w.write_poly(jter->node);
+                ++binding_count;
+            }
+        }
+
+        output_buffer head;
+        head.write(magic, sizeof(magic));
+        put_u32(head, static_cast<std::uint32_t>(w.symbol_list().size()));
+        put_u32(head, binding_count);
+        for(auto iter = w.symbol_list().begin(); iter != w.symbol_list().end(); ++iter){
+            put_u32(head, static_cast<std::uint32_t>((*iter)->size()));
+            head.write(**iter);
+        }
+
+        std::string tmp = path + ".tmp";
+        std::FILE *fp = std::fopen(tmp.c_str(), "wb");
+        if(!fp){
+            throw(error("cannot open " + tmp + "."));
+        }
+        bool ok = std::fwrite(head.data(), 1, head.size(), fp) == head.size();
+        ok = ok && std::fwrite(body.data(), 1, body.size(), fp) == body.size();
+        ok = std::fclose(fp) == 0 && ok;
+        if(!ok || std::rename(tmp.c_str(), path.c_str()) != 0){
+            std::remove(tmp.c_str());
+            throw(error("cannot write " + path + "."));
+        }
+    }
+
+    void serialize_poly(const poly::node *p, output_buffer &o){
+        output_buffer body;
+        writer w(body);
+        w.write_poly(p);
+        put_u32(o, static_cast<std::uint32_t>(w.symbol_list().size()));
+        for(auto iter = w.symbol_list().begin(); iter != w.symbol_list().end(); ++iter){
+            put_u32(o, static_cast<std::uint32_t>((*iter)->size()));
+            o.write(**iter);
+        }
+        o.write(body.data(), body.size());
+    }
+
+    poly::node *deserialize_poly(context &cx, const char *first, const char *last){
+        reader r(cx, first, last, "broken polynomial image.");
+        r.read_symbols(r.get_u32());
+        poly::node *p = r.read_poly(0);
+        if(!r.at_end()){
+            poly::dispose(cx, p);
+            throw(error("broken polynomial image."));
+        }
+        return p;
+    }
+
+    session_image::session_image(const std::string &path) : first(nullptr), last(nullptr), mapped(false), buffer(){
+        std::FILE *fp = std::fopen(path.c_str(), "rb");
+        if(!fp){
+            throw(error("cannot open " + path + "."));
+        }
+        std::unique_ptr<std::FILE, int(*)(std::FILE*)> fp_guard(fp, std::fclose);
+#if defined(__unix__)
+        struct stat st;
+        int fd = ::fileno(fp);
+        if(::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0){
+            void *p = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if(p != MAP_FAILED){
+                ::madvise(p, static_cast<std::size_t>(st.st_size), MADV_WILLNEED);
+                first = static_cast<const char*>(p);
+                last = first + st.st_size;
+                mapped = true;
+                return;
+            }
+        }
+#endif
+        char chunk[1 << 16];
+        for(std::size_t r; (r = std::fread(chunk, 1, sizeof(chunk), fp)) > 0; ){
+            buffer.insert(buffer.end(), chunk, chunk + r);
+        }
+        first = buffer.data();
+        last = first + buffer.size();
+    }
+
+    session_image::~session_image(){
+#if defined(__unix__)
+        if(mapped){
+            ::munmap(const_cast<char*>(first), last - first);
+        }
+#endif
+    }
+
+    void session_image::load(context &cx) const{
+        if(static_cast<std::size_t>(last - first) < header_size || std::memcmp(first, magic, sizeof(magic)) != 0){
+            throw(error("broken session file."));
+        }
+        reader r(cx, first + sizeof(magic), last);
+        std::uint32_t symbol_count = r.get_u32();
+        std::uint32_t binding_count = r.get_u32();
+        r.read_symbols(symbol_count);
+
+        // 全て読めてから登録する
+        std::vector<std::pair<str_wrapper, poly::node*>> bindings;
+        try{
+            for(std::uint32_t i = 0; i < binding_count; ++i){
+                const str_wrapper &s(r.get_symbol());
+                bindings.push_back(std::make_pair(s, nullptr));
+                bindings.back().second = r.read_poly(0);
+            }
+            if(!r.at_end()){
+                throw(error("broken session file."));
+            }
+        }catch(...){
+            for(auto iter = bindings.begin(); iter != bindings.end(); ++iter){
+                if(iter->second){ poly::dispose(cx, iter->second); }
+            }
+            throw;
+        }
+
+        analyzer::semantic_data &sd(cx.data());
+        for(std::size_t i = 0; i < bindings.size(); ++i){
+            analyzer::stack_element se;
+            se.node = bindings[i].second;
+            try{
+                sd.register_let_value(bindings[i].first, se);
+            }catch(...){
+                // register_let_valueは失敗した束縛を破棄している
+                for(std::size_t j = i + 1; j < bindings.size(); ++j){
+                    poly::dispose(cx, bindings[j].second);
+                }
+                throw;
+            }
+        }
+    }
+}
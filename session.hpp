@@ -0,0 +1,58 @@
+﻿#ifndef SCALC_SESSION_HPP
+#define SCALC_SESSION_HPP
+
+#include <vector>
+#include <string>
+#include "context.hpp"
+
+namespace scalc{
+    // letによる束縛の二進イメージ
+    // 数値は全てlittle endian
+    //     header  : "SCALCSS" 版数(1byte) 記号の数(u32) 束縛の数(u32)
+    //     記号    : 長さ(u32) 文字列
+    //     束縛    : 記号の番号(u32) 多項式
+    //     多項式  : 項の数(u32) 項...
+    //     項      : 実部(f64) 虚部(f64) 因子の数(u32) (記号の番号(u32) 指数の多項式)...
+    // 記号ごとの束縛は古いものから順に並び, 読み込むと同じ隠し合いの状態になる
+
+    // 1つの多項式を, 使う記号と合わせて束縛と同じ形式で書き出す
+    //     記号の数(u32) 記号... 多項式
+    void serialize_poly(const poly::node *p, output_buffer &o);
+
+    // serialize_polyで書き出した多項式をコンテキストの中に作る
+    // 壊れている, または項の順, 重複, 0の係数, 0の指数のように演算が作らない形であればerrorを投げる
+    poly::node *deserialize_poly(context &cx, const char *first, const char *last);
+
+    // コンテキストの束縛をファイルに書き出す
+    // 一時ファイルに書き出してから置き換えるので, 失敗しても元のファイルは壊れない
+    // 定義式と依存関係は書き出さず, 読み込んだ束縛は再計算されない
+    void save_session(context &cx, const std::string &path);
+
+    // 読み込んだ二進イメージ
+    // 通常のファイルはmmapし, 束縛はmapされた領域から直接項に展開する
+    // 1つのイメージから複数のコンテキストへ読み込める
+    class session_image{
+    public:
+        explicit session_image(const std::string &path);
+        ~session_image();
+
+        // 全ての束縛をコンテキストに登録する
+        // イメージが壊れていればerrorを投げ, コンテキストには何も登録しない
+        // 束縛の数の上限を超えた場合はerrorを投げ, それまでの束縛は登録されたまま残る
+        void load(context &cx) const;
+
+    private:
+        session_image(const session_image&);
+        session_image &operator =(const session_image&);
+
+        const char *first, *last;
+        bool mapped;
+        std::vector<char> buffer;
+    };
+
+    inline void load_session(context &cx, const std::string &path){
+        session_image(path).load(cx);
+    }
+}
+
+#endif // SCALC_SESSION_HPP
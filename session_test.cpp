@@ -0,0 +1,132 @@
+﻿// 多項式の書き出しと読み込みのテスト
+// serialize_polyで書き出したものが同じ多項式に戻ること, 演算が作らない形の多項式を拒むことを確かめる
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include "scalc.hpp"
+#include "session.hpp"
+#include "test.hpp"
+
+namespace{
+    // serialize_polyの形式を手で組み立てる
+    class image{
+    public:
+        image &u32(std::uint32_t n){
+            for(int i = 0; i < 4; ++i){ str += static_cast<char>(n >> (i * 8)); }
+            return *this;
+        }
+
+        image &f64(double d){
+            std::uint64_t n;
+            std::memcpy(&n, &d, 8);
+            for(int i = 0; i < 8; ++i){ str += static_cast<char>(n >> (i * 8)); }
+            return *this;
+        }
+
+        image &symbol(const char *s){
+            u32(static_cast<std::uint32_t>(std::strlen(s)));
+            str += s;
+            return *this;
+        }
+
+        // 指数部の無い項
+        image &term(double re, double im = 0){
+            return f64(re).f64(im).u32(0);
+        }
+
+        std::string str;
+    };
+
+    bool rejected(const std::string &s){
+        scalc::context cx;
+        try{
+            poly::node *p = scalc::deserialize_poly(cx, s.data(), s.data() + s.size());
+            poly::dispose(cx, p);
+            return false;
+        }catch(std::exception&){
+            return true;
+        }
+    }
+
+    std::string round_trip(const char *statement){
+        scalc::context cx;
+        scalc::evaluator ev;
+        poly::node *p = ev.evaluate(cx, statement, statement + std::strlen(statement));
+        output_buffer o;
+        scalc::serialize_poly(p, o);
+        poly::dispose(cx, p);
+        scalc::context cy;
+        poly::node *q = scalc::deserialize_poly(cy, o.data(), o.data() + o.size());
+        std::string result = poly::poly_to_string(q);
+        poly::dispose(cy, q);
+        return result;
+    }
+
+    void serialize(){
+        CHECK(round_trip("(x+y+1)^3") == "x^3+3*x^2*y+3*x^2+3*x*y^2+6*x*y+3*x+y^3+3*y^2+3*y+1");
+        CHECK(round_trip("x^(y+1)*2i + 3") == "2i*x^(y+1)+3");
+        CHECK(round_trip("x - x") == "0");
+    }
+
+    // x^2 + x + 1: 指数の大きい項が前
+    void canonical(){
+        image a;
+        a.u32(1).symbol("x");
+        a.u32(3);
+        a.f64(1).f64(0).u32(1).u32(0).u32(1).term(2);
+        a.f64(1).f64(0).u32(1).u32(0).u32(1).term(1);
+        a.term(1);
+        CHECK(!rejected(a.str));
+    }
+
+    void reject(){
+        // 項の順が逆
+        image order;
+        order.u32(1).symbol("x");
+        order.u32(2);
+        order.term(1);
+        order.f64(1).f64(0).u32(1).u32(0).u32(1).term(1);
+        CHECK(rejected(order.str));
+
+        // 同じ指数部の項
+        image duplicate;
+        duplicate.u32(0).u32(2).term(1).term(2);
+        CHECK(rejected(duplicate.str));
+
+        // 係数が0の項
+        image zero;
+        zero.u32(0).u32(1).term(0, 0);
+        CHECK(rejected(zero.str));
+
+        // x^0: 項の無い指数部の多項式
+        image zero_exponent;
+        zero_exponent.u32(1).symbol("x");
+        zero_exponent.u32(1).f64(1).f64(0).u32(1).u32(0).u32(0);
+        CHECK(rejected(zero_exponent.str));
+
+        // 同じ記号の指数部が2つ
+        image twice;
+        twice.u32(1).symbol("x");
+        twice.u32(1).f64(1).f64(0).u32(2).u32(0).u32(1).term(1).u32(0).u32(1).term(1);
+        CHECK(rejected(twice.str));
+
+        // 途中で切れている, 余りがある, 無い記号を指す
+        image truncated;
+        truncated.u32(0).u32(2).term(1);
+        CHECK(rejected(truncated.str));
+        image trailing;
+        trailing.u32(0).u32(1).term(1).u32(0);
+        CHECK(rejected(trailing.str));
+        image symbol;
+        symbol.u32(0).u32(1).f64(1).f64(0).u32(1).u32(0).u32(1).term(1);
+        CHECK(rejected(symbol.str));
+    }
+}
+
+int main(){
+    serialize();
+    canonical();
+    reject();
+    return test::result("session_test");
+}
@@ -0,0 +1,108 @@
+﻿#ifndef SCALC_SPSC_QUEUE_HPP
+#define SCALC_SPSC_QUEUE_HPP
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <utility>
+
+namespace scalc{
+    // 容量の決まった単一生産者, 単一消費者のqueue
+    // 空きや要素がある間はロックを取らず, 待つ時だけcondition_variableで眠る
+    template<class T>
+    class spsc_queue{
+    public:
+        explicit spsc_queue(std::size_t capacity) : ring(round_up(capacity)), mask(ring.size() - 1), head(0), tail(0), closed(false), producer_waiting(false), consumer_waiting(false), mutex(), cond(){}
+
+        // 要素を積む. 満杯であれば空くまで待つ
+        void push(T x){
+            std::size_t t = tail.load(std::memory_order_relaxed);
+            wait(producer_waiting, [&]{ return t - head.load(std::memory_order_seq_cst) < ring.size(); });
+            ring[t & mask] = std::move(x);
+            tail.store(t + 1, std::memory_order_seq_cst);
+            wake(consumer_waiting);
+        }
+
+        // 満杯でなければ要素を積む
+        bool try_push(T &x){
+            std::size_t t = tail.load(std::memory_order_relaxed);
+            if(t - head.load(std::memory_order_seq_cst) >= ring.size()){ return false; }
+            ring[t & mask] = std::move(x);
+            tail.store(t + 1, std::memory_order_seq_cst);
+            wake(consumer_waiting);
+            return true;
+        }
+
+        // 要素を取り出す. 空であれば積まれるまで待つ
+        // 空のままcloseされていればfalseを返す
+        bool pop(T &x){
+            std::size_t h = head.load(std::memory_order_relaxed);
+            wait(consumer_waiting, [&]{ return tail.load(std::memory_order_seq_cst) != h || closed.load(std::memory_order_seq_cst); });
+            if(tail.load(std::memory_order_seq_cst) == h){ return false; }
+            take(h, x);
+            return true;
+        }
+
+        // 空でなければ要素を取り出す
+        bool try_pop(T &x){
+            std::size_t h = head.load(std::memory_order_relaxed);
+            if(tail.load(std::memory_order_seq_cst) == h){ return false; }
+            take(h, x);
+            return true;
+        }
+
+        // 生産者がこれ以上積まないことを通知する
+        void close(){
+            closed.store(true, std::memory_order_seq_cst);
+            wake(consumer_waiting);
+        }
+
+    private:
+        spsc_queue(const spsc_queue&);
+        spsc_queue &operator =(const spsc_queue&);
+
+        static std::size_t round_up(std::size_t n){
+            std::size_t m = 1;
+            while(m < n){ m <<= 1; }
+            return m;
+        }
+
+        void take(std::size_t h, T &x){
+            x = std::move(ring[h & mask]);
+            ring[h & mask] = T();
+            head.store(h + 1, std::memory_order_seq_cst);
+            wake(producer_waiting);
+        }
+
+        // 眠る前に自分の側のflagを立ててから条件を確かめ直す
+        // 相手はhead, tailを更新した後にflagを見るので, 起こし損ねない
+        // flagを生産者と消費者で分けるのは, 一方が起きる前に他方が眠りに入ることがあるため
+        template<class F>
+        void wait(std::atomic<bool> &flag, F ready){
+            if(ready()){ return; }
+            std::unique_lock<std::mutex> lock(mutex);
+            for(; ; ){
+                flag.store(true, std::memory_order_seq_cst);
+                if(ready()){ break; }
+                cond.wait(lock);
+            }
+            flag.store(false, std::memory_order_seq_cst);
+        }
+
+        void wake(std::atomic<bool> &flag){
+            if(!flag.load(std::memory_order_seq_cst)){ return; }
+            std::lock_guard<std::mutex> lock(mutex);
+            cond.notify_all();
+        }
+
+        std::vector<T> ring;
+        const std::size_t mask;
+        std::atomic<std::size_t> head, tail;
+        std::atomic<bool> closed, producer_waiting, consumer_waiting;
+        std::mutex mutex;
+        std::condition_variable cond;
+    };
+}
+
+#endif // SCALC_SPSC_QUEUE_HPP
@@ -0,0 +1,198 @@
+﻿#include <memory>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#if defined(__unix__)
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "table.hpp"
+
+namespace scalc{
+    namespace{
+        // 1度に評価する行の数
+        const std::size_t block_rows = 1024;
+
+        bool is_blank(char c){
+            return c == ' ' || c == '\t' || c == '\r';
+        }
+
+        [[noreturn]] void broken(std::size_t line){
+            throw(error("broken table, line " + to_string(line) + "."));
+        }
+    }
+
+    file_image::file_image(const std::string &path) : first(nullptr), last(nullptr), mapped_(false), buffer(){
+        std::FILE *fp = std::fopen(path.c_str(), "rb");
+        if(!fp){
+            throw(error("cannot open " + path + "."));
+        }
+        std::unique_ptr<std::FILE, int(*)(std::FILE*)> fp_guard(fp, std::fclose);
+#if defined(__unix__)
+        struct stat st;
+        int fd = ::fileno(fp);
+        if(::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0){
+            void *p = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if(p != MAP_FAILED){
+                ::madvise(p, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+                first = static_cast<const char*>(p);
+                last = first + st.st_size;
+                mapped_ = true;
+                return;
+            }
+        }
+#endif
+        char chunk[1 << 16];
+        for(std::size_t r; (r = std::fread(chunk, 1, sizeof(chunk), fp)) > 0; ){
+            buffer.insert(buffer.end(), chunk, chunk + r);
+        }
+        first = buffer.data();
+        last = first + buffer.size();
+    }
+
+    file_image::~file_image(){
+#if defined(__unix__)
+        if(mapped_){
+            ::munmap(const_cast<char*>(first), last - first);
+        }
+#endif
+    }
+
+    csv_table::csv_table(const std::string &path) : table_source(), image(path), pos(image.first), line(1), values(){
+        // 空のファイルには列の名前の行が無い. bufferに読んだ空のファイルはfirstがnullptrであり得る
+        if(image.first == image.last){ broken(line); }
+        const char *eol = static_cast<const char*>(std::memchr(pos, '\n', image.last - pos));
+        if(!eol){ eol = image.last; }
+        for(const char *p = pos; ; ){
+            const char *q = p;
+            while(q != eol && *q != ','){ ++q; }
+            const char *a = p, *b = q;
+            while(a != b && is_blank(*a)){ ++a; }
+            while(b != a && is_blank(*(b - 1))){ --b; }
+            if(a == b){ broken(line); }
+            names_.push_back(std::string(a, b));
+            if(q == eol){ break; }
+            p = q + 1;
+        }
+        pos = eol == image.last ? eol : eol + 1;
+        ++line;
+        values.resize(names_.size());
+        for(auto iter = values.begin(); iter != values.end(); ++iter){ iter->resize(block_rows); }
+    }
+
+    bool csv_table::next_block(std::size_t max_rows, std::vector<const double*> &columns, std::size_t &n){
+        if(max_rows > block_rows){ max_rows = block_rows; }
+        n = 0;
+        while(n < max_rows && pos != image.last){
+            const char *eol = static_cast<const char*>(std::memchr(pos, '\n', image.last - pos));
+            if(!eol){ eol = image.last; }
+            const char *p = pos;
+            while(p != eol && is_blank(*p)){ ++p; }
+            if(p != eol){
+                for(std::size_t i = 0; i < values.size(); ++i){
+                    const char *q = p;
+                    while(q != eol && *q != ','){ ++q; }
+                    // mapされた領域は0終端していないので, 写してから読む
+                    char buf[64];
+                    while(p != q && is_blank(*p)){ ++p; }
+                    std::size_t len = static_cast<std::size_t>(q - p);
+                    if(len == 0 || len >= sizeof(buf)){ broken(line); }
+                    std::memcpy(buf, p, len);
+                    buf[len] = '\0';
+                    char *end;
+                    values[i][n] = std::strtod(buf, &end);
+                    while(end != buf + len && is_blank(*end)){ ++end; }
+                    if(end != buf + len){ broken(line); }
+                    if(i + 1 < values.size()){
+                        if(q == eol){ broken(line); }
+                        p = q + 1;
+                    }else if(q != eol){
+                        broken(line);
+                    }
+                }
+                ++n;
+            }
+            pos = eol == image.last ? eol : eol + 1;
+            ++line;
+        }
+        columns.resize(values.size());
+        for(std::size_t i = 0; i < values.size(); ++i){ columns[i] = values[i].data(); }
+        return n > 0;
+    }
+
+    raw_table::raw_table(const std::string &path, const std::vector<std::string> &names) : table_source(), image(path), values(), base(nullptr), rows(0), row(0){
+        std::uint64_t one = 1;
+        unsigned char c;
+        std::memcpy(&c, &one, 1);
+        if(c != 1){
+            throw(error("raw table needs a little endian host."));
+        }
+        names_ = names;
+        std::size_t size = static_cast<std::size_t>(image.last - image.first);
+        if(names_.empty() || size % (names_.size() * sizeof(double)) != 0){
+            throw(error("broken table, " + path + "."));
+        }
+        rows = size / (names_.size() * sizeof(double));
+        if(image.mapped()){
+            // mmapした領域はpageに揃うので, 各列もdoubleに揃う
+            base = reinterpret_cast<const double*>(image.first);
+        }else{
+            values.resize(size / sizeof(double));
+            if(size > 0){ std::memcpy(values.data(), image.first, size); }
+            base = values.data();
+        }
+    }
+
+    bool raw_table::next_block(std::size_t max_rows, std::vector<const double*> &columns, std::size_t &n){
+        n = rows - row < max_rows ? rows - row : max_rows;
+        columns.resize(names_.size());
+        for(std::size_t i = 0; i < names_.size(); ++i){ columns[i] = base + i * rows + row; }
+        row += n;
+        return n > 0;
+    }
+
+    void eval_table(context &cx, const char *first, const char *last, table_source &t, output_buffer &o, bool raw){
+        evaluator ev;
+        std::unique_ptr<analyzer::eval_target> root(ev.parse(cx, first, last));
+        analyzer::numeric_compiler nc(cx.data());
+        analyzer::numeric_program program = nc.compile(*root);
+
+        // 命令列の列を表の列に結び付ける
+        std::vector<std::size_t> index;
+        for(auto iter = program.columns.begin(); iter != program.columns.end(); ++iter){
+            std::size_t i = 0;
+            while(i < t.names().size() && t.names()[i] != *iter){ ++i; }
+            if(i == t.names().size()){
+                throw(error("no column for symbol, " + *iter + "."));
+            }
+            index.push_back(i);
+        }
+
+        std::vector<const double*> columns, args(index.size());
+        std::vector<double> work, out(block_rows);
+        std::size_t n;
+        while(t.next_block(block_rows, columns, n)){
+            for(std::size_t i = 0; i < index.size(); ++i){ args[i] = columns[index[i]]; }
+            program.run(args.data(), n, out.data(), work);
+            if(raw){
+                o.write(reinterpret_cast<const char*>(out.data()), n * sizeof(double));
+                continue;
+            }
+            for(std::size_t i = 0; i < n; ++i){
+                double v = out[i];
+                if(std::isfinite(v)){
+                    o.put_exact_number(v);
+                }else{
+                    o.write(std::isnan(v) ? "nan" : v > 0 ? "inf" : "-inf");
+                }
+                o.put('\n');
+            }
+        }
+        o.flush();
+    }
+}
@@ -0,0 +1,87 @@
+﻿#ifndef SCALC_TABLE_HPP
+#define SCALC_TABLE_HPP
+
+#include <vector>
+#include <string>
+#include "scalc.hpp"
+
+namespace scalc{
+    // 変数の値の表
+    // 列ごとに名前を持ち, 行をblock単位で列の値の配列として渡す
+    class table_source{
+    public:
+        virtual ~table_source(){}
+
+        const std::vector<std::string> &names() const{
+            return names_;
+        }
+
+        // 最大max_rows行を読み, 各列のn行分の値をcolumnsに得る. 終わりであればfalseを返す
+        // 得た値は次にnext_blockを呼ぶまで有効
+        virtual bool next_block(std::size_t max_rows, std::vector<const double*> &columns, std::size_t &n) = 0;
+
+    protected:
+        table_source() : names_(){}
+
+        std::vector<std::string> names_;
+    };
+
+    // 読み込んだファイル. 通常のファイルはmmapし, それ以外はbufferに読む
+    class file_image{
+    public:
+        explicit file_image(const std::string &path);
+        ~file_image();
+
+        const char *first, *last;
+
+        // mmapした領域はpageに揃う. bufferに読んだものは揃うとは限らない
+        bool mapped() const{
+            return mapped_;
+        }
+
+    private:
+        file_image(const file_image&);
+        file_image &operator =(const file_image&);
+
+        bool mapped_;
+        std::vector<char> buffer;
+    };
+
+    // CSVの表
+    // 先頭行が列の名前で, 以降の行は列と同じ数の数値. 空行は読み飛ばす
+    class csv_table : public table_source{
+    public:
+        explicit csv_table(const std::string &path);
+
+        virtual bool next_block(std::size_t max_rows, std::vector<const double*> &columns, std::size_t &n);
+
+    private:
+        file_image image;
+        const char *pos;
+        std::size_t line;
+        std::vector<std::vector<double>> values;
+    };
+
+    // little endianのf64を列ごとに並べた表
+    // 全ての列は同じ行数で, ファイルの大きさは列の数 * 行数 * 8byte
+    // 値はmapされた領域を直接指す. mapできなかったファイルはvaluesに写す
+    class raw_table : public table_source{
+    public:
+        raw_table(const std::string &path, const std::vector<std::string> &names);
+
+        virtual bool next_block(std::size_t max_rows, std::vector<const double*> &columns, std::size_t &n);
+
+    private:
+        file_image image;
+        std::vector<double> values;
+        const double *base;
+        std::size_t rows, row;
+    };
+
+    // 文を数値の命令列に翻訳し, 表の各行で評価して結果を1行に1つずつ書き出す
+    // 文の自由な記号は同じ名前の列に結び付ける. 列が無い記号, 数値にならない文はerrorを投げる
+    // rawであれば結果をlittle endianのf64で書き出す
+    void eval_table(context &cx, const char *first, const char *last, table_source &t, output_buffer &o, bool raw = false);
+}
+
+#endif // SCALC_TABLE_HPP
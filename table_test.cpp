@@ -0,0 +1,168 @@
+﻿// 表の数値評価のテスト
+// eval_tableが各行で, 列の値をwhere部で束縛して構文木で評価した値と同じ結果を書き出すことを確かめる
+// CSVとf64の表, blockの境目, letで束縛した定数, 列の無い記号と数値にならない文も見る
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include "scalc.hpp"
+#include "table.hpp"
+#include "test.hpp"
+
+namespace{
+    const char *const statements[] = {
+        "x + y * z",
+        "(x + 1)^3 - 2*x*y",
+        "x / y - z // 4",
+        "-x^2 + y^0.5",
+        "x*a + b where a = y - 1, b = z^2",
+        "(y + x + 2)^(z / 8) * 3 + 1",
+        "x + k",
+        "2.5"
+    };
+
+    // 3列の値. yは正で, 0は分母に来ない
+    // 負の底の分数乗は構文木では複素数に, 数値では非数になるので, y + x + 2は正にする
+    double value(std::size_t row, int column){
+        switch(column){
+        case 0:
+            return static_cast<double>(row % 17) * 0.25 - 1.5;
+        case 1:
+            return static_cast<double>(row % 13) + 0.5;
+        default:
+            return static_cast<double>(row % 7) - 3;
+        }
+    }
+
+    std::string temporary_file(const std::string &content){
+        char path[] = "/tmp/scalc_table_testXXXXXX";
+        int fd = mkstemp(path);
+        if(fd < 0){ return ""; }
+        ssize_t unused = write(fd, content.data(), content.size());
+        static_cast<void>(unused);
+        close(fd);
+        return path;
+    }
+
+    // 列の値を文の外側の束縛にして構文木で評価する
+    double tree_value(scalc::evaluator &ev, scalc::context &cx, const char *statement, std::size_t row){
+        const char *names[] = {"x", "y", "z"};
+        scalc::binding_list bindings;
+        for(int c = 0; c < 3; ++c){
+            char buf[64];
+            int n = std::snprintf(buf, sizeof(buf), "%.17g", value(row, c));
+            bindings.push_back(std::make_pair(cx.symbols.intern(names[c]), ev.evaluate(cx, buf, buf + n)));
+        }
+        poly::node *p = ev.evaluate(cx, statement, statement + std::strlen(statement), bindings);
+        double v = p->next ? p->next->real : 0;
+        poly::dispose(cx, p);
+        return v;
+    }
+
+    bool near(double a, double b){
+        if(std::isnan(a) || std::isnan(b)){ return std::isnan(a) && std::isnan(b); }
+        return std::fabs(a - b) <= 1e-9 * (std::fabs(a) + std::fabs(b) + 1);
+    }
+
+    // 文字列の結果を行ごとの数値にする
+    std::vector<double> lines(const std::string &s){
+        std::vector<double> r;
+        const char *p = s.c_str();
+        while(*p){
+            char *end;
+            r.push_back(std::strtod(p, &end));
+            p = end;
+            while(*p == '\n'){ ++p; }
+        }
+        return r;
+    }
+
+    void matches_tree_evaluator(){
+        // blockの境目を跨ぐ行数
+        const std::size_t rows = 2500;
+        std::string csv = "x,y,z\n", raw;
+        std::vector<std::vector<double>> cols(3);
+        for(std::size_t i = 0; i < rows; ++i){
+            char buf[128];
+            std::snprintf(buf, sizeof(buf), "%.17g,%.17g,%.17g\n", value(i, 0), value(i, 1), value(i, 2));
+            csv += buf;
+            if(i % 500 == 0){ csv += "\n"; }
+            for(int c = 0; c < 3; ++c){ cols[c].push_back(value(i, c)); }
+        }
+        for(int c = 0; c < 3; ++c){ raw.append(reinterpret_cast<const char*>(cols[c].data()), rows * sizeof(double)); }
+        std::string csv_path = temporary_file(csv), raw_path = temporary_file(raw);
+        CHECK(!csv_path.empty() && !raw_path.empty());
+        std::vector<std::string> names;
+        names.push_back("x");
+        names.push_back("y");
+        names.push_back("z");
+
+        scalc::context cx;
+        scalc::evaluator ev;
+        ev.eval(cx, "let k = 3", "let k = 3" + 9);
+        for(std::size_t k = 0; k < sizeof(statements) / sizeof(statements[0]); ++k){
+            const char *s = statements[k], *e = s + std::strlen(s);
+            output_buffer text, binary;
+            scalc::csv_table t(csv_path);
+            scalc::eval_table(cx, s, e, t, text);
+            scalc::raw_table r(raw_path, names);
+            scalc::eval_table(cx, s, e, r, binary, true);
+
+            std::vector<double> v = lines(text.str());
+            bool ok = v.size() == rows && binary.size() == rows * sizeof(double);
+            for(std::size_t i = 0; ok && i < rows; ++i){
+                double b;
+                std::memcpy(&b, binary.data() + i * sizeof(double), sizeof(double));
+                double expected = tree_value(ev, cx, s, i);
+                if(!near(v[i], expected) || !near(b, expected)){
+                    std::fprintf(stderr, "%s, row %u: %.17g %.17g %.17g\n", s, static_cast<unsigned>(i), v[i], b, expected);
+                    ok = false;
+                }
+            }
+            CHECK(ok);
+        }
+        unlink(csv_path.c_str());
+        unlink(raw_path.c_str());
+    }
+
+    bool rejected(scalc::context &cx, const char *statement, const std::string &path){
+        try{
+            scalc::csv_table t(path);
+            output_buffer o;
+            scalc::eval_table(cx, statement, statement + std::strlen(statement), t, o);
+            return false;
+        }catch(std::exception&){
+            return true;
+        }
+    }
+
+    void errors(){
+        std::string path = temporary_file("x,y\n1,2\n");
+        scalc::context cx;
+        CHECK(!rejected(cx, "x + y", path));
+        CHECK(rejected(cx, "x + w", path));
+        CHECK(rejected(cx, "x * 2i", path));
+        CHECK(rejected(cx, "let x = 1", path));
+        CHECK(rejected(cx, "f x -> x", path));
+        CHECK(rejected(cx, "x +", path));
+        unlink(path.c_str());
+
+        path = temporary_file("x,y\n1,2\n3\n");
+        CHECK(rejected(cx, "x + y", path));
+        unlink(path.c_str());
+
+        path = temporary_file("");
+        CHECK(rejected(cx, "x", path));
+        unlink(path.c_str());
+    }
+}
+
+int main(){
+    matches_tree_evaluator();
+    errors();
+    return test::result("table_test");
+}
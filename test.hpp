@@ -0,0 +1,32 @@
+﻿#ifndef SCALC_TEST_HPP
+#define SCALC_TEST_HPP
+
+#include <iostream>
+
+// テストの小道具
+// CHECKは成り立たなかった条件を書き出して数え, test::resultは失敗の数を書き出して終了状態を返す
+namespace test{
+    inline int &failures(){
+        static int n = 0;
+        return n;
+    }
+
+    inline void check(bool b, const char *expr, const char *file, int line){
+        if(b){ return; }
+        ++failures();
+        std::cerr << file << ":" << line << ": " << expr << std::endl;
+    }
+
+    inline int result(const char *name){
+        if(failures() == 0){
+            std::cout << name << ": ok" << std::endl;
+            return 0;
+        }
+        std::cout << name << ": " << failures() << " failure(s)" << std::endl;
+        return 1;
+    }
+}
+
+#define CHECK(expr) test::check(static_cast<bool>(expr), #expr, __FILE__, __LINE__)
+
+#endif // SCALC_TEST_HPP
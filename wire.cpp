@@ -0,0 +1,77 @@
+﻿#include <cstdint>
+#include "wire.hpp"
+#include "session.hpp"
+
+namespace scalc{
+    namespace{
+        std::uint32_t get_u32(const char *&pos, const char *last){
+            if(last - pos < 4){ throw(error("broken request.")); }
+            const unsigned char *p = reinterpret_cast<const unsigned char*>(pos);
+            std::uint32_t n = 0;
+            for(int i = 0; i < 4; ++i){ n |= static_cast<std::uint32_t>(p[i]) << (i * 8); }
+            pos += 4;
+            return n;
+        }
+
+        // n byteの範囲を得る
+        std::pair<const char*, const char*> get_bytes(const char *&pos, const char *last, std::uint32_t n){
+            if(static_cast<std::size_t>(last - pos) < n){ throw(error("broken request.")); }
+            std::pair<const char*, const char*> r(pos, pos + n);
+            pos += n;
+            return r;
+        }
+    }
+
+    void decode_request(context &cx, const char *first, const char *last, std::pair<const char*, const char*> &statement, binding_list &bindings){
+        if(!is_wire_request(first, last)){ throw(error("broken request.")); }
+        const char *pos = first + 1;
+        statement = get_bytes(pos, last, get_u32(pos, last));
+        std::uint32_t n = get_u32(pos, last);
+        binding_list r;
+        try{
+            for(std::uint32_t i = 0; i < n; ++i){
+                auto name = get_bytes(pos, last, get_u32(pos, last));
+                auto value = get_bytes(pos, last, get_u32(pos, last));
+                if(name.first == name.second){ throw(error("broken request.")); }
+                r.push_back(std::make_pair(cx.symbols.intern(name.first, name.second), nullptr));
+                r.back().second = deserialize_poly(cx, value.first, value.second);
+            }
+            if(pos != last){ throw(error("broken request.")); }
+        }catch(...){
+            for(auto iter = r.begin(); iter != r.end(); ++iter){
+                if(iter->second){ poly::dispose(cx, iter->second); }
+            }
+            throw;
+        }
+        bindings.insert(bindings.end(), r.begin(), r.end());
+    }
+
+    void encode_result(const poly::node *p, std::size_t peak, output_buffer &o){
+        char b[9];
+        b[0] = 0;
+        std::uint64_t n = peak;
+        for(int i = 0; i < 8; ++i){ b[i + 1] = static_cast<char>(n >> (i * 8)); }
+        o.write(b, 9);
+        serialize_poly(p, o);
+    }
+
+    void encode_error(const char *message, output_buffer &o){
+        o.put(1);
+        o.write(message);
+    }
+
+    void eval_wire_request(evaluator &ev, context &cx, const char *first, const char *last, output_buffer &o){
+        poly::node *q;
+        try{
+            std::pair<const char*, const char*> statement;
+            binding_list bindings;
+            decode_request(cx, first, last, statement, bindings);
+            q = ev.evaluate(cx, statement.first, statement.second, bindings);
+        }catch(std::exception &e){
+            encode_error(e.what(), o);
+            return;
+        }
+        encode_result(q, cx.peak_memory(), o);
+        poly::dispose(cx, q);
+    }
+}
@@ -0,0 +1,36 @@
+﻿#ifndef SCALC_WIRE_HPP
+#define SCALC_WIRE_HPP
+
+#include <utility>
+#include "scalc.hpp"
+
+namespace scalc{
+    // 二進の要求と応答
+    // 数値は全てlittle endianで, 多項式はserialize_polyの形式
+    //     要求 : 種別(1byte, wire_request_tag) 文の長さ(u32) 文 束縛の数(u32) 束縛...
+    //     束縛 : 記号の長さ(u32) 記号 値の長さ(u32) 値(多項式)
+    //     応答 : 状態(1byte, 0: 成功, 1: 失敗) 続いて
+    //            成功 : 評価のメモリの最大値(u64) 結果(多項式)
+    //            失敗 : エラーメッセージ
+    // 文の要求は先頭が印字可能な文字なので, 種別の1byteで区別する
+    const char wire_request_tag = 1;
+
+    inline bool is_wire_request(const char *first, const char *last){
+        return first != last && *first == wire_request_tag;
+    }
+
+    // 要求を読み, 文の範囲をstatementに, 束縛する値をコンテキストの中に作ってbindingsに得る
+    // 壊れていればerrorを投げ, bindingsには何も加えない
+    void decode_request(context &cx, const char *first, const char *last, std::pair<const char*, const char*> &statement, binding_list &bindings);
+
+    // 成功した応答を書き出す
+    void encode_result(const poly::node *p, std::size_t peak, output_buffer &o);
+
+    // 失敗した応答を書き出す
+    void encode_error(const char *message, output_buffer &o);
+
+    // 二進の要求を評価して応答を書き出す. 要求の誤りと評価の失敗は失敗の応答にする
+    void eval_wire_request(evaluator &ev, context &cx, const char *first, const char *last, output_buffer &o);
+}
+
+#endif // SCALC_WIRE_HPP
@@ -0,0 +1,303 @@
+﻿// 二進の要求と応答, サーバのframeのテスト
+// 要求の束縛が文に渡ること, 壊れた要求が失敗の応答になり何も残さないこと,
+// サーバが分けて届いたframeと続けて届いたframeを順に処理し, 長すぎるframeで接続を切ることを確かめる
+// make testが作ったscalcを起動する
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "scalc.hpp"
+#include "session.hpp"
+#include "wire.hpp"
+#include "test.hpp"
+
+namespace{
+    void put_u32(std::string &s, std::uint32_t n){
+        for(int i = 0; i < 4; ++i){ s += static_cast<char>(n >> (i * 8)); }
+    }
+
+    std::uint32_t get_u32(const char *p){
+        std::uint32_t n = 0;
+        for(int i = 0; i < 4; ++i){ n |= static_cast<std::uint32_t>(static_cast<unsigned char>(p[i])) << (i * 8); }
+        return n;
+    }
+
+    // 文と, 文で評価した値の束縛から要求を組み立てる
+    std::string request(const char *statement, const std::vector<std::pair<const char*, const char*>> &bindings){
+        std::string s(1, scalc::wire_request_tag);
+        put_u32(s, static_cast<std::uint32_t>(std::strlen(statement)));
+        s += statement;
+        put_u32(s, static_cast<std::uint32_t>(bindings.size()));
+        for(auto iter = bindings.begin(); iter != bindings.end(); ++iter){
+            scalc::context cx;
+            scalc::evaluator ev;
+            poly::node *p = ev.evaluate(cx, iter->second, iter->second + std::strlen(iter->second));
+            output_buffer o;
+            scalc::serialize_poly(p, o);
+            poly::dispose(cx, p);
+            put_u32(s, static_cast<std::uint32_t>(std::strlen(iter->first)));
+            s += iter->first;
+            put_u32(s, static_cast<std::uint32_t>(o.size()));
+            s.append(o.data(), o.size());
+        }
+        return s;
+    }
+
+    // 応答を文字列にする. 失敗は"!"にメッセージを続ける
+    std::string response(const char *first, const char *last){
+        if(first == last){ return "(empty)"; }
+        if(*first == 1){ return "!" + std::string(first + 1, last); }
+        if(*first != 0 || last - first < 9){ return "(broken)"; }
+        scalc::context cx;
+        poly::node *p = scalc::deserialize_poly(cx, first + 9, last);
+        std::string s = poly::poly_to_string(p);
+        poly::dispose(cx, p);
+        return s;
+    }
+
+    std::string eval(scalc::evaluator &ev, scalc::context &cx, const std::string &req){
+        output_buffer o;
+        scalc::eval_wire_request(ev, cx, req.data(), req.data() + req.size(), o);
+        return response(o.data(), o.data() + o.size());
+    }
+
+    void requests(){
+        scalc::context cx;
+        scalc::evaluator ev;
+        std::vector<std::pair<const char*, const char*>> b;
+        CHECK(eval(ev, cx, request("(x + 1)^2", b)) == "x^2+2*x+1");
+        b.push_back(std::make_pair("a", "2"));
+        b.push_back(std::make_pair("b", "y + 1"));
+        CHECK(eval(ev, cx, request("a*x + b", b)) == "2*x+y+1");
+        // where部は要求の束縛より内側
+        CHECK(eval(ev, cx, request("a*x + b where a = 3", b)) == "3*x+y+1");
+        // 要求の束縛は文を跨いで残らない
+        CHECK(eval(ev, cx, request("a + b", std::vector<std::pair<const char*, const char*>>())) == "a+b");
+        CHECK(eval(ev, cx, request("x +", b)) == "!syntax error.");
+        CHECK(cx.let_value_count() == 0);
+    }
+
+    void broken_requests(){
+        scalc::context cx;
+        scalc::evaluator ev;
+        std::vector<std::pair<const char*, const char*>> b;
+        b.push_back(std::make_pair("a", "(p + q)^3"));
+        b.push_back(std::make_pair("b", "r"));
+        std::string req = request("a - b", b);
+        CHECK(eval(ev, cx, req) == "p^3+3*p^2*q+3*p*q^2+q^3-r");
+        std::size_t base = cx.meter.used;
+
+        // 途中で切れた要求. 読みかけの束縛を残さない
+        bool all = true;
+        for(std::size_t n = 1; n < req.size(); ++n){
+            if(eval(ev, cx, req.substr(0, n)) != "!broken request."){ all = false; }
+        }
+        CHECK(all);
+        CHECK(eval(ev, cx, req + '\0') == "!broken request.");
+        CHECK(cx.meter.used == base);
+
+        // 記号の数が残りの長さに見合わない値. 確保する前に拒む
+        std::string huge(1, scalc::wire_request_tag);
+        put_u32(huge, 0);
+        put_u32(huge, 1);
+        put_u32(huge, 1);
+        huge += 'a';
+        put_u32(huge, 4);
+        put_u32(huge, 0xffffffff);
+        CHECK(huge.size() == 22);
+        CHECK(eval(ev, cx, huge) == "!broken polynomial image.");
+        CHECK(cx.meter.used == base);
+
+        // 名前の無い束縛
+        std::vector<std::pair<const char*, const char*>> unnamed(1, std::make_pair("", "1"));
+        CHECK(eval(ev, cx, request("x", unnamed)) == "!broken request.");
+
+        // 種別の無い要求
+        std::pair<const char*, const char*> statement;
+        scalc::binding_list bindings;
+        bool thrown = false;
+        const char text[] = "1 + 2";
+        try{
+            scalc::decode_request(cx, text, text + 5, statement, bindings);
+        }catch(std::exception&){
+            thrown = true;
+        }
+        CHECK(thrown && bindings.empty());
+        CHECK(cx.meter.used == base);
+    }
+
+    // サーバと話す
+    class client{
+    public:
+        explicit client(const std::string &path) : fd(-1){
+            for(int i = 0; i < 200 && fd < 0; ++i){
+                int s = ::socket(AF_UNIX, SOCK_STREAM, 0);
+                sockaddr_un addr;
+                std::memset(&addr, 0, sizeof(addr));
+                addr.sun_family = AF_UNIX;
+                std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+                if(::connect(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0){
+                    fd = s;
+                }else{
+                    ::close(s);
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+            }
+        }
+
+        ~client(){
+            if(fd >= 0){ ::close(fd); }
+        }
+
+        bool connected() const{
+            return fd >= 0;
+        }
+
+        static std::string frame(const std::string &body){
+            std::string s;
+            put_u32(s, static_cast<std::uint32_t>(body.size()));
+            return s + body;
+        }
+
+        bool send(const std::string &s){
+            std::size_t n = 0;
+            while(n < s.size()){
+                ssize_t r = ::write(fd, s.data() + n, s.size() - n);
+                if(r <= 0){ return false; }
+                n += static_cast<std::size_t>(r);
+            }
+            return true;
+        }
+
+        // 応答のframeを1つ読む. 切られていればfalseを返す
+        bool receive(std::string &body){
+            char len[4];
+            if(!read_all(len, 4)){ return false; }
+            body.resize(get_u32(len));
+            return body.empty() || read_all(&body[0], body.size());
+        }
+
+    private:
+        bool read_all(char *p, std::size_t n){
+            while(n > 0){
+                ssize_t r = ::read(fd, p, n);
+                if(r <= 0){ return false; }
+                p += r, n -= static_cast<std::size_t>(r);
+            }
+            return true;
+        }
+
+        int fd;
+    };
+
+    // 文の応答を文字列にする. 失敗は"!"にメッセージを続ける
+    std::string text_response(const std::string &body){
+        if(body.empty()){ return "(empty)"; }
+        return (body[0] ? "!" : "") + body.substr(1);
+    }
+
+    // dfa_lexerであれば, サーバは文の要求を届いた端から字句解析する
+    void server_frames(bool dfa_lexer){
+        char dir[] = "/tmp/scalc_wire_testXXXXXX";
+        if(!mkdtemp(dir)){
+            CHECK(!"mkdtemp");
+            return;
+        }
+        std::string path = std::string(dir) + "/sock";
+        pid_t pid = fork();
+        if(pid == 0){
+            execl("./scalc", "./scalc", "--serve", path.c_str(), "--workers", "2", dfa_lexer ? "--dfa-lexer" : static_cast<char*>(nullptr), static_cast<char*>(nullptr));
+            _exit(127);
+        }
+        {
+            client c(path);
+            CHECK(c.connected());
+            if(c.connected()){
+                std::string body;
+                // 続けて届いたframeは順に, 接続のコンテキストで評価する
+                CHECK(c.send(client::frame("let a = 2") + client::frame("a*x + 1") + client::frame("x +")));
+                CHECK(c.receive(body) && text_response(body) == "2");
+                CHECK(c.receive(body) && text_response(body) == "2*x+1");
+                CHECK(c.receive(body) && text_response(body) == "!syntax error.");
+
+                // 1byteずつ届いたframe. tokenが読む度に途切れる
+                std::string f = client::frame("(a + y)^2") + client::frame("velocity*12.5 - velocity*10.5") + client::frame("1 + $") + client::frame("letter");
+                for(std::size_t i = 0; i < f.size(); ++i){
+                    c.send(f.substr(i, 1));
+                    if(i % 3 == 0){ std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+                }
+                CHECK(c.receive(body) && text_response(body) == "y^2+4*y+4");
+                CHECK(c.receive(body) && text_response(body) == "2*velocity");
+                CHECK(c.receive(body) && text_response(body) == "!lexical error.");
+                CHECK(c.receive(body) && text_response(body) == "!syntax error.");
+
+                // 二進の要求には二進の応答
+                std::vector<std::pair<const char*, const char*>> b(1, std::make_pair("b", "z^2"));
+                CHECK(c.send(client::frame(request("a*b", b)) + client::frame("a*b")));
+                CHECK(c.receive(body) && response(body.data(), body.data() + body.size()) == "2*z^2");
+                CHECK(c.receive(body) && text_response(body) == "2*b");
+
+                // 0による除算と0の冪は失敗の応答にして, 接続とサーバを保つ
+                CHECK(c.send(client::frame("1/0") + client::frame("x/0") + client::frame("0^2") + client::frame("0^x")));
+                CHECK(c.receive(body) && text_response(body) == "!division by zero.");
+                CHECK(c.receive(body) && text_response(body) == "!division by zero.");
+                CHECK(c.receive(body) && text_response(body) == "0");
+                CHECK(c.receive(body) && text_response(body) == "!reject, constant^symbol.");
+                std::vector<std::pair<const char*, const char*>> zero(1, std::make_pair("d", "0"));
+                CHECK(c.send(client::frame(request("a/d", zero))));
+                CHECK(c.receive(body) && response(body.data(), body.data() + body.size()) == "!division by zero.");
+
+                // 記号の数が大きすぎる要求にも応答し, サーバは落ちない
+                std::string huge(1, scalc::wire_request_tag);
+                put_u32(huge, 0);
+                put_u32(huge, 1);
+                put_u32(huge, 1);
+                huge += 'a';
+                put_u32(huge, 4);
+                put_u32(huge, 0xffffffff);
+                CHECK(c.send(client::frame(huge) + client::frame("x")));
+                CHECK(c.receive(body) && response(body.data(), body.data() + body.size()) == "!broken polynomial image.");
+                CHECK(c.receive(body) && text_response(body) == "x");
+
+                // 空のframeと空白だけのframe
+                CHECK(c.send(client::frame("")));
+                CHECK(c.receive(body) && text_response(body) == "!lexical error.");
+                CHECK(c.send(client::frame("  ")));
+                CHECK(c.receive(body) && text_response(body) == "!syntax error.");
+
+                // 長すぎるframeは接続を切る
+                std::string len;
+                put_u32(len, (1 << 20) + 1);
+                CHECK(c.send(len));
+                CHECK(!c.receive(body));
+            }
+            // 他の接続は別のコンテキストを持つ
+            client d(path);
+            std::string body;
+            CHECK(d.send(client::frame("a")) && d.receive(body) && text_response(body) == "a");
+        }
+        ::kill(pid, SIGTERM);
+        int status = 0;
+        ::waitpid(pid, &status, 0);
+        CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        ::unlink(path.c_str());
+        ::rmdir(dir);
+    }
+}
+
+int main(){
+    ::signal(SIGPIPE, SIG_IGN);
+    requests();
+    broken_requests();
+    server_frames(false);
+    server_frames(true);
+    return test::result("wire_test");
+}